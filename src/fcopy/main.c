@@ -25,8 +25,11 @@
 #include <pwd.h>
 
 int arg_quiet = 0;
+static int arg_debug = 0;
 static int arg_follow_link = 0;
+static CopyStats copy_stats;	// totals for all copied files
 
+#define MAXBUF 4096
 #define COPY_LIMIT (500 * 1024 *1024)
 static int size_limit_reached = 0;
 static unsigned file_cnt = 0;
@@ -64,19 +67,8 @@ static void copy_file(const char *srcname, const char *destname, mode_t mode, ui
 	}
 
 	// copy
-	ssize_t len;
-	static const int BUFLEN = 1024;
-	unsigned char buf[BUFLEN];
-	while ((len = read(src, buf, BUFLEN)) > 0) {
-		int done = 0;
-		while (done != len) {
-			int rv = write(dst, buf + done, len - done);
-			if (rv == -1)
-				goto errexit;
-			done += rv;
-		}
-	}
-	fflush(0);
+	if (copy_fd(src, dst, &copy_stats) == -1)
+		goto errexit;
 
 	if (fchown(dst, uid, gid) == -1)
 		goto errexit;
@@ -98,19 +90,21 @@ errexit:
 
 
 // modified version of the function in firejail/util.c
-static void mkdir_attr(const char *fname, mode_t mode, uid_t uid, gid_t gid) {
+// return -1 if the directory cannot be created
+static int mkdir_attr(const char *fname, mode_t mode, uid_t uid, gid_t gid) {
 	assert(fname);
 	mode &= 07777;
 
 	if (mkdir(fname, mode) == -1 ||
 	chmod(fname, mode) == -1) {
-		fprintf(stderr, "Error fcopy: failed to create %s directory\n", fname);
-		errExit("mkdir/chmod");
+		fprintf(stderr, "Error fcopy: failed to create %s directory: %s\n", fname, strerror(errno));
+		return -1;
 	}
 	if (chown(fname, uid, gid)) {
 		if (!arg_quiet)
 			fprintf(stderr, "Warning fcopy: failed to change ownership of %s\n", fname);
 	}
+	return 0;
 }
 
 
@@ -198,16 +192,22 @@ static int fs_copydir(const char *infname, const struct stat *st, int ftype, str
 		copy_file(infname, outfname, mode, uid, gid);
 	}
 	else if (ftype == FTW_D) {
-		mkdir_attr(outfname, mode, uid, gid);
+		// the walk stops if the directory cannot be created
+		if (mkdir_attr(outfname, mode, uid, gid)) {
+			free(outfname);
+			return 1;
+		}
 	}
 	else if (ftype == FTW_SL) {
 		copy_link(infname, outfname, mode, uid, gid);
 	}
 
+	free(outfname);
 	return(0);
 }
 
 
+// return the resolved path, NULL if the file is not valid
 static char *check(const char *src) {
 	struct stat s;
 	char *rsrc = realpath(src, NULL);
@@ -237,31 +237,48 @@ static char *check(const char *src) {
 
 errexit:
 	fprintf(stderr, "Error fcopy: invalid file %s\n", src);
-	exit(1);
+	free(rsrc);
+	return NULL;
+}
+
+// check source and destination; return 1 if error
+static int check_both(const char *src, const char *dest, char **rsrc, char **rdest) {
+	*rsrc = check(src);
+	*rdest = (*rsrc)? check(dest): NULL;
+	if (*rdest)
+		return 0;
+	free(*rsrc);
+	return 1;
 }
 
 
-static void duplicate_dir(const char *src, const char *dest, struct stat *s) {
+static int duplicate_dir(const char *src, const char *dest, struct stat *s) {
 	(void) s;
-	char *rsrc = check(src);
-	char *rdest = check(dest);
+	char *rsrc;
+	char *rdest;
+	if (check_both(src, dest, &rsrc, &rdest))
+		return 1;
 	inpath = rsrc;
 	outpath = rdest;
 
 	// walk
+	int rv = 0;
 	if(nftw(rsrc, fs_copydir, 1, FTW_PHYS) != 0) {
 		fprintf(stderr, "Error: unable to copy file\n");
-		exit(1);
+		rv = 1;
 	}
 
 	free(rsrc);
 	free(rdest);
+	return rv;
 }
 
 
-static void duplicate_file(const char *src, const char *dest, struct stat *s) {
-	char *rsrc = check(src);
-	char *rdest = check(dest);
+static int duplicate_file(const char *src, const char *dest, struct stat *s) {
+	char *rsrc;
+	char *rdest;
+	if (check_both(src, dest, &rsrc, &rdest))
+		return 1;
 	uid_t uid = s->st_uid;
 	gid_t gid = s->st_gid;
 	mode_t mode = s->st_mode;
@@ -279,12 +296,15 @@ static void duplicate_file(const char *src, const char *dest, struct stat *s) {
 	free(name);
 	free(rsrc);
 	free(rdest);
+	return 0;
 }
 
 
-static void duplicate_link(const char *src, const char *dest, struct stat *s) {
-	char *rsrc = check(src);		  // we drop the result and use the original name
-	char *rdest = check(dest);
+static int duplicate_link(const char *src, const char *dest, struct stat *s) {
+	char *rsrc;		  // we drop the result and use the original name
+	char *rdest;
+	if (check_both(src, dest, &rsrc, &rdest))
+		return 1;
 	uid_t uid = s->st_uid;
 	gid_t gid = s->st_gid;
 	mode_t mode = s->st_mode;
@@ -303,52 +323,38 @@ static void duplicate_link(const char *src, const char *dest, struct stat *s) {
 	free(name);
 	free(rsrc);
 	free(rdest);
+	return 0;
 }
 
 
 static void usage(void) {
 	fputs("Usage: fcopy [--follow-link] src dest\n"
+		"       fcopy --batch [manifest]\n"
 		"\n"
 		"Copy SRC to DEST/SRC. SRC may be a file, directory, or symbolic link.\n"
 		"If SRC is a directory it is copied recursively.  If it is a symlink,\n"
 		"the link itself is duplicated, unless --follow-link is given,\n"
 		"in which case the destination of the link is copied.\n"
-		"DEST must already exist and must be a directory.\n", stderr);
+		"DEST must already exist and must be a directory.\n"
+		"\n"
+		"In batch mode the copy requests are read from the manifest file, or from\n"
+		"stdin if no file is given, one request per line in the format\n"
+		"\"mode,src,dest\". The mode is \"c\" for a regular copy, or \"f\" for\n"
+		"a --follow-link copy.\n", stderr);
 }
 
 
-int main(int argc, char **argv) {
-#if 0
-	{
-		//system("cat /proc/self/status");
-		int i;
-		for (i = 0; i < argc; i++)
-			printf("*%s* ", argv[i]);
-		printf("\n");
-	}
-#endif
-	char *quiet = getenv("FIREJAIL_QUIET");
-	if (quiet && strcmp(quiet, "yes") == 0)
-		arg_quiet = 1;
-
-	char *src;
-	char *dest;
+// copy one file, directory or link; return 1 if error
+static int copy_entry(char *src, char *dest, int follow_link) {
+	assert(src);
+	assert(dest);
+	arg_follow_link = follow_link;
 
-	if (argc == 3) {
-		src = argv[1];
-		dest = argv[2];
-		arg_follow_link = 0;
-	}
-	else if (argc == 4 && !strcmp(argv[1], "--follow-link")) {
-		src = argv[2];
-		dest = argv[3];
-		arg_follow_link = 1;
-	}
-	else {
-		fprintf(stderr, "Error: arguments missing\n");
-		usage();
-		exit(1);
-	}
+	// the size limit applies to each request
+	size_limit_reached = 0;
+	file_cnt = 0;
+	size_cnt = 0;
+	first = 1;
 
 	// trim trailing chars
 	if (src[strlen(src) - 1] == '/')
@@ -362,7 +368,7 @@ int main(int argc, char **argv) {
 		src[len - 1] = '\0';
 	if (strcspn(src, "\\*&!?\"'<>%^(){}[];,") != (size_t)len) {
 		fprintf(stderr, "Error fcopy: invalid source file name %s\n", src);
-		exit(1);
+		return 1;
 	}
 
 	len = strlen(dest);
@@ -370,36 +376,126 @@ int main(int argc, char **argv) {
 		dest[len - 1] = '\0';
 	if (strcspn(dest, "\\*&!?\"'<>%^(){}[];,~") != (size_t)len) {
 		fprintf(stderr, "Error fcopy: invalid dest file name %s\n", dest);
-		exit(1);
+		return 1;
 	}
 
 	// the destination should be a directory;
 	struct stat s;
 	if (stat(dest, &s) == -1) {
 		fprintf(stderr, "Error fcopy: dest dir %s: %s\n", dest, strerror(errno));
-		exit(1);
+		return 1;
 	}
 	if (!S_ISDIR(s.st_mode)) {
 		fprintf(stderr, "Error fcopy: dest %s is not a directory\n", dest);
-		exit(1);
+		return 1;
 	}
 
 	// copy files
 	if ((arg_follow_link ? stat : lstat)(src, &s) == -1) {
 		fprintf(stderr, "Error fcopy: src %s: %s\n", src, strerror(errno));
-		exit(1);
+		return 1;
 	}
 
 	if (S_ISDIR(s.st_mode))
-		duplicate_dir(src, dest, &s);
+		return duplicate_dir(src, dest, &s);
 	else if (S_ISREG(s.st_mode))
-		duplicate_file(src, dest, &s);
+		return duplicate_file(src, dest, &s);
 	else if (S_ISLNK(s.st_mode))
-		duplicate_link(src, dest, &s);
+		return duplicate_link(src, dest, &s);
 	else {
 		fprintf(stderr, "Error fcopy: src %s is an unsupported type of file\n", src);
+		return 1;
+	}
+}
+
+
+// run all the copy requests in the manifest; a failed request doesn't stop the
+// requests following it, return 1 if any of them failed
+static int copy_batch(const char *manifest) {
+	FILE *fp = stdin;
+	if (manifest) {
+		fp = fopen(manifest, "r");
+		if (!fp) {
+			fprintf(stderr, "Error fcopy: cannot open manifest %s\n", manifest);
+			exit(1);
+		}
+	}
+
+	char buf[MAXBUF];
+	int lineno = 0;
+	int rv = 0;
+	while (fgets(buf, MAXBUF, fp)) {
+		lineno++;
+
+		// remove \n
+		char *ptr = strchr(buf, '\n');
+		if (ptr)
+			*ptr = '\0';
+		else if (!feof(fp)) {
+			fprintf(stderr, "Error fcopy: line %d in the manifest is too long\n", lineno);
+			rv = 1;
+			// skip the rest of the line
+			int c;
+			while ((c = fgetc(fp)) != EOF && c != '\n');
+			continue;
+		}
+		if (*buf == '\0')
+			continue;
+
+		// extract mode, source and destination
+		char *src = strchr(buf, ',');
+		char *dest = (src)? strchr(src + 1, ','): NULL;
+		if (!src || !dest || src != buf + 1 || (*buf != 'c' && *buf != 'f') ||
+		    *(src + 1) == ',' || *(dest + 1) == '\0') {
+			fprintf(stderr, "Error fcopy: invalid line %d in the manifest\n", lineno);
+			rv = 1;
+			continue;
+		}
+		*src++ = '\0';
+		*dest++ = '\0';
+
+		if (copy_entry(src, dest, (*buf == 'f')))
+			rv = 1;
+	}
+
+	if (manifest)
+		fclose(fp);
+	return rv;
+}
+
+
+int main(int argc, char **argv) {
+#if 0
+	{
+		//system("cat /proc/self/status");
+		int i;
+		for (i = 0; i < argc; i++)
+			printf("*%s* ", argv[i]);
+		printf("\n");
+	}
+#endif
+	char *quiet = getenv("FIREJAIL_QUIET");
+	if (quiet && strcmp(quiet, "yes") == 0)
+		arg_quiet = 1;
+	char *debug = getenv("FIREJAIL_DEBUG");
+	if (debug && strcmp(debug, "yes") == 0)
+		arg_debug = 1;
+
+	int rv;
+	if (argc == 3 && strcmp(argv[1], "--batch") != 0)
+		rv = copy_entry(argv[1], argv[2], 0);
+	else if (argc == 4 && !strcmp(argv[1], "--follow-link"))
+		rv = copy_entry(argv[2], argv[3], 1);
+	else if ((argc == 2 || argc == 3) && !strcmp(argv[1], "--batch"))
+		rv = copy_batch((argc == 3)? argv[2]: NULL);
+	else {
+		fprintf(stderr, "Error: arguments missing\n");
+		usage();
 		exit(1);
 	}
 
-	return 0;
+	if (arg_debug)
+		printf("fcopy: %llu bytes copied using %llu system calls\n",
+		       copy_stats.bytes, copy_stats.syscalls);
+	return rv;
 }
@@ -22,28 +22,24 @@
 #include <ctype.h>
 
 static int check_profile(const char *name, const char *homedir) {
-	// build profile name
-	char *profname1;
-	char *profname2;
-	if (asprintf(&profname1, "%s/%s.profile", SYSCONFDIR, name) == -1)
-		errExit("asprintf");
-	if (asprintf(&profname2, "%s/.config/firejail/%s.profile", homedir, name) == -1)
+	char *usercfgdir;
+	if (asprintf(&usercfgdir, "%s/.config/firejail", homedir) == -1)
 		errExit("asprintf");
 
+	const char *dirs[2] = { SYSCONFDIR, usercfgdir };
 	int rv = 0;
-	if (access(profname1, R_OK) == 0) {
-		if (arg_debug)
-			printf("found %s\n", profname1);
-		rv = 1;
-	}
-	else if (access(profname2, R_OK) == 0) {
-		if (arg_debug)
-			printf("found %s\n", profname2);
-		rv = 1;
+	int i;
+	for (i = 0; i < 2 && rv == 0; i++) {
+		char *profname = profile_lookup(name, dirs[i]);
+		if (profname && access(profname, R_OK) == 0) {
+			if (arg_debug)
+				printf("found %s\n", profname);
+			rv = 1;
+		}
+		free(profname);
 	}
 
-	free(profname1);
-	free(profname2);
+	free(usercfgdir);
 	return rv;
 }
 
@@ -50,6 +50,7 @@ int checkcfg(int val) {
 		cfg_val[CFG_DISABLE_MNT] = 0;
 		cfg_val[CFG_ARP_PROBES] = DEFAULT_ARP_PROBES;
 		cfg_val[CFG_XPRA_ATTACH] = 0;
+		cfg_val[CFG_PRIVATE_LIB_BIND] = 0;
 
 		// open configuration file
 		const char *fname = SYSCONFDIR "/firejail.config";
@@ -331,6 +332,41 @@ int checkcfg(int val) {
 				else
 					goto errout;
 			}
+			else if (strncmp(ptr, "private-lib-bind ", 17) == 0) {
+				if (strcmp(ptr + 17, "yes") == 0)
+					cfg_val[CFG_PRIVATE_LIB_BIND] = 1;
+				else if (strcmp(ptr + 17, "no") == 0)
+					cfg_val[CFG_PRIVATE_LIB_BIND] = 0;
+				else
+					goto errout;
+			}
+			// profile cache
+			else if (strncmp(ptr, "profile-cache ", 14) == 0) {
+				if (strcmp(ptr + 14, "yes") == 0)
+					cfg_val[CFG_PROFILE_CACHE] = 1;
+				else if (strcmp(ptr + 14, "no") == 0)
+					cfg_val[CFG_PROFILE_CACHE] = 0;
+				else
+					goto errout;
+			}
+			// seccomp cache
+			else if (strncmp(ptr, "seccomp-cache ", 14) == 0) {
+				if (strcmp(ptr + 14, "yes") == 0)
+					cfg_val[CFG_SECCOMP_CACHE] = 1;
+				else if (strcmp(ptr + 14, "no") == 0)
+					cfg_val[CFG_SECCOMP_CACHE] = 0;
+				else
+					goto errout;
+			}
+			// fork server
+			else if (strncmp(ptr, "fork-server ", 12) == 0) {
+				if (strcmp(ptr + 12, "yes") == 0)
+					cfg_val[CFG_FORK_SERVER] = 1;
+				else if (strcmp(ptr + 12, "no") == 0)
+					cfg_val[CFG_FORK_SERVER] = 0;
+				else
+					goto errout;
+			}
 			else if (strncmp(ptr, "private-bin-no-local ", 21) == 0) {
 				if (strcmp(ptr + 21, "yes") == 0)
 					cfg_val[CFG_PRIVATE_BIN_NO_LOCAL] = 1;
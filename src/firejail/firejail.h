@@ -32,10 +32,15 @@
 #define RUN_FIREJAIL_DIR	"/run/firejail"
 #define RUN_FIREJAIL_APPIMAGE_DIR	"/run/firejail/appimage"
 #define RUN_FIREJAIL_NAME_DIR	"/run/firejail/name" // also used in src/lib/pid.c - todo: move it in a common place
+#define RUN_FIREJAIL_SANDBOX_DIR	"/run/firejail/sandbox" // sandbox list, also used in src/lib/pid.c
+#define RUN_FIREJAIL_FORK_DIR	"/run/firejail/fork"	// fork server sockets, one directory for each user
 #define RUN_FIREJAIL_X11_DIR	"/run/firejail/x11"
 #define RUN_FIREJAIL_NETWORK_DIR	"/run/firejail/network"
 #define RUN_FIREJAIL_BANDWIDTH_DIR	"/run/firejail/bandwidth"
 #define RUN_FIREJAIL_PROFILE_DIR		"/run/firejail/profile"
+#define RUN_FIREJAIL_LDD_DIR	"/run/firejail/ldd"	// ELF dependency index files, one for each user
+#define RUN_FIREJAIL_PROFILE_CACHE_DIR	"/run/firejail/profile-cache"	// compiled profiles
+#define RUN_FIREJAIL_SECCOMP_CACHE_DIR	"/run/firejail/seccomp-cache"	// compiled seccomp filters
 #define RUN_NETWORK_LOCK_FILE	"/run/firejail/firejail-network.lock"
 #define RUN_DIRECTORY_LOCK_FILE	"/run/firejail/firejail-run.lock"
 #define RUN_RO_DIR	"/run/firejail/firejail.ro.dir"
@@ -53,6 +58,7 @@
 #define RUN_PULSE_DIR	"/run/firejail/mnt/pulse"
 #define RUN_LIB_DIR	"/run/firejail/mnt/lib"
 #define RUN_LIB_FILE	"/run/firejail/mnt/libfiles"
+#define RUN_LDD_INDEX_UPDATE	"/run/firejail/mnt/lddindex"	// new ELF dependency index records
 #define RUN_DNS_ETC	"/run/firejail/mnt/dns-etc"
 
 
@@ -387,10 +393,12 @@ extern int arg_notv;	// --notv
 extern int arg_nodvd;	// --nodvd
 extern int arg_nou2f;   // --nou2f
 extern int arg_nodbus; // -nodbus
+extern char *arg_fork_server;	// --fork-server
 
 extern int login_shell;
 extern int parent_to_child_fds[2];
 extern int child_to_parent_fds[2];
+extern int parent_to_network_fds[2];
 extern pid_t sandbox_pid;
 extern mode_t orig_umask;
 extern unsigned long long start_timestamp;
@@ -406,6 +414,7 @@ char *guess_shell(void);
 // sandbox.c
 int sandbox(void* sandbox_arg);
 void start_application(int no_sandbox);
+void sandbox_start_application(void);
 
 // network_main.c
 void net_configure_sandbox_ip(Bridge *br);
@@ -463,6 +472,20 @@ void profile_read(const char *fname);
 int profile_check_line(char *ptr, int lineno, const char *fname);
 // add a profile entry in cfg.profile list; use str to populate the list
 void profile_add(char *str);
+// process a profile line after the spaces and the comments were removed
+void profile_process_line(char *ptr, int lineno, const char *fname);
+
+// profile_cache.c
+// load a top-level profile from the cache; return 1 if the profile was loaded
+int profile_cache_load(const char *fname);
+// start building the cache for a top-level profile
+void profile_cache_start(const char *fname);
+// add a file to the cache, fp is NULL for a missing .local file; return the file index or -1
+int profile_cache_file(const char *fname, FILE *fp);
+void profile_cache_message(int file);
+void profile_cache_line(const char *line, int file, int lineno);
+// the top-level profile was read without errors, save the cache file
+void profile_cache_save(void);
 void fs_mnt(void);
 
 // list.c
@@ -478,7 +501,8 @@ void usage(void);
 void join(pid_t pid, int argc, char **argv, int index);
 
 // shutdown.c
-void shut(pid_t pid);
+#define DEFAULT_SHUTDOWN_TIMEOUT 10	// seconds
+void shut(pid_t *pids, int cnt, unsigned timeout);
 
 // restricted_shell.c
 int restricted_shell(const char *user);
@@ -530,6 +554,7 @@ unsigned extract_timeout(const char *str);
 void disable_file_or_dir(const char *fname);
 void disable_file_path(const char *path, const char *file);
 int safe_fd(const char *path, int flags);
+unsigned long long str_hash64(const char *str);
 
 // Get info regarding the last kernel mount operation from /proc/self/mountinfo
 // The return value points to a static area, and will be overwritten by subsequent calls.
@@ -540,6 +565,8 @@ typedef struct {
 	char *fstype; // filesystem type
 } MountData;
 MountData *get_last_mount(void);
+int get_mount_id(int fd);
+int check_mount(const char *path, int mount_id, int tmpfs);
 
 
 // fs_var.c
@@ -578,6 +605,7 @@ int seccomp_install_filters(void);
 int seccomp_load(const char *fname);
 int seccomp_filter_drop(void);
 int seccomp_filter_keep(void);
+void seccomp_cache_open(void);
 void seccomp_print_filter(pid_t pid);
 
 // caps.c
@@ -724,6 +752,29 @@ enum {
 };
 void sandboxfs(int op, pid_t pid, const char *path1, const char *path2);
 
+// fork_server.c
+void fork_server_listen(const char *name);
+void fork_server_cleanup(void);
+int fork_server_run(void);
+void fork_server_relay(pid_t child);
+void fork_server_connect(const char *name, int argc, char **argv, int index);
+
+// startup.c
+enum {
+	STARTUP_PARENT = 1,	// trace thread ids
+	STARTUP_SANDBOX,
+	STARTUP_NETWORK,
+	STARTUP_APP,
+	STARTUP_MAX
+};
+void startup_trace_open(const char *fname);
+void startup_trace_thread(int tid);
+void startup_phase_start(const char *name);
+void startup_phase_end(void);
+void startup_trace_flush(void);
+void startup_trace_exec(void);
+void startup_trace_close(void);
+
 // checkcfg.c
 #define DEFAULT_ARP_PROBES 2
 enum {
@@ -750,6 +801,10 @@ enum {
 	CFG_PRIVATE_LIB,
 	CFG_APPARMOR,
 	CFG_DBUS,
+	CFG_PRIVATE_LIB_BIND,
+	CFG_PROFILE_CACHE,
+	CFG_SECCOMP_CACHE,
+	CFG_FORK_SERVER,
 	CFG_MAX // this should always be the last entry
 };
 extern char *xephyr_screen;
@@ -799,11 +854,19 @@ void build_appimage_cmdline(char **command_line, char **window_title, int argc,
 
 // run sbox
 int sbox_run(unsigned filter, int num, ...);
+// run helpers in parallel
+void sbox_start(unsigned filter, int num, ...);
+void sbox_wait_all(void);
+// fcopy batch mode
+void sbox_fcopy_add(const char *src, const char *dest, int follow_link);
+int sbox_fcopy_queued(const char *target);
+void sbox_fcopy_run(unsigned filter);
 
 // run_files.c
 void delete_run_files(pid_t pid);
 void delete_bandwidth_run_file(pid_t pid);
 void set_name_run_file(pid_t pid);
+void set_sandbox_run_file(pid_t pid);
 void set_x11_run_file(pid_t pid, int display);
 void set_profile_run_file(pid_t pid, const char *fname);
 
@@ -0,0 +1,747 @@
+/*
+ * Copyright (C) 2014-2018 Firejail Authors
+ *
+ * This file is part of firejail project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+// Sandbox fork server
+//
+// firejail --fork-server=name builds the sandbox as usual: profile, filesystem,
+// network namespace, seccomp filters. Instead of starting a program, the sandbox
+// init process forks a new application for each firejail --fork-connect=name
+// request. The programs run in the same sandbox, in the same way as programs
+// started with --join.
+//
+// The socket is /run/firejail/fork/<uid>/<name>; the directory is accessible only
+// to the user, and it is not visible inside the sandboxes. The connections are
+// accepted by the firejail parent process, outside the sandbox. Only processes
+// of the same user running in the same PID and mount namespaces as the parent
+// are allowed; the connection is then passed to the sandbox init process.
+// The request is read in the process forked for it, a slow client doesn't
+// delay the other clients.
+//
+// Request, client to server:
+//	ForkRequest header with stdin, stdout and stderr attached as SCM_RIGHTS
+//	argv strings | environment strings | current working directory
+// While the program is running, the client forwards the signals it receives
+// as 32 bit signal numbers. When the program exits, the server replies
+// with the wait status, 32 bits, and closes the connection.
+#include "firejail.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/signalfd.h>
+#include <sys/prctl.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+
+#define FORK_SERVER_MAGIC 0x464a5331	// "FJS1"
+#define FORK_SERVER_MAX_CLIENTS 256
+#define FORK_SERVER_MAX_REQUEST (1024 * 1024)
+
+typedef struct fork_request_t {
+	uint32_t magic;
+	uint32_t argc;
+	uint32_t envc;
+	uint32_t len;	// length of the string area
+} ForkRequest;
+
+typedef struct fork_client_t {
+	int fd;		// connection, -1 if closed
+	int ready_fd;	// closed when the application is started, -1 afterwards
+	pid_t pid;	// application process group, 0 if the slot is free
+} ForkClient;
+
+static int server_fd = -1;
+static int relay_fds[2] = { -1, -1 };	// parent, sandbox init
+static char *server_path = NULL;
+
+static void socket_addr(const char *name, struct sockaddr_un *addr) {
+	assert(name);
+	if (*name == '\0' || strchr(name, '/') || strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+		fprintf(stderr, "Error: invalid fork server name %s\n", name);
+		exit(1);
+	}
+	invalid_filename(name, 0); // no globbing
+
+	memset(addr, 0, sizeof(struct sockaddr_un));
+	addr->sun_family = AF_UNIX;
+	if (snprintf(addr->sun_path, sizeof(addr->sun_path), RUN_FIREJAIL_FORK_DIR "/%u/%s",
+	    getuid(), name) >= (int) sizeof(addr->sun_path)) {
+		fprintf(stderr, "Error: fork server name %s too long\n", name);
+		exit(1);
+	}
+}
+
+//***********************************************
+// server
+//***********************************************
+// create the listening socket; it runs in the parent, before the sandbox is cloned
+void fork_server_listen(const char *name) {
+	EUID_ASSERT();
+	assert(name);
+
+	struct sockaddr_un addr;
+	socket_addr(name, &addr);
+	const char *path = addr.sun_path;
+
+	// user directory
+	char *dir;
+	if (asprintf(&dir, RUN_FIREJAIL_FORK_DIR "/%u", getuid()) == -1)
+		errExit("asprintf");
+	struct stat s;
+	EUID_ROOT();
+	if (mkdir(dir, 0700) == 0) {
+		if (chown(dir, getuid(), getgid()) == -1)
+			errExit("chown");
+	}
+	else if (errno != EEXIST)
+		errExit("mkdir");
+	if (lstat(dir, &s) == -1 || !S_ISDIR(s.st_mode) || s.st_uid != getuid() || (s.st_mode & 077)) {
+		fprintf(stderr, "Error: invalid fork server directory %s\n", dir);
+		exit(1);
+	}
+	EUID_USER();
+	free(dir);
+
+	// remove a socket left behind by a previous server
+	if (lstat(path, &s) == 0) {
+		if (!S_ISSOCK(s.st_mode) || s.st_uid != getuid()) {
+			fprintf(stderr, "Error: %s already exists\n", path);
+			exit(1);
+		}
+		int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd == -1)
+			errExit("socket");
+		if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+			fprintf(stderr, "Error: fork server %s is already running\n", name);
+			exit(1);
+		}
+		close(fd);
+		unlink(path);
+	}
+
+	server_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (server_fd == -1)
+		errExit("socket");
+	mode_t orig = umask(077);
+	if (bind(server_fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+		fprintf(stderr, "Error: cannot create fork server socket %s: %s\n", path, strerror(errno));
+		exit(1);
+	}
+	umask(orig);
+	if (listen(server_fd, 64) == -1)
+		errExit("listen");
+
+	// the accepted connections are passed to the sandbox init process
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, relay_fds) == -1)
+		errExit("socketpair");
+
+	server_path = strdup(path);
+	if (!server_path)
+		errExit("strdup");
+	if (arg_debug)
+		printf("Fork server listening on %s\n", path);
+}
+
+// remove the socket; it runs in the parent when the sandbox is shut down, euid is left to the user
+void fork_server_cleanup(void) {
+	if (!server_path)
+		return;
+	EUID_USER();
+	unlink(server_path);
+	free(server_path);
+	server_path = NULL;
+}
+
+static int read_all(int fd, void *buf, size_t len) {
+	char *ptr = buf;
+	while (len) {
+		ssize_t rv = read(fd, ptr, len);
+		if (rv == -1 && errno == EINTR)
+			continue;
+		if (rv <= 0)
+			return -1;
+		ptr += rv;
+		len -= rv;
+	}
+	return 0;
+}
+
+static int write_all(int fd, const void *buf, size_t len) {
+	const char *ptr = buf;
+	while (len) {
+		ssize_t rv = write(fd, ptr, len);
+		if (rv == -1 && errno == EINTR)
+			continue;
+		if (rv <= 0)
+			return -1;
+		ptr += rv;
+		len -= rv;
+	}
+	return 0;
+}
+
+typedef struct fork_data_t {
+	int fds[3];	// stdin, stdout, stderr
+	uint32_t argc;
+	uint32_t envc;
+	char *data;
+	char **argv;
+	char **envp;
+	char *cwd;
+} ForkData;
+
+static void free_request(ForkData *fdata) {
+	int i;
+	for (i = 0; i < 3; i++) {
+		if (fdata->fds[i] != -1)
+			close(fdata->fds[i]);
+	}
+	free(fdata->data);
+	free(fdata->argv);
+	free(fdata->envp);
+}
+
+// receive a request; return 1 if error
+// the client sends the request as soon as it is connected, we wait at most one second for it
+static int read_request(int fd, ForkData *fdata) {
+	memset(fdata, 0, sizeof(ForkData));
+	fdata->fds[0] = fdata->fds[1] = fdata->fds[2] = -1;
+	struct timeval tv = { 1, 0 };
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == -1)
+		return 1;
+
+	// receive the header and the standard file descriptors
+	ForkRequest req;
+	char cbuf[CMSG_SPACE(sizeof(fdata->fds))];
+	struct iovec iov = { &req, sizeof(req) };
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+
+	ssize_t len = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	if (len <= 0 || !cmsg)
+		return 1;
+	if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+	    cmsg->cmsg_len == CMSG_LEN(sizeof(fdata->fds)))
+		memcpy(fdata->fds, CMSG_DATA(cmsg), sizeof(fdata->fds));
+	if (len != sizeof(req) || req.magic != FORK_SERVER_MAGIC || (msg.msg_flags & MSG_CTRUNC) ||
+	    fdata->fds[0] == -1)
+		goto errout;
+
+	// receive argv, environment and current directory
+	if (req.argc == 0 || req.len == 0 || req.len > FORK_SERVER_MAX_REQUEST ||
+	    req.argc > req.len || req.envc > req.len)
+		goto errout;
+	fdata->argc = req.argc;
+	fdata->envc = req.envc;
+	fdata->data = malloc(req.len);
+	fdata->argv = calloc(req.argc + 1, sizeof(char *));
+	fdata->envp = calloc(req.envc + 1, sizeof(char *));
+	if (!fdata->data || !fdata->argv || !fdata->envp)
+		errExit("malloc");
+	if (read_all(fd, fdata->data, req.len) || fdata->data[req.len - 1] != '\0')
+		goto errout;
+	char *ptr = fdata->data;
+	char *end = fdata->data + req.len;
+	uint32_t i;
+	for (i = 0; i < req.argc + req.envc; i++) {
+		if (ptr >= end)
+			goto errout;
+		if (i < req.argc)
+			fdata->argv[i] = ptr;
+		else
+			fdata->envp[i - req.argc] = ptr;
+		ptr += strlen(ptr) + 1;
+	}
+	if (ptr >= end)
+		goto errout;
+	fdata->cwd = ptr;
+
+	// reset the timeout; signal messages are read only when poll reports them
+	tv.tv_sec = 0;
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == -1)
+		goto errout;
+	return 0;
+
+errout:
+	free_request(fdata);
+	return 1;
+}
+
+// start the application; it runs in the process forked for the request
+static void __attribute__((noreturn)) start_request(ForkData *fdata, const sigset_t *orig_mask) {
+	// standard file descriptors
+	int i;
+	for (i = 0; i < 3; i++) {
+		if (dup2(fdata->fds[i], i) == -1)
+			_exit(1);
+	}
+	for (i = 0; i < 3; i++) {
+		if (fdata->fds[i] > 2)
+			close(fdata->fds[i]);
+	}
+
+	// environment
+	clearenv();
+	for (i = 0; i < (int) fdata->envc; i++) {
+		if (strchr(fdata->envp[i], '='))
+			putenv(fdata->envp[i]);
+	}
+
+	// current directory
+	if (chdir(fdata->cwd) == -1) {
+		if (chdir(cfg.homedir) == -1 && chdir("/") == -1)
+			errExit("chdir");
+	}
+
+	// command line
+	cfg.original_argc = fdata->argc;
+	cfg.original_argv = fdata->argv;
+	cfg.original_program_index = 0;
+	cfg.command_name = fdata->argv[0];
+	build_cmdline(&cfg.command_line, &cfg.window_title, fdata->argc, fdata->argv, 0);
+
+	// the application is started in its own process group
+	setpgid(0, 0);
+	sigprocmask(SIG_SETMASK, orig_mask, NULL);
+	sandbox_start_application();
+	_exit(1); // it should never get here
+}
+
+static void send_status(ForkClient *client, int status) {
+	if (client->fd != -1) {
+		uint32_t val = status;
+		if (write_all(client->fd, &val, sizeof(val)))
+			;	// the client is gone
+		close(client->fd);
+	}
+	if (client->ready_fd != -1)
+		close(client->ready_fd);
+	client->fd = -1;
+	client->ready_fd = -1;
+	client->pid = 0;
+}
+
+// receive a connection from the parent; return -1 if error
+static int recv_connection(int fd) {
+	char c;
+	char cbuf[CMSG_SPACE(sizeof(int))];
+	struct iovec iov = { &c, 1 };
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+	if (recvmsg(fd, &msg, MSG_CMSG_CLOEXEC) <= 0)
+		return -1;
+
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+	    cmsg->cmsg_len != CMSG_LEN(sizeof(int)))
+		return -1;
+	int rv;
+	memcpy(&rv, CMSG_DATA(cmsg), sizeof(int));
+	return rv;
+}
+
+// run the fork server in the sandbox init process; return when the sandbox is shut down
+int fork_server_run(void) {
+	EUID_ASSERT();
+	assert(relay_fds[1] != -1);
+	close(server_fd);
+	close(relay_fds[0]);
+	int relay_fd = relay_fds[1];
+
+	ForkClient *clients = calloc(FORK_SERVER_MAX_CLIENTS, sizeof(ForkClient));
+	if (!clients)
+		errExit("calloc");
+	int i;
+	for (i = 0; i < FORK_SERVER_MAX_CLIENTS; i++)
+		clients[i].fd = clients[i].ready_fd = -1;
+
+	sigset_t mask, orig_mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGINT);
+	if (sigprocmask(SIG_BLOCK, &mask, &orig_mask) == -1)
+		errExit("sigprocmask");
+	int sfd = signalfd(-1, &mask, SFD_CLOEXEC);
+	if (sfd == -1)
+		errExit("signalfd");
+
+	if (!arg_quiet)
+		fmessage("Fork server ready\n");
+	flush_stdin();
+
+	struct pollfd pfd[FORK_SERVER_MAX_CLIENTS + 2];
+	int index[FORK_SERVER_MAX_CLIENTS + 2];
+	int active = 0;
+	int done = 0;
+	while (!done) {
+		int n = 0;
+		pfd[n].fd = sfd;
+		pfd[n++].events = POLLIN;
+		pfd[n].fd = relay_fd;
+		pfd[n++].events = (active < FORK_SERVER_MAX_CLIENTS)? POLLIN: 0;
+		for (i = 0; i < FORK_SERVER_MAX_CLIENTS; i++) {
+			if (clients[i].pid == 0)
+				continue;
+			// the connection belongs to the forked process until the application is started
+			int fd = (clients[i].ready_fd != -1)? clients[i].ready_fd: clients[i].fd;
+			if (fd != -1) {
+				index[n] = i;
+				pfd[n].fd = fd;
+				pfd[n++].events = POLLIN;
+			}
+		}
+
+		if (poll(pfd, n, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			errExit("poll");
+		}
+
+		// signals: reap the applications and any process reparented to the sandbox init
+		if (pfd[0].revents & POLLIN) {
+			struct signalfd_siginfo si;
+			if (read(sfd, &si, sizeof(si)) == sizeof(si) && si.ssi_signo != SIGCHLD)
+				done = 1;
+			pid_t pid;
+			int status;
+			while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+				for (i = 0; i < FORK_SERVER_MAX_CLIENTS; i++) {
+					if (clients[i].pid == pid) {
+						if (arg_debug)
+							printf("Fork server: pid %d exited, status %d\n", pid, status);
+						send_status(&clients[i], status);
+						active--;
+						break;
+					}
+				}
+			}
+		}
+
+		// client messages: forwarded signals; the application is killed if the client is gone
+		int j;
+		for (j = 2; j < n; j++) {
+			if (!pfd[j].revents)
+				continue;
+			ForkClient *client = &clients[index[j]];
+			if (client->pid == 0)
+				continue;
+			if (client->ready_fd != -1) {
+				// the application was started, or the request failed
+				close(client->ready_fd);
+				client->ready_fd = -1;
+				continue;
+			}
+			uint32_t sig;
+			ssize_t len = read(client->fd, &sig, sizeof(sig));
+			if (len == sizeof(sig) && sig > 0 && sig < _NSIG)
+				kill(-client->pid, sig);
+			else if (len <= 0) {
+				kill(-client->pid, SIGKILL);
+				close(client->fd);
+				client->fd = -1;
+			}
+		}
+
+		// new connections
+		if (active < FORK_SERVER_MAX_CLIENTS && (pfd[1].revents & (POLLIN | POLLHUP))) {
+			unsigned long long timestamp = getticks();
+			int fd = recv_connection(relay_fd);
+			if (fd == -1) {
+				// the parent is gone
+				if (pfd[1].revents & POLLHUP)
+					done = 1;
+				continue;
+			}
+
+			for (i = 0; i < FORK_SERVER_MAX_CLIENTS; i++) {
+				if (clients[i].pid == 0)
+					break;
+			}
+			assert(i < FORK_SERVER_MAX_CLIENTS);
+
+			// the write end is closed when the application is started
+			int ready[2];
+			if (pipe2(ready, O_CLOEXEC) == -1) {
+				close(fd);
+				continue;
+			}
+			pid_t pid = fork();
+			if (pid == -1) {
+				close(ready[0]);
+				close(ready[1]);
+				close(fd);
+				continue;
+			}
+			if (pid == 0) {
+				close(sfd);
+				close(relay_fd);
+				close(ready[0]);
+				start_timestamp = timestamp;
+				ForkData fdata;
+				if (read_request(fd, &fdata))
+					_exit(1);
+				close(fd);
+				start_request(&fdata, &orig_mask);
+			}
+			close(ready[1]);
+			setpgid(pid, pid);
+			clients[i].fd = fd;
+			clients[i].ready_fd = ready[0];
+			clients[i].pid = pid;
+			active++;
+			if (arg_debug)
+				printf("Fork server: starting pid %d\n", pid);
+		}
+	}
+
+	// shut down the applications; they are killed anyway when the sandbox init process exits
+	for (i = 0; i < FORK_SERVER_MAX_CLIENTS; i++) {
+		if (clients[i].pid)
+			kill(-clients[i].pid, SIGKILL);
+	}
+	return 0;
+}
+
+//***********************************************
+// parent
+//***********************************************
+// the peer is a process of the same user, running in the same PID and mount namespaces
+// as firejail parent process; programs in other sandboxes are not allowed to start
+// programs in this one
+static int peer_allowed(int fd) {
+	struct ucred cr;
+	socklen_t crlen = sizeof(cr);
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cr, &crlen) == -1 ||
+	    cr.uid != getuid() || cr.pid <= 0)
+		return 0;
+
+	static const char *ns[] = { "pid", "mnt", NULL };
+	int rv = 1;
+	int i;
+	EUID_ROOT();
+	for (i = 0; ns[i] && rv; i++) {
+		char *fname;
+		if (asprintf(&fname, "/proc/%d/ns/%s", cr.pid, ns[i]) == -1)
+			errExit("asprintf");
+		char *self;
+		if (asprintf(&self, "/proc/self/ns/%s", ns[i]) == -1)
+			errExit("asprintf");
+		struct stat s1, s2;
+		if (stat(fname, &s1) == -1 || stat(self, &s2) == -1 ||
+		    s1.st_dev != s2.st_dev || s1.st_ino != s2.st_ino)
+			rv = 0;
+		free(fname);
+		free(self);
+	}
+	EUID_USER();
+
+	if (!rv && arg_debug)
+		printf("Fork server: connection from pid %d rejected\n", cr.pid);
+	return rv;
+}
+
+static void send_connection(int relay_fd, int fd) {
+	char c = 0;
+	char cbuf[CMSG_SPACE(sizeof(int))];
+	memset(cbuf, 0, sizeof(cbuf));
+	struct iovec iov = { &c, 1 };
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	// the server doesn't take new connections when all the slots are busy
+	if (sendmsg(relay_fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) != 1 && arg_debug)
+		printf("Fork server: connection dropped\n");
+}
+
+// accept the connections and pass them to the sandbox init process;
+// it runs in the parent, and returns when the sandbox init process terminates
+void fork_server_relay(pid_t child) {
+	EUID_ASSERT();
+	assert(server_fd != -1);
+	close(relay_fds[1]);
+	relay_fds[1] = -1;
+	int pidfd = pid_fd_open(child);
+
+	while (1) {
+		struct pollfd pfd[2];
+		int n = 0;
+		pfd[n].fd = server_fd;
+		pfd[n++].events = POLLIN;
+		if (pidfd != -1) {
+			pfd[n].fd = pidfd;
+			pfd[n++].events = POLLIN;
+		}
+		if (poll(pfd, n, (pidfd == -1)? 100: -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			errExit("poll");
+		}
+
+		// the sandbox init process is reaped by the caller
+		if (pidfd != -1) {
+			if (pfd[1].revents & POLLIN)
+				break;
+		}
+		else {
+			siginfo_t info;
+			info.si_pid = 0;
+			if (waitid(P_PID, child, &info, WEXITED | WNOHANG | WNOWAIT) == -1 || info.si_pid)
+				break;
+		}
+
+		if (pfd[0].revents & POLLIN) {
+			int fd = accept4(server_fd, NULL, NULL, SOCK_CLOEXEC);
+			if (fd == -1)
+				continue;
+			if (peer_allowed(fd))
+				send_connection(relay_fds[0], fd);
+			close(fd);
+		}
+	}
+
+	if (pidfd != -1)
+		close(pidfd);
+}
+
+//***********************************************
+// client
+//***********************************************
+static int client_fd = -1;
+
+static void client_handler(int sig) {
+	uint32_t val = sig;
+	if (write(client_fd, &val, sizeof(val)) == -1)
+		;	// the server is gone
+}
+
+// run the program in argv[index] in the sandbox behind the fork server, exit with the program status
+void fork_server_connect(const char *name, int argc, char **argv, int index) {
+	EUID_ASSERT();
+	assert(name);
+	if (index >= argc) {
+		fprintf(stderr, "Error: no program specified for --fork-connect\n");
+		exit(1);
+	}
+
+	struct sockaddr_un addr;
+	socket_addr(name, &addr);
+	client_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (client_fd == -1)
+		errExit("socket");
+	if (connect(client_fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+		fprintf(stderr, "Error: cannot connect to fork server %s: %s\n", name, strerror(errno));
+		exit(1);
+	}
+
+	// build the string area
+	extern char **environ;
+	char *cwd = getcwd(NULL, 0);
+	if (!cwd)
+		cwd = strdup("/");
+	if (!cwd)
+		errExit("strdup");
+	ForkRequest req;
+	memset(&req, 0, sizeof(req));
+	req.magic = FORK_SERVER_MAGIC;
+	req.argc = argc - index;
+	size_t len = strlen(cwd) + 1;
+	int i;
+	for (i = index; i < argc; i++)
+		len += strlen(argv[i]) + 1;
+	for (i = 0; environ && environ[i]; i++, req.envc++)
+		len += strlen(environ[i]) + 1;
+	if (len > FORK_SERVER_MAX_REQUEST) {
+		fprintf(stderr, "Error: fork server request too large\n");
+		exit(1);
+	}
+	req.len = len;
+	char *data = malloc(len);
+	if (!data)
+		errExit("malloc");
+	char *ptr = data;
+	for (i = index; i < argc; i++)
+		ptr = stpcpy(ptr, argv[i]) + 1;
+	for (i = 0; i < (int) req.envc; i++)
+		ptr = stpcpy(ptr, environ[i]) + 1;
+	strcpy(ptr, cwd);
+	free(cwd);
+
+	// the server closes the connection if the request is not allowed
+	signal(SIGPIPE, SIG_IGN);
+
+	// send the header with stdin, stdout and stderr
+	int fds[3] = { 0, 1, 2 };
+	char cbuf[CMSG_SPACE(sizeof(fds))];
+	memset(cbuf, 0, sizeof(cbuf));
+	struct iovec iov = { &req, sizeof(req) };
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+	if (sendmsg(client_fd, &msg, 0) != sizeof(req) || write_all(client_fd, data, len)) {
+		fprintf(stderr, "Error: cannot send the request to fork server %s\n", name);
+		exit(1);
+	}
+	free(data);
+
+	// forward signals to the program
+	signal(SIGINT, client_handler);
+	signal(SIGTERM, client_handler);
+	signal(SIGHUP, client_handler);
+	signal(SIGQUIT, client_handler);
+
+	uint32_t status;
+	if (read_all(client_fd, &status, sizeof(status))) {
+		fprintf(stderr, "Error: fork server %s closed the connection\n", name);
+		exit(1);
+	}
+	if (WIFEXITED(status))
+		exit(WEXITSTATUS(status));
+	if (WIFSIGNALED(status))
+		exit(128 + WTERMSIG(status));
+	exit(1);
+}
@@ -28,6 +28,8 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <stdint.h>
+#include <sys/syscall.h>
 
 // check noblacklist statements not matched by a proper blacklist in disable-*.inc files
 //#define TEST_NO_BLACKLIST_MATCHING
@@ -35,6 +37,7 @@
 
 
 static void fs_rdwr(const char *dir);
+static void dir_cache_clear(void);
 
 
 
@@ -74,8 +77,10 @@ static void disable_file(OPERATION op, const char *filename) {
 		// they don't seem to like a uid of 0
 		// force mounting
 		int rv = mount(RUN_RO_DIR, filename, "none", MS_BIND, "mode=400,gid=0");
-		if (rv == 0)
+		if (rv == 0) {
 			last_disable = SUCCESSFUL;
+			dir_cache_clear();
+		}
 		else {
 			rv = mount(RUN_RO_FILE, filename, "none", MS_BIND, "mode=400,gid=0");
 			if (rv == 0)
@@ -134,6 +139,7 @@ static void disable_file(OPERATION op, const char *filename) {
 			if (S_ISDIR(s.st_mode)) {
 				if (mount(RUN_RO_DIR, fname, "none", MS_BIND, "mode=400,gid=0") < 0)
 					errExit("disable file");
+				dir_cache_clear();
 			}
 			else {
 				if (mount(RUN_RO_FILE, fname, "none", MS_BIND, "mode=400,gid=0") < 0)
@@ -177,6 +183,7 @@ static void disable_file(OPERATION op, const char *filename) {
 			if (chmod(fname, s.st_mode) == -1)
 				errExit("mounting tmpfs chmod");
 			last_disable = SUCCESSFUL;
+			dir_cache_clear();
 			fs_logger2("tmpfs", fname);
 		}
 		else
@@ -188,37 +195,290 @@ static void disable_file(OPERATION op, const char *filename) {
 	free(fname);
 }
 
+//***********************************************
+// blacklist matcher
+//***********************************************
+// Profiles contain hundreds of blacklist patterns, most of them for files
+// that don't exist. The patterns with wildcards only in the last path component
+// are matched against cached directory listings, each directory is read once.
+// The noblacklist patterns are indexed by their literal directory prefix,
+// a path is compared only with the patterns stored under one of its parents.
+#define MATCH_HASH_SIZE 256
+
+typedef struct dir_cache_t {
+	struct dir_cache_t *next;
+	char *dir;
+	char **names;	// NULL if the directory cannot be opened
+	size_t cnt;
+} DirCache;
+static DirCache *dir_cache[MATCH_HASH_SIZE];
+
+typedef struct nb_entry_t {
+	struct nb_entry_t *next;
+	char *key;		// literal path, or the literal directory prefix of a pattern
+	const char *pattern;
+	size_t index;		// index in noblacklist array
+} NbEntry;
+static NbEntry *nb_literal[MATCH_HASH_SIZE];	// patterns without wildcards
+static NbEntry *nb_prefix[MATCH_HASH_SIZE];	// patterns indexed by the literal directory prefix
+static NbEntry *nb_other = NULL;		// relative patterns, checked every time
+
+static inline unsigned match_hash(const char *str, size_t len) {
+	// FNV-1a, same as str_hash64() on a substring
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	size_t i;
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char) str[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return (unsigned) (hash % MATCH_HASH_SIZE);
+}
+
+static inline int has_wildcards(const char *str) {
+	// backslash escapes are left to glob() and fnmatch()
+	return strpbrk(str, "*?[\\") != NULL;
+}
+
+// directories under a blacklisted or tmpfs-mounted path change their content
+static void dir_cache_clear(void) {
+	int i;
+	for (i = 0; i < MATCH_HASH_SIZE; i++) {
+		DirCache *d = dir_cache[i];
+		while (d) {
+			DirCache *next = d->next;
+			size_t j;
+			for (j = 0; j < d->cnt; j++)
+				free(d->names[j]);
+			free(d->names);
+			free(d->dir);
+			free(d);
+			d = next;
+		}
+		dir_cache[i] = NULL;
+	}
+}
+
+static DirCache *dir_cache_get(const char *dir) {
+	unsigned h = match_hash(dir, strlen(dir));
+	DirCache *d = dir_cache[h];
+	while (d) {
+		if (strcmp(d->dir, dir) == 0)
+			return d;
+		d = d->next;
+	}
+
+	d = calloc(1, sizeof(DirCache));
+	if (!d)
+		errExit("calloc");
+	d->dir = strdup(dir);
+	if (!d->dir)
+		errExit("strdup");
+
+	DIR *dp = opendir(dir);
+	if (dp) {
+		size_t max = 16;
+		d->names = malloc(max * sizeof(char *));
+		if (!d->names)
+			errExit("malloc");
+		struct dirent *ent;
+		while ((ent = readdir(dp)) != NULL) {
+			// /home/me/.* can glob to /home/me/.. which would blacklist /home/
+			if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+				continue;
+			if (d->cnt == max) {
+				max *= 2;
+				d->names = realloc(d->names, max * sizeof(char *));
+				if (!d->names)
+					errExit("realloc");
+			}
+			d->names[d->cnt] = strdup(ent->d_name);
+			if (!d->names[d->cnt])
+				errExit("strdup");
+			d->cnt++;
+		}
+		closedir(dp);
+	}
+
+	d->next = dir_cache[h];
+	dir_cache[h] = d;
+	return d;
+}
+
+static void nb_free_list(NbEntry *e) {
+	while (e) {
+		NbEntry *next = e->next;
+		free(e->key);
+		free(e);
+		e = next;
+	}
+}
+
+static void nb_free(void) {
+	int i;
+	for (i = 0; i < MATCH_HASH_SIZE; i++) {
+		nb_free_list(nb_literal[i]);
+		nb_free_list(nb_prefix[i]);
+		nb_literal[i] = NULL;
+		nb_prefix[i] = NULL;
+	}
+	nb_free_list(nb_other);
+	nb_other = NULL;
+}
+
+static void noblacklist_add(const char *pattern, size_t index) {
+	assert(pattern);
+	NbEntry *e = calloc(1, sizeof(NbEntry));
+	if (!e)
+		errExit("calloc");
+	e->pattern = pattern;
+	e->index = index;
+
+	const char *magic = strpbrk(pattern, "*?[\\");
+	if (!magic) {
+		e->key = strdup(pattern);
+		if (!e->key)
+			errExit("strdup");
+		unsigned h = match_hash(pattern, strlen(pattern));
+		e->next = nb_literal[h];
+		nb_literal[h] = e;
+		return;
+	}
+
+	// FNM_PATHNAME: the path starts with the literal directory prefix followed by '/'
+	const char *slash = magic;
+	while (slash > pattern && *slash != '/')
+		slash--;
+	if (*slash != '/') {
+		e->next = nb_other;
+		nb_other = e;
+		return;
+	}
+	size_t len = slash - pattern;
+	e->key = strndup(pattern, len);
+	if (!e->key)
+		errExit("strndup");
+	unsigned h = match_hash(pattern, len);
+	e->next = nb_prefix[h];
+	nb_prefix[h] = e;
+}
+
+static int nb_fnmatch(const NbEntry *e, const char *path) {
+	int result = fnmatch(e->pattern, path, FNM_PATHNAME);
+	if (result == 0)
+		return 1;
+	else if (result != FNM_NOMATCH) {
+		fprintf(stderr, "Error: failed to compare path %s with pattern %s\n", path, e->pattern);
+		exit(1);
+	}
+	return 0;
+}
+
+// return the noblacklist entry matching the path, or NULL
+static const NbEntry *noblacklist_match(const char *path) {
+	assert(path);
+	unsigned h = match_hash(path, strlen(path));
+	const NbEntry *e;
+	for (e = nb_literal[h]; e; e = e->next) {
+		if (strcmp(e->key, path) == 0)
+			return e;
+	}
+
+	// look up the patterns stored under each parent directory
+	const char *ptr;
+	for (ptr = path; *ptr; ptr++) {
+		if (*ptr != '/')
+			continue;
+		size_t len = ptr - path;
+		h = match_hash(path, len);
+		for (e = nb_prefix[h]; e; e = e->next) {
+			if (strncmp(e->key, path, len) == 0 && e->key[len] == '\0' && nb_fnmatch(e, path))
+				return e;
+		}
+	}
+
+	for (e = nb_other; e; e = e->next) {
+		if (nb_fnmatch(e, path))
+			return e;
+	}
+	return NULL;
+}
+
 #ifdef TEST_NO_BLACKLIST_MATCHING
 static int nbcheck_start = 0;
 static size_t nbcheck_size = 0;
 static int *nbcheck = NULL;
 #endif
 
+static void blacklist_path(OPERATION op, const char *path) {
+	const NbEntry *e = noblacklist_match(path);
+	if (!e)
+		disable_file(op, path);
+	else {
+#ifdef TEST_NO_BLACKLIST_MATCHING
+		if (e->index < nbcheck_size)	// noblacklist checking
+			nbcheck[e->index] = 1;
+#endif
+		if (arg_debug)
+			printf("Not blacklist %s\n", path);
+	}
+}
+
 // Treat pattern as a shell glob pattern and blacklist matching files
-static void globbing(OPERATION op, const char *pattern, const char *noblacklist[], size_t noblacklist_len) {
+static void globbing(OPERATION op, const char *pattern) {
 	assert(pattern);
 
-#ifdef TEST_NO_BLACKLIST_MATCHING
-	if (nbcheck_start == 0) {
-		nbcheck_start = 1;
-		nbcheck_size = noblacklist_len;
-		nbcheck = malloc(sizeof(int) * noblacklist_len);
-		if (nbcheck == NULL)
-			errExit("malloc");
-		memset(nbcheck, 0, sizeof(int) * noblacklist_len);
+	// Profiles contain blacklists for files that might not exist on a user's machine.
+	// As with GLOB_NOCHECK, a pattern without matches is passed as is to disable_file().
+	if (!has_wildcards(pattern)) {
+		// /home/me/.. would blacklist /home/
+		const char *base = gnu_basename(pattern);
+		if (strcmp(base, ".") && strcmp(base, ".."))
+			blacklist_path(op, pattern);
+		return;
+	}
+
+	// wildcards only in the last path component: use the directory cache
+	const char *base = strrchr(pattern, '/');
+	if (base && base[1] != '\0') {
+		size_t dirlen = (base == pattern)? 1: (size_t) (base - pattern);
+		char dir[dirlen + 1];
+		memcpy(dir, pattern, dirlen);
+		dir[dirlen] = '\0';
+		base++;
+		// "/a//b*" is left to glob()
+		if (!has_wildcards(dir) && (dirlen == 1 || dir[dirlen - 1] != '/')) {
+			// collect the matches first, blacklisting a directory clears the cache
+			DirCache *d = dir_cache_get(dir);
+			char **paths = malloc((d->cnt + 1) * sizeof(char *));
+			if (!paths)
+				errExit("malloc");
+			size_t i, cnt = 0;
+			for (i = 0; i < d->cnt; i++) {
+				// GLOB_PERIOD: wildcards match a leading dot
+				if (fnmatch(base, d->names[i], 0) == 0 &&
+				    asprintf(&paths[cnt++], "%s/%s", (dirlen == 1)? "": dir, d->names[i]) == -1)
+					errExit("asprintf");
+			}
+
+			if (cnt == 0)
+				blacklist_path(op, pattern);
+			for (i = 0; i < cnt; i++) {
+				blacklist_path(op, paths[i]);
+				free(paths[i]);
+			}
+			free(paths);
+			return;
+		}
 	}
-#endif
 
 	glob_t globbuf;
-	// Profiles contain blacklists for files that might not exist on a user's machine.
-	// GLOB_NOCHECK makes that okay.
 	int globerr = glob(pattern, GLOB_NOCHECK | GLOB_NOSORT | GLOB_PERIOD, NULL, &globbuf);
 	if (globerr) {
 		fprintf(stderr, "Error: failed to glob pattern %s\n", pattern);
 		exit(1);
 	}
 
-	size_t i, j;
+	size_t i;
 	for (i = 0; i < globbuf.gl_pathc; i++) {
 		char *path = globbuf.gl_pathv[i];
 		assert(path);
@@ -226,30 +486,7 @@ static void globbing(OPERATION op, const char *pattern, const char *noblacklist[
 		const char *base = gnu_basename(path);
 		if (strcmp(base, ".") == 0 || strcmp(base, "..") == 0)
 			continue;
-		// noblacklist is expected to be short in normal cases, so stupid and correct brute force is okay
-		bool okay_to_blacklist = true;
-		for (j = 0; j < noblacklist_len; j++) {
-			int result = fnmatch(noblacklist[j], path, FNM_PATHNAME);
-			if (result == FNM_NOMATCH)
-				continue;
-			else if (result == 0) {
-				okay_to_blacklist = false;
-#ifdef TEST_NO_BLACKLIST_MATCHING
-				if (j < nbcheck_size)	// noblacklist checking
-					nbcheck[j] = 1;
-#endif
-				break;
-			}
-			else {
-				fprintf(stderr, "Error: failed to compare path %s with pattern %s\n", path, noblacklist[j]);
-				exit(1);
-			}
-		}
-
-		if (okay_to_blacklist)
-			disable_file(op, path);
-		else if (arg_debug)
-			printf("Not blacklist %s\n", path);
+		blacklist_path(op, path);
 	}
 	globfree(&globbuf);
 }
@@ -304,6 +541,7 @@ void fs_blacklist(void) {
 			/* coverity[toctou] */
 			if (set_perms(dname2,  s.st_uid, s.st_gid,s.st_mode))
 				errExit("set_perms");
+			dir_cache_clear();
 
 			entry = entry->next;
 			continue;
@@ -346,6 +584,7 @@ void fs_blacklist(void) {
 					if (noblacklist == NULL)
 						errExit("failed increasing memory for noblacklist entries");
 				}
+				noblacklist_add(enames[i], noblacklist_c);
 				noblacklist[noblacklist_c++] = enames[i];
 			}
 
@@ -384,6 +623,7 @@ void fs_blacklist(void) {
 			EUID_USER();
 			fs_mkdir(entry->data + 6);
 			EUID_ROOT();
+			dir_cache_clear();
 			entry = entry->next;
 			continue;
 		}
@@ -391,6 +631,7 @@ void fs_blacklist(void) {
 			EUID_USER();
 			fs_mkfile(entry->data + 7);
 			EUID_ROOT();
+			dir_cache_clear();
 			entry = entry->next;
 			continue;
 		}
@@ -404,6 +645,17 @@ void fs_blacklist(void) {
 		char *new_name = expand_home(ptr, homedir);
 		ptr = new_name;
 
+#ifdef TEST_NO_BLACKLIST_MATCHING
+		if (nbcheck_start == 0) {
+			nbcheck_start = 1;
+			nbcheck_size = noblacklist_c;
+			nbcheck = malloc(sizeof(int) * noblacklist_c);
+			if (nbcheck == NULL)
+				errExit("malloc");
+			memset(nbcheck, 0, sizeof(int) * noblacklist_c);
+		}
+#endif
+
 		// expand path macro - look for the file in /usr/local/bin,  /usr/local/sbin, /bin, /usr/bin, /sbin and  /usr/sbin directories
 		if (ptr) {
 			if (strncmp(ptr, "${PATH}", 7) == 0) {
@@ -416,11 +668,11 @@ void fs_blacklist(void) {
 					i++;
 					char newname[strlen(path) + fname_len + 1];
 					sprintf(newname, "%s%s", path, fname);
-					globbing(op, newname, (const char**)noblacklist, noblacklist_c);
+					globbing(op, newname);
 				}
 			}
 			else
-				globbing(op, ptr, (const char**)noblacklist, noblacklist_c);
+				globbing(op, ptr);
 		}
 
 		if (new_name)
@@ -446,6 +698,8 @@ void fs_blacklist(void) {
 	for (i = 0; i < noblacklist_c; i++)
 		free(noblacklist[i]);
 	free(noblacklist);
+	nb_free();
+	dir_cache_clear();
 }
 
 static int get_mount_flags(const char *path, unsigned long *flags) {
@@ -457,6 +711,107 @@ static int get_mount_flags(const char *path, unsigned long *flags) {
 	return 0;
 }
 
+//***********************************************
+// new mount API (Linux 5.12)
+//***********************************************
+// open_tree(2), move_mount(2) and mount_setattr(2) change the mount attributes
+// without a bind mount when the directory is already a mount point. If the kernel
+// doesn't support them, the old bind mount + remount sequence is used.
+#if defined(__NR_open_tree) && defined(__NR_move_mount) && defined(__NR_mount_setattr)
+#define HAVE_MOUNT_API
+#ifndef OPEN_TREE_CLONE
+#define OPEN_TREE_CLONE 1
+#endif
+#ifndef OPEN_TREE_CLOEXEC
+#define OPEN_TREE_CLOEXEC O_CLOEXEC
+#endif
+#ifndef AT_RECURSIVE
+#define AT_RECURSIVE 0x8000
+#endif
+#ifndef MOVE_MOUNT_F_EMPTY_PATH
+#define MOVE_MOUNT_F_EMPTY_PATH 0x00000004
+#endif
+#ifndef MOVE_MOUNT_T_EMPTY_PATH
+#define MOVE_MOUNT_T_EMPTY_PATH 0x00000040
+#endif
+#ifndef MOUNT_ATTR_RDONLY
+#define MOUNT_ATTR_RDONLY 0x00000001
+#define MOUNT_ATTR_NOSUID 0x00000002
+#define MOUNT_ATTR_NODEV 0x00000004
+#define MOUNT_ATTR_NOEXEC 0x00000008
+#endif
+#ifndef STATX_ATTR_MOUNT_ROOT
+#define STATX_ATTR_MOUNT_ROOT 0x00002000
+#endif
+
+// struct mount_attr
+typedef struct {
+	uint64_t attr_set;
+	uint64_t attr_clr;
+	uint64_t propagation;
+	uint64_t userns_fd;
+} MountAttr;
+
+static int mount_api_disabled = 0;
+
+// fd is the root of a mount
+static int is_mount_root(int fd) {
+#ifdef STATX_TYPE
+	struct statx stx;
+	if (statx(fd, "", AT_EMPTY_PATH | AT_SYMLINK_NOFOLLOW, STATX_TYPE, &stx) == 0 &&
+	    (stx.stx_attributes_mask & STATX_ATTR_MOUNT_ROOT))
+		return (stx.stx_attributes & STATX_ATTR_MOUNT_ROOT)? 1: 0;
+#endif
+	return 0;
+}
+#endif
+
+// Set and clear the attributes of the top mount in the tree starting at fd.
+// As with the remount in the fallback, the submounts keep their attributes:
+// read-only and noexec don't apply to the whitelisted directories inside,
+// and read-write doesn't undo the read-only files and directories inside.
+// If fd is the root of a mount, the mount is changed in place, otherwise
+// a recursive bind mount is created on top of fd.
+// Return 0 if successful, -1 if the caller should fall back on bind + remount.
+static int mount_attr_tree(int fd, uint64_t attr_set, uint64_t attr_clr) {
+#ifdef HAVE_MOUNT_API
+	if (mount_api_disabled || fd == -1)
+		return -1;
+
+	MountAttr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.attr_set = attr_set;
+	attr.attr_clr = attr_clr;
+
+	int rv = -1;
+	if (is_mount_root(fd))
+		rv = syscall(__NR_mount_setattr, fd, "", AT_EMPTY_PATH, &attr, sizeof(attr));
+	else {
+		int tree = syscall(__NR_open_tree, fd, "", OPEN_TREE_CLONE | OPEN_TREE_CLOEXEC | AT_EMPTY_PATH | AT_RECURSIVE);
+		if (tree != -1) {
+			// the detached tree is released on close if it was not attached
+			if (syscall(__NR_mount_setattr, tree, "", AT_EMPTY_PATH, &attr, sizeof(attr)) == 0)
+				rv = syscall(__NR_move_mount, tree, "", fd, "", MOVE_MOUNT_F_EMPTY_PATH | MOVE_MOUNT_T_EMPTY_PATH);
+			int err = errno;
+			close(tree);
+			errno = err;
+		}
+	}
+
+	if (rv == -1 && errno == ENOSYS) {
+		if (arg_debug)
+			printf("New mount API not available, using bind mounts\n");
+		mount_api_disabled = 1;
+	}
+	return (rv == 0)? 0: -1;
+#else
+	(void) fd;
+	(void) attr_set;
+	(void) attr_clr;
+	return -1;
+#endif
+}
+
 //***********************************************
 // mount namespace
 //***********************************************
@@ -473,10 +828,15 @@ void fs_rdonly(const char *dir) {
 		if ((flags & MS_RDONLY) == MS_RDONLY)
 			return;
 		flags |= MS_RDONLY;
+		int fd = open(dir, O_PATH|O_CLOEXEC);
+		rv = mount_attr_tree(fd, MOUNT_ATTR_RDONLY, 0);
+		if (fd != -1)
+			close(fd);
 		// mount --bind /bin /bin
 		// mount --bind -o remount,ro /bin
-		if (mount(dir, dir, NULL, MS_BIND|MS_REC, NULL) < 0 ||
-		    mount(NULL, dir, NULL, flags|MS_BIND|MS_REMOUNT|MS_REC, NULL) < 0)
+		if (rv == -1 &&
+		    (mount(dir, dir, NULL, MS_BIND|MS_REC, NULL) < 0 ||
+		     mount(NULL, dir, NULL, flags|MS_BIND|MS_REMOUNT|MS_REC, NULL) < 0))
 			errExit("mount read-only");
 		fs_logger2("read-only", dir);
 	}
@@ -511,14 +871,27 @@ static void fs_rdwr(const char *dir) {
 		return;
 	}
 	flags &= ~MS_RDONLY;
+	// path is resolved, a symbolic link at this point means somebody is playing games
+	int fd = (strcmp(path, "/") == 0)?
+		open("/", O_PATH|O_DIRECTORY|O_CLOEXEC):
+		safe_fd(path, O_PATH|O_NOFOLLOW|O_CLOEXEC);
+	if (fd == -1)
+		errLogExit("invalid read-write mount");
+	if (mount_attr_tree(fd, 0, MOUNT_ATTR_RDONLY) == 0) {
+		close(fd);
+		fs_logger2("read-write", path);
+		free(path);
+		return;
+	}
+	int mount_id = get_mount_id(fd);
+	close(fd);
 	if (mount(path, path, NULL, MS_BIND|MS_REC, NULL) < 0 ||
 	    mount(NULL, path, NULL, flags|MS_BIND|MS_REMOUNT|MS_REC, NULL) < 0)
 		errExit("mount read-write");
 	fs_logger2("read-write", path);
 
-	// run a check on /proc/self/mountinfo to validate the mount
-	MountData *mptr = get_last_mount();
-	if (strncmp(mptr->dir, path, strlen(path)) != 0)
+	// validate the mount
+	if (check_mount(path, mount_id, 0))
 		errLogExit("invalid read-write mount");
 
 	free(path);
@@ -537,8 +910,13 @@ void fs_noexec(const char *dir) {
 		if ((flags & (MS_NOEXEC|MS_NODEV|MS_NOSUID)) == (MS_NOEXEC|MS_NODEV|MS_NOSUID))
 			return;
 		flags |= MS_NOEXEC|MS_NODEV|MS_NOSUID;
-		if (mount(dir, dir, NULL, MS_BIND|MS_REC, NULL) < 0 ||
-		    mount(NULL, dir, NULL, flags|MS_BIND|MS_REMOUNT|MS_REC, NULL) < 0)
+		int fd = open(dir, O_PATH|O_CLOEXEC);
+		rv = mount_attr_tree(fd, MOUNT_ATTR_NOEXEC|MOUNT_ATTR_NODEV|MOUNT_ATTR_NOSUID, 0);
+		if (fd != -1)
+			close(fd);
+		if (rv == -1 &&
+		    (mount(dir, dir, NULL, MS_BIND|MS_REC, NULL) < 0 ||
+		     mount(NULL, dir, NULL, flags|MS_BIND|MS_REMOUNT|MS_REC, NULL) < 0))
 			errExit("mount noexec");
 		fs_logger2("noexec", dir);
 	}
@@ -685,6 +1063,10 @@ static void disable_config(void) {
 		disable_file(BLACKLIST_FILE, RUN_FIREJAIL_BANDWIDTH_DIR);
 	if (stat(RUN_FIREJAIL_NAME_DIR, &s) == 0)
 		disable_file(BLACKLIST_FILE, RUN_FIREJAIL_NAME_DIR);
+	if (stat(RUN_FIREJAIL_SANDBOX_DIR, &s) == 0)
+		disable_file(BLACKLIST_FILE, RUN_FIREJAIL_SANDBOX_DIR);
+	if (stat(RUN_FIREJAIL_FORK_DIR, &s) == 0)
+		disable_file(BLACKLIST_FILE, RUN_FIREJAIL_FORK_DIR);
 	if (stat(RUN_FIREJAIL_X11_DIR, &s) == 0)
 		disable_file(BLACKLIST_FILE, RUN_FIREJAIL_X11_DIR);
 }
@@ -1365,6 +1747,8 @@ void fs_private_cache(void) {
 	if (fstat(fd, &s) == -1 || s.st_uid != getuid())
 		errExit("fstat");
 
+	int mount_id = get_mount_id(fd);
+
 	// mount a tmpfs on ~/.cache via the symbolic link in /proc/self/fd
 	char *proc;
 	if (asprintf(&proc, "/proc/self/fd/%d", fd) == -1)
@@ -1374,10 +1758,8 @@ void fs_private_cache(void) {
 	fs_logger2("tmpfs", cache);
 	free(proc);
 	close(fd);
-	// check the last mount operation
-	MountData *mdata = get_last_mount();
-	assert(mdata);
-	if (strcmp(mdata->fstype, "tmpfs") != 0 || strcmp(mdata->dir, cache) != 0)
+	// check the mount operation
+	if (check_mount(cache, mount_id, 1))
 		errLogExit("invalid .cache mount");
 
 	// get a new file descriptor for ~/.cache, the old directory is masked by the tmpfs
@@ -202,7 +202,7 @@ static void duplicate(char *fname) {
 			if (valid_full_path_file(actual_path)) {
 				// solving problems such as /bin/sh -> /bin/dash
 				// copy the real file pointed by symlink
-				sbox_run(SBOX_ROOT| SBOX_SECCOMP, 3, PATH_FCOPY, actual_path, RUN_BIN_DIR);
+				sbox_fcopy_add(actual_path, RUN_BIN_DIR, 0);
 				prog_cnt++;
 				char *f = strrchr(actual_path, '/');
 				if (f && *(++f) !='\0')
@@ -213,7 +213,7 @@ static void duplicate(char *fname) {
 	}
 
 	// copy a file or a symlink
-	sbox_run(SBOX_ROOT| SBOX_SECCOMP, 3, PATH_FCOPY, full_path, RUN_BIN_DIR);
+	sbox_fcopy_add(full_path, RUN_BIN_DIR, 0);
 	prog_cnt++;
 	free(full_path);
 	report_duplication(fname);
@@ -289,7 +289,9 @@ void fs_private_bin_list(void) {
 	while ((ptr = strtok(NULL, ",")) != NULL)
 		globbing(ptr);
 	free(dlist);
-	fs_logger_print();
+
+	// copy all the files using a single fcopy process
+	sbox_fcopy_run(SBOX_ROOT| SBOX_SECCOMP);
 
 	// mount-bind
 	int i = 0;
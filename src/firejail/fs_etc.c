@@ -124,11 +124,11 @@ static void duplicate(const char *fname, const char *private_dir, const char *pr
 		if (asprintf(&dirname, "%s/%s", private_run_dir, fname) == -1)
 			errExit("asprintf");
 		create_empty_dir_as_root(dirname, s.st_mode);
-		sbox_run(SBOX_ROOT| SBOX_SECCOMP, 3, PATH_FCOPY, src, dirname);
+		sbox_fcopy_add(src, dirname, 0);
 		free(dirname);
 	}
 	else
-		sbox_run(SBOX_ROOT| SBOX_SECCOMP, 3, PATH_FCOPY, src, private_run_dir);
+		sbox_fcopy_add(src, private_run_dir, 0);
 
 	fs_logger2("clone", src);
 	free(src);
@@ -146,9 +146,6 @@ void fs_private_dir_list(const char *private_dir, const char *private_run_dir, c
 	mkdir_attr(private_run_dir, 0755, 0, 0);
 	fs_logger2("tmpfs", private_dir);
 
-	fs_logger_print();	// save the current log
-
-
 	// copy the list of files in the new etc directory
 	// using a new child process with root privileges
 	if (*private_list != '\0') {
@@ -167,7 +164,9 @@ void fs_private_dir_list(const char *private_dir, const char *private_run_dir, c
 		while ((ptr = strtok(NULL, ",")) != NULL)
 			duplicate(ptr, private_dir, private_run_dir);
 		free(dlist);
-		fs_logger_print();
+
+		// copy all the files using a single fcopy process
+		sbox_fcopy_run(SBOX_ROOT| SBOX_SECCOMP);
 	}
 
 	if (arg_debug)
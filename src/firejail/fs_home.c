@@ -448,13 +448,12 @@ static void duplicate(char *name) {
 		if (asprintf(&name, "%s/%s", RUN_HOME_DIR, ptr) == -1)
 			errExit("asprintf");
 		mkdir_attr(name, 0755, getuid(), getgid());
-		sbox_run(SBOX_USER| SBOX_CAPS_NONE | SBOX_SECCOMP, 3, PATH_FCOPY, fname, name);
+		sbox_fcopy_add(fname, name, 0);
 		free(name);
 	}
 	else
-		sbox_run(SBOX_USER| SBOX_CAPS_NONE | SBOX_SECCOMP, 3, PATH_FCOPY, fname, RUN_HOME_DIR);
+		sbox_fcopy_add(fname, RUN_HOME_DIR, 0);
 	fs_logger2("clone", fname);
-	fs_logger_print();	// save the current log
 
 	free(fname);
 }
@@ -481,7 +480,6 @@ void fs_private_home_list(void) {
 
 	// create /run/firejail/mnt/home directory
 	mkdir_attr(RUN_HOME_DIR, 0755, uid, gid);
-	fs_logger_print();	// save the current log
 
 	if (arg_debug)
 		printf("Copying files in the new home:\n");
@@ -496,7 +494,8 @@ void fs_private_home_list(void) {
 	while ((ptr = strtok(NULL, ",")) != NULL)
 		duplicate(ptr);
 
-	fs_logger_print();	// save the current log
+	// copy all the files using a single fcopy process
+	sbox_fcopy_run(SBOX_USER| SBOX_CAPS_NONE | SBOX_SECCOMP);
 	free(dlist);
 
 	if (arg_debug)
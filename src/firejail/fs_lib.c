@@ -25,7 +25,10 @@
 #include <unistd.h>
 #include <dirent.h>
 #include <glob.h>
+#include <fcntl.h>
+#include <sys/file.h>
 #define MAXBUF 4096
+#define LDD_INDEX_MAX 8192	// max number of records in the ELF dependency index
 
 extern void fslib_install_stdc(void);
 extern void fslib_install_system(void);
@@ -33,6 +36,14 @@ extern void fslib_install_system(void);
 static int lib_cnt = 0;
 static int dir_cnt = 0;
 
+// files waiting for fldd
+typedef struct ldd_target_t {
+	struct ldd_target_t *next;
+	char *name;
+} LddTarget;
+static LddTarget *ldd_first = NULL;
+static LddTarget *ldd_last = NULL;
+
 static void report_duplication(const char *full_path) {
 	char *fname = strrchr(full_path, '/');
 	if (fname && *(++fname) != '\0') {
@@ -56,6 +67,35 @@ static char *build_dest_dir(const char *full_path) {
 	return RUN_LIB_DIR;
 }
 
+// mount-bind the library read-only on an empty file in private_run_dir (private-lib-bind)
+// return 0 if mounted, -1 if the file was skipped
+static int mount_file(const char *full_path, const char *name) {
+	assert(full_path);
+	assert(name);
+
+	// the bind mount follows symbolic links anyway; resolve it here in order to
+	// check the real file is also owned by root
+	char *rpath = realpath(full_path, NULL);
+	if (!rpath)
+		return -1;
+	struct stat s;
+	if (stat(rpath, &s) != 0 || s.st_uid != 0 || !S_ISREG(s.st_mode)) {
+		free(rpath);
+		return -1;
+	}
+
+	if (arg_debug || arg_debug_private_lib)
+		printf("    mounting %s on %s\n", rpath, name);
+
+	create_empty_file_as_root(name, 0644);
+	if (mount(rpath, name, NULL, MS_BIND, NULL) < 0 ||
+	    mount(NULL, name, NULL, MS_BIND|MS_REMOUNT|MS_RDONLY|MS_NOSUID|MS_NODEV, NULL) < 0)
+		errExit("mount bind");
+	fs_logger2("mount", full_path);
+	free(rpath);
+	return 0;
+}
+
 // copy fname in private_run_dir
 void fslib_duplicate(const char *full_path) {
 	assert(full_path);
@@ -77,16 +117,23 @@ void fslib_duplicate(const char *full_path) {
 	char *name;
 	if (asprintf(&name, "%s/%s", dest_dir, ptr) == -1)
 		errExit("asprintf");
-	if (stat(name, &s) == 0) {
+	if (stat(name, &s) == 0 || sbox_fcopy_queued(name)) {
 		free(name);
 		return;
 	}
-	free(name);
 
-	if (arg_debug || arg_debug_private_lib)
-		printf("    copying %s to private %s\n", full_path, dest_dir);
-
-	sbox_run(SBOX_ROOT| SBOX_SECCOMP, 4, PATH_FCOPY, "--follow-link", full_path, dest_dir);
+	if (checkcfg(CFG_PRIVATE_LIB_BIND)) {
+		if (mount_file(full_path, name)) {
+			free(name);
+			return;
+		}
+	}
+	else {
+		if (arg_debug || arg_debug_private_lib)
+			printf("    copying %s to private %s\n", full_path, dest_dir);
+		sbox_fcopy_add(full_path, dest_dir, 1);
+	}
+	free(name);
 	report_duplication(full_path);
 	lib_cnt++;
 }
@@ -95,6 +142,7 @@ void fslib_duplicate(const char *full_path) {
 // requires full path for lib
 // it could be a library or an executable
 // lib is not copied, only libraries used by it
+// the file is queued, and all the queued files are processed by a single fldd run in fslib_install_pending()
 void fslib_copy_libs(const char *full_path) {
 	assert(full_path);
 	if (arg_debug || arg_debug_private_lib)
@@ -108,19 +156,171 @@ void fslib_copy_libs(const char *full_path) {
 		return;
 	}
 
-	// create an empty RUN_LIB_FILE and allow the user to write to it
+	LddTarget *target = malloc(sizeof(LddTarget));
+	if (!target)
+		errExit("malloc");
+	target->next = NULL;
+	target->name = strdup(full_path);
+	if (!target->name)
+		errExit("strdup");
+	if (ldd_last)
+		ldd_last->next = target;
+	else
+		ldd_first = target;
+	ldd_last = target;
+}
+
+// merge the new records produced by fldd in the user's ELF dependency index
+static void ldd_index_merge(void) {
+	FILE *fp = fopen(RUN_LDD_INDEX_UPDATE, "r");
+	if (!fp)
+		return;
+	LddRecord *update = ldd_index_read(fp);
+	fclose(fp);
+	unlink(RUN_LDD_INDEX_UPDATE);
+
+	// fldd runs as a regular user; keep only the records for unmodified files owned by root;
+	// the files copied in this sandbox (private-bin) are not indexed
+	struct stat mnt;
+	if (stat(RUN_MNT_DIR, &mnt) == -1)
+		errExit("stat");
+	LddRecord *valid = NULL;
+	LddRecord **last = &valid;
+	int cnt = 0;
+	while (update) {
+		LddRecord *next = update->next;
+		update->next = NULL;
+		struct stat s;
+		if (stat(update->path, &s) == 0 && s.st_uid == 0 && s.st_dev != mnt.st_dev &&
+		    ldd_record_match(update, &s)) {
+			*last = update;
+			last = &update->next;
+			cnt++;
+		}
+		else
+			ldd_record_free(update);
+		update = next;
+	}
+	if (!valid)
+		return;
+
+	char *fname;
+	char *tmpname;
+	if (asprintf(&fname, "%s/%u", RUN_FIREJAIL_LDD_DIR, getuid()) == -1 ||
+	    asprintf(&tmpname, "%s/%u.tmp", RUN_FIREJAIL_LDD_DIR, getuid()) == -1)
+		errExit("asprintf");
+
+	// several sandboxes could update the index at the same time
+	int lockfd = open(RUN_FIREJAIL_LDD_DIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (lockfd == -1)
+		goto out;
+	flock(lockfd, LOCK_EX);
+
+	// keep the old records not replaced by the update; start over if the index grows too large
+	LddRecord *old = NULL;
+	fp = fopen(fname, "r");
+	if (fp) {
+		old = ldd_index_read(fp);
+		fclose(fp);
+	}
+
+	fp = fopen(tmpname, "w");
+	if (!fp) {
+		fwarning("cannot update the dependency index\n");
+		goto unlock;
+	}
+	SET_PERMS_STREAM(fp, 0, getgid(), 0640);
+
+	int old_cnt = 0;
+	LddRecord *ptr;
+	for (ptr = old; ptr; ptr = ptr->next)
+		old_cnt++;
+	for (ptr = old; ptr && old_cnt + cnt <= LDD_INDEX_MAX; ptr = ptr->next) {
+		LddRecord *rec;
+		for (rec = valid; rec; rec = rec->next)
+			if (strcmp(rec->path, ptr->path) == 0)
+				break;
+		if (!rec)
+			ldd_index_write(fp, ptr);
+	}
+	for (ptr = valid; ptr; ptr = ptr->next)
+		ldd_index_write(fp, ptr);
+
+	if (fclose(fp) || rename(tmpname, fname)) {
+		fwarning("cannot update the dependency index\n");
+		unlink(tmpname);
+	}
+	else if (arg_debug || arg_debug_private_lib)
+		printf("    %d new %s in the dependency index\n", cnt, (cnt == 1)? "record": "records");
+
+unlock:
+	flock(lockfd, LOCK_UN);
+	close(lockfd);
+	while (old) {
+		LddRecord *next = old->next;
+		ldd_record_free(old);
+		old = next;
+	}
+out:
+	while (valid) {
+		LddRecord *next = valid->next;
+		ldd_record_free(valid);
+		valid = next;
+	}
+	free(fname);
+	free(tmpname);
+}
+
+// run fldd for all the queued files
+static void run_fldd(void) {
+	if (!ldd_first)
+		return;
+
+	// the list of files is passed to fldd on stdin
+	unlink(SBOX_STDIN_FILE);
+	FILE *fp = fopen(SBOX_STDIN_FILE, "w");
+	if (!fp)
+		errExit("fopen");
+	SET_PERMS_STREAM(fp, 0, 0, 0600);
+	int cnt = 0;
+	LddTarget *ptr = ldd_first;
+	while (ptr) {
+		fprintf(fp, "%s\n", ptr->name);
+		cnt++;
+
+		LddTarget *next = ptr->next;
+		free(ptr->name);
+		free(ptr);
+		ptr = next;
+	}
+	ldd_first = NULL;
+	ldd_last = NULL;
+	fclose(fp);
+
+	// create an empty RUN_LIB_FILE and RUN_LDD_INDEX_UPDATE and allow the user to write to them
 	unlink(RUN_LIB_FILE);			  // in case is there
 	create_empty_file_as_root(RUN_LIB_FILE, 0644);
 	if (chown(RUN_LIB_FILE, getuid(), getgid()))
 		errExit("chown");
+	unlink(RUN_LDD_INDEX_UPDATE);
+	create_empty_file_as_root(RUN_LDD_INDEX_UPDATE, 0644);
+	if (chown(RUN_LDD_INDEX_UPDATE, getuid(), getgid()))
+		errExit("chown");
 
 	// run fldd to extact the list of files
 	if (arg_debug || arg_debug_private_lib)
-		printf("    running fldd %s\n", full_path);
-	sbox_run(SBOX_USER | SBOX_SECCOMP | SBOX_CAPS_NONE, 3, PATH_FLDD, full_path, RUN_LIB_FILE);
+		printf("    running fldd for %d %s\n", cnt, (cnt == 1)? "file": "files");
+	char *index;
+	if (asprintf(&index, "--index=%s/%u", RUN_FIREJAIL_LDD_DIR, getuid()) == -1)
+		errExit("asprintf");
+	sbox_run(SBOX_USER | SBOX_SECCOMP | SBOX_CAPS_NONE | SBOX_STDIN_FROM_FILE, 5, PATH_FLDD,
+		index, "--index-update=" RUN_LDD_INDEX_UPDATE, "--batch", RUN_LIB_FILE);
+	unlink(SBOX_STDIN_FILE);
+	free(index);
+	ldd_index_merge();
 
 	// open the list of libraries and install them on by one
-	FILE *fp = fopen(RUN_LIB_FILE, "r");
+	fp = fopen(RUN_LIB_FILE, "r");
 	if (!fp)
 		errExit("fopen");
 
@@ -135,6 +335,12 @@ void fslib_copy_libs(const char *full_path) {
 	fclose(fp);
 }
 
+// resolve the queued files and copy all the libraries found so far
+void fslib_install_pending(void) {
+	run_fldd();
+	sbox_fcopy_run(SBOX_ROOT| SBOX_SECCOMP);
+}
+
 
 void fslib_copy_dir(const char *full_path) {
 	assert(full_path);
@@ -260,7 +466,6 @@ void fslib_install_list(const char *lib_list) {
 	while ((ptr = strtok(NULL, ",")) != NULL)
 		install_list_entry(ptr);
 	free(dlist);
-	fs_logger_print();
 }
 
 
@@ -359,6 +564,9 @@ void fs_private_lib(void) {
 			printf("Processing private-bin files\n");
 		fslib_install_list(cfg.bin_private_lib);
 	}
+
+	// resolve and copy all the libraries using a single fldd and a single fcopy process
+	fslib_install_pending();
 	fmessage("Program libraries installed in %0.2f ms\n", timetrace_end());
 
 	// install the reset of the system libraries
@@ -369,6 +577,7 @@ void fs_private_lib(void) {
 	// bring in firejail directory for --trace and seccomp post exec
 	// bring in firejail executable libraries in case we are redirected here by a firejail symlink from /usr/local/bin/firejail
 	fslib_install_list("/usr/bin/firejail,firejail"); // todo: use the installed path for the executable
+	fslib_install_pending();
 
 	fmessage("Installed %d %s and %d %s\n", lib_cnt, (lib_cnt == 1)? "library": "libraries",
 		dir_cnt, (dir_cnt == 1)? "directory": "directories");
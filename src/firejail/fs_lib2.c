@@ -24,6 +24,7 @@
 extern void fslib_duplicate(const char *full_path);
 extern void fslib_copy_libs(const char *full_path);
 extern void fslib_copy_dir(const char *full_path);
+extern void fslib_install_pending(void);
 
 //***************************************************************
 // Standard C library
@@ -118,6 +119,7 @@ void fslib_install_stdc(void) {
 	if (stat("/usr/lib/locale", &s) == 0)
 		fslib_copy_dir("/usr/lib/locale");
 
+	fslib_install_pending();
 	fmessage("Standard C library installed in %0.2f ms\n", timetrace_end());
 }
 
@@ -252,12 +254,15 @@ void fslib_install_system(void) {
 	else
 		assert(0);
 
-	// install required directories
+	// install required directories; the libraries are resolved and copied
+	// in a single pass at the end
+	timetrace_start();
+	int found = 0;
 	SysLib *ptr = &syslibs[0];
 	while (ptr->library) {
 		if (ptr->found) {
 			assert(*ptr->message != '\0');
-			timetrace_start();
+			found = 1;
 
 			// bring in all libraries
 			assert(ptr->dir1);
@@ -302,10 +307,15 @@ void fslib_install_system(void) {
 				free(name);
 			}
 
-			fmessage("%s installed in %0.2f ms\n", ptr->message, timetrace_end());
+			fmessage("Installing %s\n", ptr->message);
 		}
 		ptr++;
 	}
+
+	if (found) {
+		fslib_install_pending();
+		fmessage("System libraries installed in %0.2f ms\n", timetrace_end());
+	}
 }
 
 
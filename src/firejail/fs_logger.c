@@ -18,103 +18,197 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+// Filesystem log
+//
+// The messages are appended to an arena in their final text form, one line
+// each, and the arena is written to RUN_FSLOGGER_FILE with a single write()
+// at the end of the sandbox construction. The blacklist index used by
+// libtracelog is built from the same arena.
 #include "firejail.h"
+#include "../include/fslogger.h"
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <unistd.h>
 
 #define MAXBUF 4098
+#define ARENA_CHUNK (64 * 1024)
 
-typedef struct fs_msg_t {
-	struct fs_msg_t *next;
-	char *msg;
-} FsMsg;
+static char *arena = NULL;
+static size_t arena_len = 0;
+static size_t arena_size = 0;
+static size_t arena_flushed = 0;	// bytes already written in RUN_FSLOGGER_FILE
 
-static FsMsg *head = NULL;
+// append "msg1 msg2 msg3\n" to the arena; msg2 and msg3 are optional
+static void arena_append(const char *msg1, const char *msg2, const char *msg3) {
+	assert(msg1);
+	size_t len1 = strlen(msg1);
+	size_t len2 = (msg2)? strlen(msg2) + 1: 0;
+	size_t len3 = (msg3)? strlen(msg3) + 1: 0;
+	size_t len = len1 + len2 + len3 + 1;
 
-static inline FsMsg *newmsg(void) {
-	FsMsg *ptr = malloc(sizeof(FsMsg));
-	if (!ptr)
-		errExit("malloc");
-	memset(ptr, 0, sizeof(FsMsg));
-	return ptr;
-}
-
-static inline void insertmsg(FsMsg *ptr) {
-	static FsMsg *last = NULL;
-	if (head == NULL) {
-		head = ptr;
-		last = ptr;
-		return;
+	if (arena_len + len > arena_size) {
+		while (arena_len + len > arena_size)
+			arena_size += ARENA_CHUNK;
+		arena = realloc(arena, arena_size);
+		if (!arena)
+			errExit("realloc");
 	}
 
-	assert(last);
-	last->next = ptr;
-	last = ptr;
+	char *ptr = arena + arena_len;
+	memcpy(ptr, msg1, len1);
+	ptr += len1;
+	if (msg2) {
+		*ptr++ = ' ';
+		memcpy(ptr, msg2, len2 - 1);
+		ptr += len2 - 1;
+	}
+	if (msg3) {
+		*ptr++ = ' ';
+		memcpy(ptr, msg3, len3 - 1);
+		ptr += len3 - 1;
+	}
+	*ptr = '\n';
+	arena_len += len;
 }
 
 void fs_logger(const char *msg) {
-	FsMsg *ptr = newmsg();
-	ptr->msg = strdup(msg);
-	if (!ptr->msg)
-		errExit("strdup");
-	insertmsg(ptr);
+	arena_append(msg, NULL, NULL);
 }
 
 void fs_logger2(const char *msg1, const char *msg2) {
-	FsMsg *ptr = newmsg();
-	char *str;
-	if (asprintf(&str, "%s %s", msg1, msg2) == -1)
-		errExit("asprintf");
-	ptr->msg = str;
-	insertmsg(ptr);
+	arena_append(msg1, msg2, NULL);
 }
 
 void fs_logger2int(const char *msg1, int d) {
-	FsMsg *ptr = newmsg();
-	char *str;
-	if (asprintf(&str, "%s %d", msg1, d) == -1)
-		errExit("asprintf");
-	ptr->msg = str;
-	insertmsg(ptr);
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%d", d);
+	arena_append(msg1, buf, NULL);
 }
 
 void fs_logger3(const char *msg1, const char *msg2, const char *msg3) {
-	FsMsg *ptr = newmsg();
-	char *str;
-	if (asprintf(&str, "%s %s %s", msg1, msg2, msg3) == -1)
-		errExit("asprintf");
-	ptr->msg = str;
-	insertmsg(ptr);
+	arena_append(msg1, msg2, msg3);
+}
+
+static int write_all(int fd, const char *buf, size_t len) {
+	while (len) {
+		ssize_t rv = write(fd, buf, len);
+		if (rv == -1 && errno == EINTR)
+			continue;
+		if (rv <= 0)
+			return -1;
+		buf += rv;
+		len -= rv;
+	}
+	return 0;
+}
+
+static int entry_compare(const void *p1, const void *p2) {
+	const FsloggerEntry *e1 = p1;
+	const FsloggerEntry *e2 = p2;
+	if (e1->hash != e2->hash)
+		return (e1->hash < e2->hash)? -1: 1;
+	return (e1->str < e2->str)? -1: (e1->str > e2->str);
+}
+
+// build RUN_FSLOGGER_INDEX_FILE from the whole log
+static void build_index(void) {
+	FsloggerIndex hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = FSLOGGER_INDEX_MAGIC;
+	hdr.pid = FSLOGGER_INDEX_NONE;
+	hdr.name = FSLOGGER_INDEX_NONE;
+
+	// the string table is never larger than the log
+	char *str = malloc(arena_len + 1);
+	size_t max = arena_len / 11 + 1;	// "blacklist x\n" is the shortest entry
+	FsloggerEntry *entries = malloc(max * sizeof(FsloggerEntry));
+	if (!str || !entries)
+		errExit("malloc");
+
+	char *ptr = arena;
+	char *end = arena + arena_len;
+	while (ptr < end) {
+		char *eol = memchr(ptr, '\n', end - ptr);
+		assert(eol);
+		uint32_t *target = NULL;
+		size_t skip = 0;
+		if (eol - ptr > 10 && strncmp(ptr, "blacklist ", 10) == 0) {
+			assert(hdr.count < max);
+			target = &entries[hdr.count].str;
+			skip = 10;
+		}
+		else if (hdr.pid == FSLOGGER_INDEX_NONE && eol - ptr > 13 && strncmp(ptr, "sandbox pid: ", 13) == 0) {
+			target = &hdr.pid;
+			skip = 13;
+		}
+		else if (hdr.name == FSLOGGER_INDEX_NONE && eol - ptr > 14 && strncmp(ptr, "sandbox name: ", 14) == 0) {
+			target = &hdr.name;
+			skip = 14;
+		}
+
+		if (target) {
+			size_t len = eol - ptr - skip;
+			*target = hdr.strsize;
+			memcpy(str + hdr.strsize, ptr + skip, len);
+			str[hdr.strsize + len] = '\0';
+			if (skip == 10)
+				entries[hdr.count++].hash = fslogger_hash(str + hdr.strsize);
+			hdr.strsize += len + 1;
+		}
+		ptr = eol + 1;
+	}
+	qsort(entries, hdr.count, sizeof(FsloggerEntry), entry_compare);
+
+	int fd = open(RUN_FSLOGGER_INDEX_FILE, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd == -1)
+		perror("open");
+	else {
+		SET_PERMS_FD(fd, getuid(), getgid(), 0644);
+		struct iovec iov[3] = {
+			{ &hdr, sizeof(hdr) },
+			{ entries, hdr.count * sizeof(FsloggerEntry) },
+			{ str, hdr.strsize }
+		};
+		ssize_t len = sizeof(hdr) + hdr.count * sizeof(FsloggerEntry) + hdr.strsize;
+		if (writev(fd, iov, 3) != len) {
+			// libtracelog falls back to the text log
+			int rv = ftruncate(fd, 0);
+			(void) rv;
+		}
+		close(fd);
+	}
+	free(entries);
+	free(str);
 }
 
 void fs_logger_print(void) {
-	if (!head)
+	if (arena_flushed == arena_len)
 		return;
 
-	FILE *fp = fopen(RUN_FSLOGGER_FILE, "a");
-	if (!fp) {
-		perror("fopen");
+	int fd = open(RUN_FSLOGGER_FILE, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (fd == -1) {
+		perror("open");
 		return;
 	}
-	SET_PERMS_STREAM_NOERR(fp, getuid(), getgid(), 0644);
-
-	FsMsg *ptr = head;
-	while (ptr) {
-		fprintf(fp, "%s\n", ptr->msg);
-		FsMsg *next = ptr->next;
-		// remove message
-		free(ptr->msg);
-		free(ptr);
-		ptr = next;
-	}
-	head = NULL;
-	fclose(fp);
+	int rv = fchmod(fd, 0644);
+	rv |= fchown(fd, getuid(), getgid());
+	(void) rv;
+	if (write_all(fd, arena + arena_flushed, arena_len - arena_flushed))
+		perror("write");
+	close(fd);
+	arena_flushed = arena_len;
+
+	build_index();
 }
 
 void fs_logger_change_owner(void) {
 	if (chown(RUN_FSLOGGER_FILE, 0, 0) == -1)
 		errExit("chown");
+	if (chown(RUN_FSLOGGER_INDEX_FILE, 0, 0) == -1 && errno != ENOENT)
+		errExit("chown");
 }
 
 void fs_logger_print_log(pid_t pid) {
@@ -145,6 +145,105 @@ errout:
 	return NULL;
 }
 
+//***********************************************
+// whitelist planner
+//***********************************************
+// The whitelisted paths are stored in a path trie. Entries are mounted in the
+// order of their path depth, and an entry is dropped if one of its parent
+// directories was already whitelisted: the parent mount brings in the same file.
+// The trie also remembers the directories created by mkpath(), so the path
+// is not walked again for every whitelisted file in the same directory.
+typedef struct wl_node_t {
+	struct wl_node_t *child;	// first child
+	struct wl_node_t *next;		// next sibling
+	char *name;			// path component
+	int mounted;			// directory whitelisted, everything below is covered
+	int created;			// directory present in the sandbox
+} WlNode;
+static WlNode wl_root;
+
+static void wl_free(WlNode *node) {
+	WlNode *ptr = node->child;
+	while (ptr) {
+		WlNode *next = ptr->next;
+		wl_free(ptr);
+		free(ptr->name);
+		free(ptr);
+		ptr = next;
+	}
+	node->child = NULL;
+}
+
+// find the child node, create it if necessary
+static WlNode *wl_child(WlNode *node, const char *name, size_t len) {
+	WlNode *ptr;
+	for (ptr = node->child; ptr; ptr = ptr->next) {
+		if (strncmp(ptr->name, name, len) == 0 && ptr->name[len] == '\0')
+			return ptr;
+	}
+
+	ptr = calloc(1, sizeof(WlNode));
+	if (!ptr)
+		errExit("calloc");
+	ptr->name = strndup(name, len);
+	if (!ptr->name)
+		errExit("strndup");
+	ptr->next = node->child;
+	node->child = ptr;
+	return ptr;
+}
+
+// walk the trie for path; stop at the first whitelisted directory
+static WlNode *wl_walk(const char *path, int *covered) {
+	WlNode *node = &wl_root;
+	*covered = 0;
+	const char *ptr = path;
+	while (*ptr) {
+		while (*ptr == '/')
+			ptr++;
+		if (*ptr == '\0')
+			break;
+		size_t len = strcspn(ptr, "/");
+		node = wl_child(node, ptr, len);
+		if (node->mounted) {
+			*covered = 1;
+			break;
+		}
+		ptr += len;
+	}
+	return node;
+}
+
+// a directory was whitelisted; the nodes below are not needed anymore
+static void wl_mounted(const char *path) {
+	int covered;
+	WlNode *node = wl_walk(path, &covered);
+	if (covered)
+		return;
+	wl_free(node);
+	node->mounted = 1;
+}
+
+static int wl_covered(const char *path) {
+	int covered;
+	wl_walk(path, &covered);
+	return covered;
+}
+
+typedef struct wl_plan_t {
+	ProfileEntry *entry;
+	int depth;
+	int index;
+} WlPlan;
+
+static int wl_plan_compare(const void *p1, const void *p2) {
+	const WlPlan *e1 = p1;
+	const WlPlan *e2 = p2;
+	if (e1->depth != e2->depth)
+		return e1->depth - e2->depth;
+	return e1->index - e2->index;
+}
+
 static int mkpath(const char* path, mode_t mode) {
 	assert(path && *path);
 
@@ -165,7 +264,18 @@ static int mkpath(const char* path, mode_t mode) {
 
 	char* p;
 	int done = 0;
-	for (p=strchr(file_path+1, '/'); p; p=strchr(p+1, '/')) {
+	WlNode *node = &wl_root;
+	const char *name = file_path + 1;
+	for (p=strchr(file_path+1, '/'); p; name = p + 1, p=strchr(p+1, '/')) {
+		// skip the directories already created; the trie is not used under a whitelisted directory
+		if (node && p != name) {
+			node = wl_child(node, name, p - name);
+			if (node->mounted)
+				node = NULL;
+			else if (node->created)
+				continue;
+		}
+
 		*p='\0';
 		if (mkdir(file_path, mode)==-1) {
 			if (errno != EEXIST) {
@@ -179,6 +289,8 @@ static int mkpath(const char* path, mode_t mode) {
 				errExit("set_perms");
 			done = 1;
 		}
+		if (node)
+			node->created = 1;
 
 		*p='/';
 	}
@@ -189,7 +301,8 @@ static int mkpath(const char* path, mode_t mode) {
 	return 0;
 }
 
-static void whitelist_path(ProfileEntry *entry) {
+// return 1 if a directory was mounted
+static int whitelist_path(ProfileEntry *entry) {
 	assert(entry);
 	const char *path = entry->data + 10;
 	assert(path);
@@ -199,7 +312,7 @@ static void whitelist_path(ProfileEntry *entry) {
 	if (entry->home_dir) {
 		if (strncmp(path, cfg.homedir, strlen(cfg.homedir)) != 0)
 			// symlink pointing outside /home, skip the mount
-			return;
+			return 0;
 
 		fname = path + strlen(cfg.homedir);
 
@@ -227,7 +340,7 @@ static void whitelist_path(ProfileEntry *entry) {
 	else if (entry->var_dir) {
 		if (strncmp(path, "/var/", 5) != 0)
 			// symlink pointing outside /var, skip the mount
-			return;
+			return 0;
 
 		fname = path + 5; // strlen("/var/")
 
@@ -237,7 +350,7 @@ static void whitelist_path(ProfileEntry *entry) {
 	else if (entry->dev_dir) {
 		if (strncmp(path, "/dev/", 5) != 0)
 			// symlink pointing outside /dev, skip the mount
-			return;
+			return 0;
 
 		fname = path + 5; // strlen("/dev/")
 
@@ -259,7 +372,7 @@ static void whitelist_path(ProfileEntry *entry) {
 	else if (entry->etc_dir) {
 		if (strncmp(path, "/etc/", 5) != 0)
 			// symlink pointing outside /etc, skip the mount
-			return;
+			return 0;
 
 		fname = path + 5; // strlen("/etc/")
 
@@ -288,14 +401,14 @@ static void whitelist_path(ProfileEntry *entry) {
 	EUID_ROOT();
 	if (fd == -1) {
 		free(wfile);
-		return;
+		return 0;
 	}
 	if (fstat(fd, &wfilestat) == -1)
 		errExit("fstat");
 	close(fd);
 	if (S_ISLNK(wfilestat.st_mode)) {
 		free(wfile);
-		return;
+		return 0;
 	}
 #endif
 
@@ -325,7 +438,7 @@ static void whitelist_path(ProfileEntry *entry) {
 	else {
 		if (!S_ISDIR(s.st_mode)) {
 			free(wfile);
-			return; // the file is already present
+			return 0; // the file is already present
 		}
 	}
 
@@ -336,16 +449,18 @@ static void whitelist_path(ProfileEntry *entry) {
 	int fd3 = safe_fd(path, O_PATH|O_NOFOLLOW|O_CLOEXEC);
 	if (fd3 == -1) {
 		free(wfile);
-		return;
+		return 0;
 	}
 	if (fstat(fd3, &s) == -1)
 		errExit("fstat");
 	if (!(S_ISDIR(s.st_mode) || S_ISREG(s.st_mode))) {
 		free(wfile);
 		close(fd3);
-		return;
+		return 0;
 	}
 
+	int mount_id = get_mount_id(fd3);
+
 	// mount via the link in /proc/self/fd
 	char *proc;
 	if (asprintf(&proc, "/proc/self/fd/%d", fd3) == -1)
@@ -355,14 +470,12 @@ static void whitelist_path(ProfileEntry *entry) {
 	free(proc);
 	close(fd3);
 
-	// check the last mount operation
-	MountData *mptr = get_last_mount(); // will do exit(1) if the mount cannot be found
-
-	if (strncmp(mptr->dir, path, strlen(path)) != 0)
+	// check the mount operation
+	if (check_mount(path, mount_id, 0))
 		errLogExit("invalid whitelist mount");
 	// No mounts are allowed on top level directories. A destination such as "/etc" is very bad!
 	//  - there should be more than one '/' char in dest string
-	if (mptr->dir == strrchr(mptr->dir, '/'))
+	if (path == strrchr(path, '/'))
 		errLogExit("invalid whitelist mount");
 	// confirm the correct file is mounted on path
 	int fd4 = safe_fd(path, O_PATH|O_NOFOLLOW|O_CLOEXEC);
@@ -375,7 +488,7 @@ static void whitelist_path(ProfileEntry *entry) {
 	close(fd4);
 
 	free(wfile);
-	return;
+	return S_ISDIR(wfilestat.st_mode);
 }
 
 
@@ -923,17 +1036,42 @@ void fs_whitelist(void) {
 
 
 	// go through profile rules again, and interpret whitelist commands
-	entry = cfg.profile;
-	while (entry) {
-		// handle only whitelist commands
-		if (strncmp(entry->data, "whitelist ", 10)) {
-			entry = entry->next;
+	// parent directories are mounted first, see the whitelist planner above
+	size_t plan_cnt = 0;
+	for (entry = cfg.profile; entry; entry = entry->next) {
+		if (strncmp(entry->data, "whitelist ", 10) == 0)
+			plan_cnt++;
+	}
+	WlPlan *plan = malloc((plan_cnt + 1) * sizeof(WlPlan));
+	if (!plan)
+		errExit("malloc");
+	size_t i = 0;
+	for (entry = cfg.profile; entry; entry = entry->next) {
+		if (strncmp(entry->data, "whitelist ", 10))
 			continue;
+		const char *ptr;
+		plan[i].entry = entry;
+		plan[i].depth = 0;
+		plan[i].index = i;
+		for (ptr = entry->data + 10; *ptr; ptr++) {
+			if (*ptr == '/')
+				plan[i].depth++;
 		}
+		i++;
+	}
+	qsort(plan, plan_cnt, sizeof(WlPlan), wl_plan_compare);
+
+	for (i = 0; i < plan_cnt; i++) {
+		entry = plan[i].entry;
 
-//printf("here %d#%s#\n", __LINE__, entry->data);
 		// whitelist the real file
-		whitelist_path(entry);
+		const char *path = entry->data + 10;
+		if (wl_covered(path)) {
+			if (arg_debug || arg_debug_whitelists)
+				printf("Whitelisting %s - covered by a parent directory\n", path);
+		}
+		else if (whitelist_path(entry))
+			wl_mounted(path);
 
 		// create the link if any
 		if (entry->link) {
@@ -949,9 +1087,9 @@ void fs_whitelist(void) {
 					printf("Created symbolic link %s -> %s\n", entry->link, entry->data + 10);
 			}
 		}
-
-		entry = entry->next;
 	}
+	free(plan);
+	wl_free(&wl_root);
 
 	// mask the real home directory, currently mounted on RUN_WHITELIST_HOME_DIR
 	if (home_dir) {
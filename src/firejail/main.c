@@ -124,12 +124,14 @@ int arg_memory_deny_write_execute = 0;		// block writable and executable memory
 int arg_notv = 0;	// --notv
 int arg_nodvd = 0; // --nodvd
 int arg_nodbus = 0; // -nodbus
+char *arg_fork_server = NULL;	// --fork-server
 int arg_nou2f = 0; // --nou2f
 int login_shell = 0;
 
 
 int parent_to_child_fds[2];
 int child_to_parent_fds[2];
+int parent_to_network_fds[2];
 
 char *fullargv[MAX_ARGS];			// expanded argv for restricted shell
 int fullargc = 0;
@@ -147,7 +149,8 @@ static void myexit(int rv) {
 	logmsg("exiting...");
 	if (!arg_command)
 		fmessage("\nParent is shutting down, bye...\n");
-
+	fork_server_cleanup();
+	startup_trace_close();
 
 	// delete sandbox files in shared memory
 	EUID_ROOT();
@@ -695,6 +698,15 @@ static void run_cmd_and_exit(int i, int argc, char **argv) {
 			exit_err_feature("join");
 
 	}
+	else if (strncmp(argv[i], "--fork-connect=", 15) == 0) {
+		if (checkcfg(CFG_FORK_SERVER)) {
+			logargs(argc, argv);
+			fork_server_connect(argv[i] + 15, argc, argv, i + 1);
+			exit(0);
+		}
+		else
+			exit_err_feature("fork server");
+	}
 	else if (strncmp(argv[i], "--join-or-start=", 16) == 0) {
 		// NOTE: this is first part of option handler,
 		// 		 sandbox name is set in other part
@@ -760,9 +772,41 @@ static void run_cmd_and_exit(int i, int argc, char **argv) {
 	else if (strncmp(argv[i], "--shutdown=", 11) == 0) {
 		logargs(argc, argv);
 
-		// shutdown sandbox by pid or by name
-		pid_t pid = require_pid(argv[i] + 11);
-		shut(pid);
+		// the grace period can be set anywhere on the command line
+		unsigned timeout = DEFAULT_SHUTDOWN_TIMEOUT;
+		int j;
+		for (j = 1; j < argc; j++) {
+			if (strncmp(argv[j], "--shutdown-timeout=", 19) == 0) {
+				char *end;
+				errno = 0;
+				unsigned long val = strtoul(argv[j] + 19, &end, 10);
+				if (errno || end == argv[j] + 19 || *end || val > 3600) {
+					fprintf(stderr, "Error: invalid --shutdown-timeout value\n");
+					exit(1);
+				}
+				timeout = val;
+			}
+		}
+
+		// shutdown sandboxes by pid or by name, comma separated list
+		char *list = strdup(argv[i] + 11);
+		if (!list)
+			errExit("strdup");
+		pid_t *pids = malloc((strlen(list) / 2 + 1) * sizeof(pid_t));
+		if (!pids)
+			errExit("malloc");
+		int cnt = 0;
+		char *saveptr;
+		char *ptr = strtok_r(list, ",", &saveptr);
+		while (ptr) {
+			pids[cnt++] = require_pid(ptr);
+			ptr = strtok_r(NULL, ",", &saveptr);
+		}
+		if (cnt == 0) {
+			fprintf(stderr, "Error: no sandbox specified\n");
+			exit(1);
+		}
+		shut(pids, cnt, timeout);
 		exit(0);
 	}
 
@@ -798,19 +842,20 @@ char *guess_shell(void) {
 	return shell;
 }
 
+// return the index of the argument, 0 if not found
 static int check_arg(int argc, char **argv, const char *argument, int strict) {
 	int i;
 	int found = 0;
 	for (i = 1; i < argc; i++) {
 		if (strict) {
 			if (strcmp(argv[i], argument) == 0) {
-				found = 1;
+				found = i;
 				break;
 			}
 		}
 		else {
 			if (strncmp(argv[i], argument, strlen(argument)) == 0) {
-				found = 1;
+				found = i;
 				break;
 			}
 		}
@@ -872,6 +917,11 @@ int main(int argc, char **argv) {
 	if (check_arg(argc, argv, "--quiet", 1))
 		arg_quiet = 1;
 
+	// start the startup profiler
+	int trace_index = check_arg(argc, argv, "--profile-startup=", 0);
+	if (trace_index)
+		startup_trace_open(argv[trace_index] + 18);
+
 	// cleanup at exit
 	EUID_ROOT();
 	atexit(clear_atexit);
@@ -886,7 +936,9 @@ int main(int argc, char **argv) {
 			(void) rv;
 			flock(lockfd_directory, LOCK_EX);
 		}
+		startup_phase_start("preproc_clean_run");
 		preproc_clean_run();
+		startup_phase_end();
 		flock(lockfd_directory, LOCK_UN);
 		close(lockfd_directory);
 	}
@@ -1061,6 +1113,10 @@ int main(int argc, char **argv) {
 	EUID_ASSERT();
 
 
+	// firejail.config is read on the first checkcfg() call, the profiles
+	// are read during command line parsing
+	startup_phase_start("config and profile");
+
 	// check for force-nonewprivs in /etc/firejail/firejail.config file
 	if (checkcfg(CFG_FORCE_NONEWPRIVS))
 		arg_nonewprivs = 1;
@@ -1741,6 +1797,16 @@ int main(int argc, char **argv) {
 			arg_nou2f = 1;
 		else if (strcmp(argv[i], "--nodbus") == 0)
 			arg_nodbus = 1;
+		else if (strncmp(argv[i], "--fork-server=", 14) == 0) {
+			if (checkcfg(CFG_FORK_SERVER))
+				arg_fork_server = argv[i] + 14;
+			else
+				exit_err_feature("fork server");
+		}
+		else if (strncmp(argv[i], "--profile-startup=", 18) == 0)
+			; // already processed
+		else if (strncmp(argv[i], "--shutdown-timeout=", 19) == 0)
+			; // used by --shutdown
 
 		//*************************************
 		// network
@@ -2399,6 +2465,7 @@ int main(int argc, char **argv) {
 				fmessage("\n** Note: you can use --noprofile to disable %s.profile **\n\n", profile_name);
 		}
 	}
+	startup_phase_end();
 	EUID_ASSERT();
 
 	// block X11 sockets
@@ -2438,6 +2505,8 @@ int main(int argc, char **argv) {
  		errExit("pipe");
  	if (pipe(child_to_parent_fds) < 0)
 		errExit("pipe");
+	if (pipe(parent_to_network_fds) < 0)
+		errExit("pipe");
 
 	if (arg_noroot && arg_overlay) {
 		fwarning("--overlay and --noroot are mutually exclusive, noroot disabled\n");
@@ -2449,7 +2518,7 @@ int main(int argc, char **argv) {
 	}
 
 
-	// set name and x11 run files
+	// set sandbox, name and x11 run files
 	EUID_ROOT();
 	lockfd_directory = open(RUN_DIRECTORY_LOCK_FILE, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
 	if (lockfd_directory != -1) {
@@ -2457,6 +2526,7 @@ int main(int argc, char **argv) {
 		(void) rv;
 		flock(lockfd_directory, LOCK_EX);
 	}
+	set_sandbox_run_file(sandbox_pid);
 	if (cfg.name)
 		set_name_run_file(sandbox_pid);
 	int display = x11_display();
@@ -2466,6 +2536,10 @@ int main(int argc, char **argv) {
 	close(lockfd_directory);
 	EUID_USER();
 
+	// the connections are passed to the sandbox init process
+	if (arg_fork_server)
+		fork_server_listen(arg_fork_server);
+
 	// clone environment
 	int flags = CLONE_NEWNS | CLONE_NEWPID | CLONE_NEWUTS | SIGCHLD;
 
@@ -2483,6 +2557,9 @@ int main(int argc, char **argv) {
 	else if (arg_debug)
 		printf("Using the local network stack\n");
 
+	// the events recorded so far are not inherited by the sandbox
+	startup_trace_flush();
+
 	EUID_ASSERT();
 	EUID_ROOT();
 	child = clone(sandbox,
@@ -2500,7 +2577,19 @@ int main(int argc, char **argv) {
 			printf("The new log directory is /proc/%d/root/var/log\n", child);
 	}
 
+	EUID_ASSERT();
+
+ 	// close each end of the unused pipes
+ 	close(parent_to_child_fds[0]);
+ 	close(child_to_parent_fds[1]);
+	close(parent_to_network_fds[0]);
+
+	// notify child that base setup is complete; the child builds the filesystem
+	// while the host side of the network is configured
+ 	notify_other(parent_to_child_fds[1]);
+
 	if (!arg_nonetwork) {
+		startup_phase_start("network (host)");
 		EUID_ROOT();
 		pid_t net_child = fork();
 		if (net_child < 0)
@@ -2523,15 +2612,15 @@ int main(int argc, char **argv) {
 		// wait for the child to finish
 		waitpid(net_child, NULL, 0);
 		EUID_USER();
+		startup_phase_end();
+		startup_trace_flush();
 	}
 	EUID_ASSERT();
 
- 	// close each end of the unused pipes
- 	close(parent_to_child_fds[0]);
- 	close(child_to_parent_fds[1]);
-
-	// notify child that base setup is complete
- 	notify_other(parent_to_child_fds[1]);
+	// notify the network configuration process in the sandbox that the interfaces are in place
+	if (!arg_nonetwork && !arg_netns && (any_bridge_configured() || any_interface_configured()))
+		notify_other(parent_to_network_fds[1]);
+	close(parent_to_network_fds[1]);
 
  	// wait for child to create new user namespace with CLONE_NEWUSER
  	wait_for_other(child_to_parent_fds[0]);
@@ -2618,6 +2707,8 @@ int main(int argc, char **argv) {
 
 	// wait for the child to finish
 	EUID_USER();
+	if (arg_fork_server)
+		fork_server_relay(child);
 	int status = 0;
 	waitpid(child, &status, 0);
 
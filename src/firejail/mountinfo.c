@@ -19,6 +19,10 @@
 */
 
 #include "firejail.h"
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+#include <fcntl.h>
 
 #define MAX_BUF 4096
 static char mbuf[MAX_BUF];
@@ -127,3 +131,90 @@ errexit:
 	fprintf(stderr, "Error: cannot read /proc/self/mountinfo\n");
 	exit(1);
 }
+
+// Get the mount ID of an open file descriptor, -1 if the kernel doesn't report it.
+// statx(2) reports the mount ID starting with Linux 5.8; older kernels have it in
+// /proc/self/fdinfo.
+int get_mount_id(int fd) {
+#ifdef STATX_MNT_ID
+	struct statx stx;
+	if (statx(fd, "", AT_EMPTY_PATH | AT_SYMLINK_NOFOLLOW, STATX_MNT_ID, &stx) == 0 &&
+	    (stx.stx_mask & STATX_MNT_ID))
+		return (int) stx.stx_mnt_id;
+#endif
+
+	char *fname;
+	if (asprintf(&fname, "/proc/self/fdinfo/%d", fd) == -1)
+		errExit("asprintf");
+	FILE *fp = fopen(fname, "re");
+	free(fname);
+	if (!fp)
+		return -1;
+
+	int rv = -1;
+	char buf[256];
+	while (fgets(buf, sizeof(buf), fp)) {
+		if (sscanf(buf, "mnt_id: %d", &rv) == 1)
+			break;
+	}
+	fclose(fp);
+	return rv;
+}
+
+// open a path without following symbolic links
+static int open_path(const char *path) {
+	if (strcmp(path, "/") == 0)
+		return open("/", O_PATH|O_DIRECTORY|O_CLOEXEC);
+	return safe_fd(path, O_PATH|O_NOFOLLOW|O_CLOEXEC);
+}
+
+// Confirm the last mount operation landed on path: the path, resolved without
+// following symbolic links, is the root of a mount different from the one found
+// there before the operation (mount_id). Unlike get_last_mount(), the cost doesn't
+// depend on the number of mounts in the sandbox. If mount IDs are not available,
+// the function falls back on get_last_mount().
+// Return 0 if the mount was confirmed, -1 otherwise.
+int check_mount(const char *path, int mount_id, int tmpfs) {
+	assert(path);
+	if (mount_id == -1) {
+		// recursive bind mounts end with the submounts of path
+		MountData *mptr = get_last_mount();
+		size_t len = strlen(path);
+		if (strncmp(mptr->dir, path, len) != 0 ||
+		    (mptr->dir[len] != '\0' && mptr->dir[len] != '/') ||
+		    (tmpfs && strcmp(mptr->fstype, "tmpfs") != 0))
+			return -1;
+		return 0;
+	}
+
+	int fd = open_path(path);
+	if (fd == -1)
+		return -1;
+	int id = get_mount_id(fd);
+	struct statfs fs;
+	int rv = (id == -1 || id == mount_id ||
+		  (tmpfs && (fstatfs(fd, &fs) == -1 || fs.f_type != TMPFS_MAGIC)))? -1: 0;
+	close(fd);
+	if (rv == -1 || strcmp(path, "/") == 0)
+		return rv;
+
+	// a mount on a parent directory would also change the mount ID
+	char *parent = strdup(path);
+	if (!parent)
+		errExit("strdup");
+	char *ptr = strrchr(parent, '/');
+	assert(ptr);
+	if (ptr == parent)
+		ptr++;
+	*ptr = '\0';
+	fd = open_path(parent);
+	if (fd == -1 || get_mount_id(fd) == id)
+		rv = -1;
+	if (fd != -1)
+		close(fd);
+	free(parent);
+
+	if (arg_debug)
+		printf("Mount ID %d on %s%s\n", id, path, (rv)? " - invalid": "");
+	return rv;
+}
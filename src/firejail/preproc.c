@@ -50,6 +50,14 @@ void preproc_build_firejail_dir(void) {
 		create_empty_dir_as_root(RUN_FIREJAIL_NAME_DIR, 0755);
 	}
 
+	if (stat(RUN_FIREJAIL_SANDBOX_DIR, &s)) {
+		create_empty_dir_as_root(RUN_FIREJAIL_SANDBOX_DIR, 0755);
+	}
+
+	if (stat(RUN_FIREJAIL_FORK_DIR, &s)) {
+		create_empty_dir_as_root(RUN_FIREJAIL_FORK_DIR, 0755);
+	}
+
 	if (stat(RUN_FIREJAIL_PROFILE_DIR, &s)) {
 		create_empty_dir_as_root(RUN_FIREJAIL_PROFILE_DIR, 0755);
 	}
@@ -62,6 +70,18 @@ void preproc_build_firejail_dir(void) {
 		create_empty_dir_as_root(RUN_FIREJAIL_APPIMAGE_DIR, 0755);
 	}
 
+	if (stat(RUN_FIREJAIL_LDD_DIR, &s)) {
+		create_empty_dir_as_root(RUN_FIREJAIL_LDD_DIR, 0755);
+	}
+
+	if (stat(RUN_FIREJAIL_PROFILE_CACHE_DIR, &s)) {
+		create_empty_dir_as_root(RUN_FIREJAIL_PROFILE_CACHE_DIR, 0755);
+	}
+
+	if (stat(RUN_FIREJAIL_SECCOMP_CACHE_DIR, &s)) {
+		create_empty_dir_as_root(RUN_FIREJAIL_SECCOMP_CACHE_DIR, 0755);
+	}
+
 	if (stat(RUN_MNT_DIR, &s)) {
 		create_empty_dir_as_root(RUN_MNT_DIR, 0755);
 	}
@@ -177,9 +197,10 @@ void preproc_clean_run(void) {
 	}
 	closedir(dir);
 
-	// clean profile and name directories
+	// clean profile, name and sandbox directories
 	clean_dir(RUN_FIREJAIL_PROFILE_DIR, pidarr, start_pid, max_pids);
 	clean_dir(RUN_FIREJAIL_NAME_DIR, pidarr, start_pid, max_pids);
+	clean_dir(RUN_FIREJAIL_SANDBOX_DIR, pidarr, start_pid, max_pids);
 
 	free(pidarr);
 }
@@ -18,7 +18,6 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 #include "firejail.h"
-#include <dirent.h>
 #include <sys/stat.h>
 extern char *xephyr_screen;
 
@@ -30,33 +29,15 @@ int profile_find(const char *name, const char *dir) {
 	assert(name);
 	assert(dir);
 
-	int rv = 0;
-	DIR *dp;
-	char *pname;
-	if (asprintf(&pname, "%s.profile", name) == -1)
-		errExit("asprintf");
-
-	dp = opendir (dir);
-	if (dp != NULL) {
-		struct dirent *ep;
-		while ((ep = readdir(dp)) != NULL) {
-			if (strcmp(ep->d_name, pname) == 0) {
-				if (arg_debug)
-					printf("Found %s profile in %s directory\n", name, dir);
-				char *etcpname;
-				if (asprintf(&etcpname, "%s/%s", dir, pname) == -1)
-					errExit("asprintf");
-				profile_read(etcpname);
-				free(etcpname);
-				rv = 1;
-				break;
-			}
-		}
-		(void) closedir (dp);
-	}
+	char *pname = profile_lookup(name, dir);
+	if (!pname)
+		return 0;
 
+	if (arg_debug)
+		printf("Found %s profile in %s directory\n", name, dir);
+	profile_read(pname);
 	free(pname);
-	return rv;
+	return 1;
 }
 
 
@@ -1226,6 +1207,7 @@ int profile_check_line(char *ptr, int lineno, const char *fname) {
 }
 
 // add a profile entry in cfg.profile list; use str to populate the list
+static ProfileEntry *profile_last = NULL;
 void profile_add(char *str) {
 	EUID_ASSERT();
 
@@ -1236,15 +1218,32 @@ void profile_add(char *str) {
 	prf->next = NULL;
 	prf->data = str;
 
-	// add prf to the list
-	if (cfg.profile == NULL) {
+	// add prf at the end of the list
+	if (cfg.profile == NULL)
 		cfg.profile = prf;
+	else
+		profile_last->next = prf;
+	profile_last = prf;
+}
+
+// process a profile line after the spaces and the comments were removed
+void profile_process_line(char *ptr, int lineno, const char *fname) {
+	EUID_ASSERT();
+
+	// process quiet
+	// todo: a quiet in the profile file cannot be disabled by --ignore on command line
+	if (strcmp(ptr, "quiet") == 0) {
+		if (is_in_ignore_list(ptr))
+			arg_quiet = 0;
+		else
+			arg_quiet = 1;
 		return;
 	}
-	ProfileEntry *ptr = cfg.profile;
-	while (ptr->next != NULL)
-		ptr = ptr->next;
-	ptr->next = prf;
+
+	// verify syntax, exit in case of error
+	if (profile_check_line(ptr, lineno, fname))
+		profile_add(ptr);
+// we cannot free ptr here, data is extracted from ptr and linked as a pointer in cfg structure
 }
 
 // read a profile file
@@ -1264,12 +1263,26 @@ void profile_read(const char *fname) {
 		fprintf(stderr, "Error: invalid profile file\n");
 		exit(1);
 	}
+
+	// use the compiled profile if the file and its include tree were not modified
+	if (include_level == 0) {
+		if (profile_cache_load(fname)) {
+			set_profile_run_file(getpid(), fname);
+			return;
+		}
+		profile_cache_start(fname);
+	}
+
 	if (access(fname, R_OK)) {
 		// if the file ends in ".local", do not exit
 		const char *base = gnu_basename(fname);
 		char *ptr = strstr(base, ".local");
-		if (ptr && strlen(ptr) == 6)
+		if (ptr && strlen(ptr) == 6) {
+			profile_cache_file(fname, NULL);
+			if (include_level == 0)
+				profile_cache_save();
 			return;
+		}
 
 		fprintf(stderr, "Error: cannot access profile file\n");
 		exit(1);
@@ -1297,6 +1310,7 @@ void profile_read(const char *fname) {
 		set_profile_run_file(getpid(), fname);
 
 	int msg_printed = 0;
+	int cache_idx = profile_cache_file(fname, fp);
 
 	// read the file line by line
 	char buf[MAX_READ + 1];
@@ -1315,17 +1329,15 @@ void profile_read(const char *fname) {
 		}
 
 		// process quiet
-		// todo: a quiet in the profile file cannot be disabled by --ignore on command line
 		if (strcmp(ptr, "quiet") == 0) {
-			if (is_in_ignore_list(ptr))
-				arg_quiet = 0;
-			else
-				arg_quiet = 1;
+			profile_cache_line(ptr, cache_idx, lineno);
+			profile_process_line(ptr, lineno, fname);
 			free(ptr);
 			continue;
 		}
 		if (!msg_printed) {
 			fmessage("Reading profile %s\n", fname);
+			profile_cache_message(cache_idx);
 			msg_printed = 1;
 		}
 
@@ -1348,16 +1360,15 @@ void profile_read(const char *fname) {
 			continue;
 		}
 
-		// verify syntax, exit in case of error
-		if (profile_check_line(ptr, lineno, fname))
-			profile_add(ptr);
-// we cannot free ptr here, data is extracted from ptr and linked as a pointer in cfg structure
-//		else {
-//			free(ptr);
-//		}
+		// the line is saved before profile_check_line() modifies it
+		profile_cache_line(ptr, cache_idx, lineno);
+		profile_process_line(ptr, lineno, fname);
 #ifdef HAVE_GCOV
 		__gcov_flush();
 #endif
 	}
 	fclose(fp);
+
+	if (include_level == 0)
+		profile_cache_save();
 }
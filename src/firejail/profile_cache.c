@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2014-2018 Firejail Authors
+ *
+ * This file is part of firejail project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+// Compiled profile cache
+//
+// A top-level profile is stored in the cache after its include tree was read
+// without errors. The cache file contains the stat information of all the files
+// in the include tree, including the missing .local files, and the profile lines
+// in the order they were read, with spaces removed and comments dropped.
+// The cache is used only if none of the files was modified, created or deleted.
+// The lines are still run through profile_check_line(), the cache removes only
+// the file reading and the parsing.
+//
+// The cache files are stored in RUN_FIREJAIL_PROFILE_CACHE_DIR, owned by root,
+// one file for each user and top-level profile:
+//	header | files | lines | string table
+#include "firejail.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdint.h>
+
+#define PCACHE_MAGIC 0x46504331	// "FPC1"
+#define PCACHE_VERSION 1
+#define PCACHE_MAX_SIZE (16 * 1024 * 1024)
+
+typedef struct pcache_header_t {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t key;		// offset of the key string in the string table
+	uint32_t files;		// number of files
+	uint32_t lines;		// number of lines
+	uint32_t strsize;	// size of the string table
+} PCacheHeader;
+
+typedef struct pcache_file_t {
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	int64_t ctime_sec;
+	int64_t ctime_nsec;
+	uint32_t name;		// offset in the string table
+	uint32_t exists;	// 0 for a missing .local file
+} PCacheFile;
+
+#define PCACHE_LINE 0		// profile line
+#define PCACHE_MESSAGE 1	// "Reading profile" message
+typedef struct pcache_line_t {
+	uint32_t str;		// offset in the string table
+	uint32_t file;		// index in the file table
+	uint32_t lineno;
+	uint32_t type;
+} PCacheLine;
+
+// cache builder
+typedef struct pcache_builder_t {
+	int active;
+	char *key;
+	PCacheFile *files;
+	uint32_t files_cnt;
+	uint32_t files_max;
+	PCacheLine *lines;
+	uint32_t lines_cnt;
+	uint32_t lines_max;
+	char *str;
+	uint32_t str_size;
+	uint32_t str_max;
+} PCacheBuilder;
+static PCacheBuilder builder;
+
+static char *cache_key(const char *fname) {
+	char *key;
+	if (asprintf(&key, "%s\n%s\n%d", fname, cfg.homedir, arg_allow_debuggers) == -1)
+		errExit("asprintf");
+	return key;
+}
+
+static char *cache_fname(const char *key) {
+	char *fname;
+	if (asprintf(&fname, "%s/%u-%016llx", RUN_FIREJAIL_PROFILE_CACHE_DIR, getuid(), str_hash64(key)) == -1)
+		errExit("asprintf");
+	return fname;
+}
+
+static void file_set_stat(PCacheFile *f, const struct stat *s) {
+	f->dev = s->st_dev;
+	f->ino = s->st_ino;
+	f->size = s->st_size;
+	f->mtime_sec = s->st_mtim.tv_sec;
+	f->mtime_nsec = s->st_mtim.tv_nsec;
+	f->ctime_sec = s->st_ctim.tv_sec;
+	f->ctime_nsec = s->st_ctim.tv_nsec;
+}
+
+// check the file was not modified since the cache was built
+static int file_check(const PCacheFile *f, const char *fname) {
+	if (!f->exists)
+		return access(fname, R_OK) != 0;
+
+	struct stat s;
+	if (stat(fname, &s) == -1 || access(fname, R_OK))
+		return 0;
+	PCacheFile tmp;
+	memset(&tmp, 0, sizeof(tmp));
+	file_set_stat(&tmp, &s);
+	return tmp.dev == f->dev && tmp.ino == f->ino && tmp.size == f->size &&
+		tmp.mtime_sec == f->mtime_sec && tmp.mtime_nsec == f->mtime_nsec &&
+		tmp.ctime_sec == f->ctime_sec && tmp.ctime_nsec == f->ctime_nsec;
+}
+
+static void builder_free(void) {
+	free(builder.key);
+	free(builder.files);
+	free(builder.lines);
+	free(builder.str);
+	memset(&builder, 0, sizeof(builder));
+}
+
+static uint32_t builder_add_str(const char *str) {
+	uint32_t len = strlen(str) + 1;
+	if (builder.str_size + len > builder.str_max) {
+		builder.str_max = (builder.str_max + len) * 2;
+		builder.str = realloc(builder.str, builder.str_max);
+		if (!builder.str)
+			errExit("realloc");
+	}
+	uint32_t rv = builder.str_size;
+	memcpy(builder.str + builder.str_size, str, len);
+	builder.str_size += len;
+	return rv;
+}
+
+static void builder_add_line(const char *str, int file, int lineno, uint32_t type) {
+	if (!builder.active || file < 0)
+		return;
+	if (builder.lines_cnt == builder.lines_max) {
+		builder.lines_max = (builder.lines_max)? builder.lines_max * 2: 256;
+		builder.lines = realloc(builder.lines, builder.lines_max * sizeof(PCacheLine));
+		if (!builder.lines)
+			errExit("realloc");
+	}
+	PCacheLine *l = &builder.lines[builder.lines_cnt++];
+	l->str = builder_add_str(str);
+	l->file = file;
+	l->lineno = lineno;
+	l->type = type;
+}
+
+// start building the cache for a top-level profile
+void profile_cache_start(const char *fname) {
+	assert(fname);
+	builder_free();
+
+	// relative paths depend on the current working directory
+	if (!checkcfg(CFG_PROFILE_CACHE) || *fname != '/')
+		return;
+
+	builder.active = 1;
+	builder.key = cache_key(fname);
+}
+
+// add a file to the cache; return the index of the file, or -1 if the cache is not active
+int profile_cache_file(const char *fname, FILE *fp) {
+	assert(fname);
+	if (!builder.active)
+		return -1;
+	if (*fname != '/') {
+		// relative include
+		builder_free();
+		return -1;
+	}
+
+	if (builder.files_cnt == builder.files_max) {
+		builder.files_max = (builder.files_max)? builder.files_max * 2: 16;
+		builder.files = realloc(builder.files, builder.files_max * sizeof(PCacheFile));
+		if (!builder.files)
+			errExit("realloc");
+	}
+	PCacheFile *f = &builder.files[builder.files_cnt];
+	memset(f, 0, sizeof(PCacheFile));
+	f->name = builder_add_str(fname);
+	if (fp) {
+		struct stat s;
+		if (fstat(fileno(fp), &s) == -1) {
+			builder_free();
+			return -1;
+		}
+		file_set_stat(f, &s);
+		f->exists = 1;
+	}
+	return builder.files_cnt++;
+}
+
+void profile_cache_message(int file) {
+	if (builder.active && file >= 0)
+		builder_add_line(builder.str + builder.files[file].name, file, 0, PCACHE_MESSAGE);
+}
+
+void profile_cache_line(const char *line, int file, int lineno) {
+	assert(line);
+	builder_add_line(line, file, lineno, PCACHE_LINE);
+}
+
+// the top-level profile was read without errors, save the cache file
+void profile_cache_save(void) {
+	if (!builder.active)
+		return;
+
+	PCacheHeader hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = PCACHE_MAGIC;
+	hdr.version = PCACHE_VERSION;
+	hdr.key = builder_add_str(builder.key);
+	hdr.files = builder.files_cnt;
+	hdr.lines = builder.lines_cnt;
+	hdr.strsize = builder.str_size;
+
+	char *fname = cache_fname(builder.key);
+	char *tmpname;
+	if (asprintf(&tmpname, "%s.%d", fname, getpid()) == -1)
+		errExit("asprintf");
+
+	EUID_ROOT();
+	int fd = open(tmpname, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (fd == -1)
+		goto out;
+	FILE *fp = fdopen(fd, "w");
+	if (!fp) {
+		close(fd);
+		unlink(tmpname);
+		goto out;
+	}
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+	fwrite(builder.files, sizeof(PCacheFile), builder.files_cnt, fp);
+	fwrite(builder.lines, sizeof(PCacheLine), builder.lines_cnt, fp);
+	fwrite(builder.str, 1, builder.str_size, fp);
+	if (ferror(fp) | fclose(fp) || rename(tmpname, fname))
+		unlink(tmpname);
+	else if (arg_debug)
+		printf("Profile cache %s saved\n", fname);
+
+out:
+	EUID_USER();
+	free(tmpname);
+	free(fname);
+	builder_free();
+}
+
+// load a top-level profile from the cache; return 1 if the profile was loaded
+int profile_cache_load(const char *fname) {
+	assert(fname);
+	if (!checkcfg(CFG_PROFILE_CACHE) || *fname != '/')
+		return 0;
+
+	char *key = cache_key(fname);
+	char *cname = cache_fname(key);
+
+	EUID_ROOT();
+	int fd = open(cname, O_RDONLY | O_CLOEXEC);
+	EUID_USER();
+	free(cname);
+	if (fd == -1) {
+		free(key);
+		return 0;
+	}
+
+	// the profile lines are used in place and the memory is never released:
+	// data is extracted from the lines and linked as a pointer in cfg structure
+	struct stat s;
+	char *base = MAP_FAILED;
+	if (fstat(fd, &s) == 0 && s.st_uid == 0 &&
+	    s.st_size >= (off_t) sizeof(PCacheHeader) && s.st_size <= PCACHE_MAX_SIZE)
+		base = mmap(NULL, s.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		free(key);
+		return 0;
+	}
+
+	// check the header
+	PCacheHeader *hdr = (PCacheHeader *) base;
+	uint64_t size = sizeof(PCacheHeader) + (uint64_t) hdr->files * sizeof(PCacheFile) +
+		(uint64_t) hdr->lines * sizeof(PCacheLine) + hdr->strsize;
+	if (hdr->magic != PCACHE_MAGIC || hdr->version != PCACHE_VERSION ||
+	    size != (uint64_t) s.st_size || hdr->strsize == 0)
+		goto errout;
+	PCacheFile *files = (PCacheFile *) (base + sizeof(PCacheHeader));
+	PCacheLine *lines = (PCacheLine *) (files + hdr->files);
+	char *str = (char *) (lines + hdr->lines);
+	if (str[hdr->strsize - 1] != '\0' || hdr->key >= hdr->strsize || strcmp(str + hdr->key, key))
+		goto errout;
+
+	// check the files
+	uint32_t i;
+	for (i = 0; i < hdr->files; i++) {
+		if (files[i].name >= hdr->strsize || !file_check(&files[i], str + files[i].name))
+			goto errout;
+	}
+	for (i = 0; i < hdr->lines; i++) {
+		if (lines[i].str >= hdr->strsize || lines[i].file >= hdr->files)
+			goto errout;
+	}
+	free(key);
+
+	if (arg_debug)
+		printf("Loading %s from the profile cache\n", fname);
+
+	// process the lines
+	for (i = 0; i < hdr->lines; i++) {
+		char *ptr = str + lines[i].str;
+		const char *pname = str + files[lines[i].file].name;
+		if (lines[i].type == PCACHE_MESSAGE)
+			fmessage("Reading profile %s\n", pname);
+		else
+			profile_process_line(ptr, lines[i].lineno, pname);
+	}
+	return 1;
+
+errout:
+	munmap(base, s.st_size);
+	free(key);
+	return 0;
+}
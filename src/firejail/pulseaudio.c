@@ -190,6 +190,8 @@ void pulseaudio_init(void) {
 		if (fstat(fd, &s) == -1 || s.st_uid != getuid())
 			errExit("fstat");
 
+		int mount_id = get_mount_id(fd);
+
 		// mount via the link in /proc/self/fd
 		char *proc;
 		if (asprintf(&proc, "/proc/self/fd/%d", fd) == -1)
@@ -199,9 +201,8 @@ void pulseaudio_init(void) {
 		fs_logger2("tmpfs", homeusercfg);
 		free(proc);
 		close(fd);
-		// check /proc/self/mountinfo to confirm the mount is ok
-		MountData *mptr = get_last_mount();
-		if (strcmp(mptr->dir, homeusercfg) != 0 || strcmp(mptr->fstype, "tmpfs") != 0)
+		// confirm the mount is ok
+		if (check_mount(homeusercfg, mount_id, 1))
 			errLogExit("invalid pulseaudio mount");
 
 		char *p;
@@ -40,6 +40,15 @@ static void delete_profile_run_file(pid_t pid) {
 	free(fname);
 }
 
+static void delete_sandbox_run_file(pid_t pid) {
+	char *fname;
+	if (asprintf(&fname, "%s/%d", RUN_FIREJAIL_SANDBOX_DIR, pid) == -1)
+		errExit("asprintf");
+	int rv = unlink(fname);
+	(void) rv;
+	free(fname);
+}
+
 static void delete_name_run_file(pid_t pid) {
 	char *fname;
 	if (asprintf(&fname, "%s/%d", RUN_FIREJAIL_NAME_DIR, pid) == -1)
@@ -71,6 +80,7 @@ void delete_run_files(pid_t pid) {
 	delete_bandwidth_run_file(pid);
 	delete_network_run_file(pid);
 	delete_name_run_file(pid);
+	delete_sandbox_run_file(pid);
 	delete_x11_run_file(pid);
 	delete_profile_run_file(pid);
 }
@@ -122,6 +132,25 @@ void set_name_run_file(pid_t pid) {
 	fclose(fp);
 }
 
+// register the sandbox for firemon; the file is empty, the pid is the file name
+void set_sandbox_run_file(pid_t pid) {
+	char *fname;
+	if (asprintf(&fname, "%s/%d", RUN_FIREJAIL_SANDBOX_DIR, pid) == -1)
+		errExit("asprintf");
+
+	// the file is deleted first
+	FILE *fp = fopen(fname, "w");
+	if (!fp) {
+		fprintf(stderr, "Error: cannot create %s\n", fname);
+		exit(1);
+	}
+
+	// mode and ownership
+	SET_PERMS_STREAM(fp, 0, 0, 0644);
+	fclose(fp);
+	free(fname);
+}
+
 
 void set_x11_run_file(pid_t pid, int display) {
 	char *fname;
@@ -26,6 +26,9 @@
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <sys/types.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <poll.h>
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -57,9 +60,21 @@ static void sandbox_handler(int sig){
 
 	// broadcast sigterm to all processes in the group
 	kill(-1, SIGTERM);
-	sleep(1);
 
-	if (monitored_pid) {
+	// wait for not more than 10 seconds
+	int pidfd = (monitored_pid)? pid_fd_open(monitored_pid): -1;
+	if (pidfd != -1) {
+		struct pollfd fds;
+		fds.fd = pidfd;
+		fds.events = POLLIN;
+		fds.revents = 0;
+		int rv = poll(&fds, 1, 10000);
+		(void) rv;
+		close(pidfd);
+	}
+	else if (monitored_pid && errno != ESRCH) {
+		// no pidfd support
+		sleep(1);
 		int monsec = 9;
 		char *monfile;
 		if (asprintf(&monfile, "/proc/%d/cmdline", monitored_pid) == -1)
@@ -189,6 +204,135 @@ static void sandbox_if_up(Bridge *br) {
 		 net_if_ip6(dev, br->ip6sandbox);
 }
 
+// print network configuration
+static void print_network_config(int gw_cfg_failed) {
+	if (arg_quiet)
+		return;
+	if (any_bridge_configured() || any_interface_configured() || cfg.defaultgw || cfg.dns1) {
+		fmessage("\n");
+		if (any_bridge_configured() || any_interface_configured()) {
+			if (arg_scan)
+				sbox_run(SBOX_ROOT | SBOX_CAPS_NETWORK | SBOX_SECCOMP, 3, PATH_FNET, "printif", "scan");
+			else
+				sbox_run(SBOX_ROOT | SBOX_CAPS_NETWORK | SBOX_SECCOMP, 2, PATH_FNET, "printif");
+
+		}
+		if (cfg.defaultgw != 0) {
+			if (gw_cfg_failed)
+				fmessage("Default gateway configuration failed\n");
+			else
+				fmessage("Default gateway %d.%d.%d.%d\n", PRINT_IP(cfg.defaultgw));
+		}
+		if (cfg.dns1 != NULL)
+			fmessage("DNS server %s\n", cfg.dns1);
+		if (cfg.dns2 != NULL)
+			fmessage("DNS server %s\n", cfg.dns2);
+		if (cfg.dns3 != NULL)
+			fmessage("DNS server %s\n", cfg.dns3);
+		if (cfg.dns4 != NULL)
+			fmessage("DNS server %s\n", cfg.dns4);
+		fmessage("\n");
+	}
+}
+
+// configure the interfaces moved into the sandbox by the parent
+static void sandbox_network(void) {
+	int gw_cfg_failed = 0; // default gw configuration flag
+	// configure lo and eth0...eth3
+	net_if_up("lo");
+
+	if (mac_not_zero(cfg.bridge0.macsandbox))
+		net_config_mac(cfg.bridge0.devsandbox, cfg.bridge0.macsandbox);
+	sandbox_if_up(&cfg.bridge0);
+
+	if (mac_not_zero(cfg.bridge1.macsandbox))
+		net_config_mac(cfg.bridge1.devsandbox, cfg.bridge1.macsandbox);
+	sandbox_if_up(&cfg.bridge1);
+
+	if (mac_not_zero(cfg.bridge2.macsandbox))
+		net_config_mac(cfg.bridge2.devsandbox, cfg.bridge2.macsandbox);
+	sandbox_if_up(&cfg.bridge2);
+
+	if (mac_not_zero(cfg.bridge3.macsandbox))
+		net_config_mac(cfg.bridge3.devsandbox, cfg.bridge3.macsandbox);
+	sandbox_if_up(&cfg.bridge3);
+
+	// moving an interface in a namespace using --interface will reset the interface configuration;
+	// we need to put the configuration back
+	if (cfg.interface0.configured && cfg.interface0.ip) {
+		if (arg_debug)
+			printf("Configuring %d.%d.%d.%d address on interface %s\n", PRINT_IP(cfg.interface0.ip), cfg.interface0.dev);
+		net_config_interface(cfg.interface0.dev, cfg.interface0.ip, cfg.interface0.mask, cfg.interface0.mtu);
+	}
+	if (cfg.interface1.configured && cfg.interface1.ip) {
+		if (arg_debug)
+			printf("Configuring %d.%d.%d.%d address on interface %s\n", PRINT_IP(cfg.interface1.ip), cfg.interface1.dev);
+		net_config_interface(cfg.interface1.dev, cfg.interface1.ip, cfg.interface1.mask, cfg.interface1.mtu);
+	}
+	if (cfg.interface2.configured && cfg.interface2.ip) {
+		if (arg_debug)
+			printf("Configuring %d.%d.%d.%d address on interface %s\n", PRINT_IP(cfg.interface2.ip), cfg.interface2.dev);
+		net_config_interface(cfg.interface2.dev, cfg.interface2.ip, cfg.interface2.mask, cfg.interface2.mtu);
+	}
+	if (cfg.interface3.configured && cfg.interface3.ip) {
+		if (arg_debug)
+			printf("Configuring %d.%d.%d.%d address on interface %s\n", PRINT_IP(cfg.interface3.ip), cfg.interface3.dev);
+		net_config_interface(cfg.interface3.dev, cfg.interface3.ip, cfg.interface3.mask, cfg.interface3.mtu);
+	}
+
+	// add a default route
+	if (cfg.defaultgw) {
+		// set the default route
+		if (net_add_route(0, 0, cfg.defaultgw)) {
+			fwarning("cannot configure default route\n");
+			gw_cfg_failed = 1;
+		}
+	}
+
+	if (arg_debug)
+		printf("Network namespace enabled\n");
+	print_network_config(gw_cfg_failed);
+}
+
+// Interface configuration (ARP scans and probes, addresses, routes) runs in a separate
+// process, in parallel with the filesystem construction. The process has its own
+// copy of the mount namespace, the helpers it starts don't see the filesystem changes.
+static pid_t sandbox_network_start(void) {
+	fflush(0);
+	pid_t pid = fork();
+	if (pid == -1)
+		errExit("fork");
+	if (pid == 0) {
+		if (unshare(CLONE_NEWNS) == -1)
+			errExit("unshare");
+
+		// wait for the parent to create the interfaces
+		startup_trace_thread(STARTUP_NETWORK);
+		wait_for_other(parent_to_network_fds[0]);
+		close(parent_to_network_fds[0]);
+		startup_phase_start("network (sandbox)");
+		sandbox_network();
+		startup_phase_end();
+		startup_trace_flush();
+		fflush(0);
+		_exit(0);
+	}
+	return pid;
+}
+
+// wait for the network configuration to finish
+static void sandbox_network_wait(pid_t pid) {
+	int status;
+	if (waitpid(pid, &status, 0) == -1)
+		errExit("waitpid");
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "Error: cannot configure the network\n");
+		exit(1);
+	}
+	if (arg_debug)
+		printf("Network configuration process %d finished\n", pid);
+}
+
 static void chk_chroot(void) {
 	// if we are starting firejail inside some other container technology, we don't care about this
 	char *mycont = getenv("container");
@@ -206,22 +350,156 @@ static void chk_chroot(void) {
 	exit(1);
 }
 
+// reap the terminated children; return 1 if pid was reaped, its exit status is stored in status
+static int reap_children(pid_t pid, int *status) {
+	int rv = 0;
+	int st;
+	pid_t child;
+	while ((child = waitpid(-1, &st, WNOHANG)) > 0) {
+		if (arg_debug)
+			printf("Sandbox monitor: waitpid %u retval %d status %d\n", pid, child, st);
+		if (child == pid) {
+			*status = st;
+			rv = 1;
+		}
+	}
+	return rv;
+}
+
+// pick another process to monitor, it could be a process that joined the sandbox
+static pid_t find_monitored_pid(void) {
+	DIR *dir;
+	if (!(dir = opendir("/proc"))) {
+		// sleep 2 seconds and try again
+		sleep(2);
+		if (!(dir = opendir("/proc"))) {
+			fprintf(stderr, "Error: cannot open /proc directory\n");
+			exit(1);
+		}
+	}
+
+	struct dirent *entry;
+	pid_t rv = 0;
+	while ((entry = readdir(dir)) != NULL) {
+		unsigned pid;
+		if (sscanf(entry->d_name, "%u", &pid) != 1)
+			continue;
+		if (pid == 1)
+			continue;
+
+		// todo: make this generic
+		// Dillo browser leaves a dpid process running, we need to shut it down
+		int found = 0;
+		if (strcmp(cfg.command_name, "dillo") == 0) {
+			char *pidname = pid_proc_comm(pid);
+			if (pidname && strcmp(pidname, "dpid") == 0)
+				found = 1;
+			free(pidname);
+		}
+		if (found)
+			break;
+
+		rv = pid;
+		break;
+	}
+	closedir(dir);
+	return rv;
+}
+
+// wait for the monitored process to terminate
+static void monitor_wait(pid_t pid, int sfd, int tfd, int *status) {
+	// the processes joining the sandbox are not our children,
+	// they are followed using a pidfd
+	int pidfd = pid_fd_open(pid);
+	if (pidfd == -1 && errno == ESRCH) {
+		reap_children(pid, status);
+		return;
+	}
+
+	while (1) {
+		// the process might have terminated before SIGCHLD was blocked
+		if (reap_children(pid, status))
+			break;
+
+		struct pollfd fds[3];
+		int nfds = 0;
+		fds[nfds].fd = sfd;
+		fds[nfds++].events = POLLIN;
+		if (tfd != -1) {
+			fds[nfds].fd = tfd;
+			fds[nfds++].events = POLLIN;
+		}
+		if (pidfd != -1) {
+			fds[nfds].fd = pidfd;
+			fds[nfds++].events = POLLIN;
+		}
+
+		// without pidfd support the process is checked every second
+		int rv = poll(fds, nfds, (pidfd == -1)? 1000: -1);
+		if (rv == -1) {
+			if (errno == EINTR)
+				continue;
+			errExit("poll");
+		}
+
+		// handle --timeout
+		if (tfd != -1 && fds[1].revents) {
+			kill(-1, SIGTERM);
+			flush_stdin();
+			sleep(1);
+			_exit(1);
+		}
+
+		if (fds[0].revents) {
+			struct signalfd_siginfo si;
+			while (read(sfd, &si, sizeof(si)) == sizeof(si));
+		}
+
+		if (pidfd != -1) {
+			if (fds[nfds - 1].revents) {
+				reap_children(pid, status);
+				break;
+			}
+		}
+		else if (kill(pid, 0) == -1 && errno == ESRCH)
+			break;
+	}
+
+	if (pidfd != -1)
+		close(pidfd);
+}
+
 static int monitor_application(pid_t app_pid) {
 	monitored_pid = app_pid;
 	signal (SIGTERM, sandbox_handler);
 	EUID_USER();
 
+	// SIGCHLD is delivered on a signalfd; the application was started
+	// with the default signal mask
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	if (sigprocmask(SIG_BLOCK, &mask, NULL) == -1)
+		errExit("sigprocmask");
+	int sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (sfd == -1)
+		errExit("signalfd");
+
 	// handle --timeout
-	int options = 0;;
-	unsigned timeout = 0;
+	int tfd = -1;
 	if (cfg.timeout) {
-		options = WNOHANG;
-		timeout = cfg.timeout;
+		tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+		if (tfd == -1)
+			errExit("timerfd_create");
+		struct itimerspec its;
+		memset(&its, 0, sizeof(its));
+		its.it_value.tv_sec = cfg.timeout;
+		if (timerfd_settime(tfd, 0, &its, NULL) == -1)
+			errExit("timerfd_settime");
 	}
 
 	int status = 0;
 	while (monitored_pid) {
-		usleep(20000);
 		char *msg;
 		if (asprintf(&msg, "monitoring pid %d\n", monitored_pid) == -1)
 			errExit("asprintf");
@@ -230,73 +508,16 @@ static int monitor_application(pid_t app_pid) {
 			printf("%s\n", msg);
 		free(msg);
 
-		pid_t rv;
-		do {
-			rv = waitpid(-1, &status, options);
-			if (rv == -1)
-				break;
-
-			// handle --timeout
-			if (options) {
-				if (--timeout == 0)  {
-					kill(-1, SIGTERM);
-					flush_stdin();
-					sleep(1);
-					_exit(1);
-				}
-				else
-					sleep(1);
-			}
-		}
-		while(rv != monitored_pid);
-		if (arg_debug)
-			printf("Sandbox monitor: waitpid %u retval %d status %d\n", monitored_pid, rv, status);
-		if (rv == -1) { // we can get here if we have processes joining the sandbox (ECHILD)
-			if (arg_debug)
-				perror("waitpid");
-			sleep(1);
-		}
-
-		DIR *dir;
-		if (!(dir = opendir("/proc"))) {
-			// sleep 2 seconds and try again
-			sleep(2);
-			if (!(dir = opendir("/proc"))) {
-				fprintf(stderr, "Error: cannot open /proc directory\n");
-				exit(1);
-			}
-		}
-
-		struct dirent *entry;
-		monitored_pid = 0;
-		while ((entry = readdir(dir)) != NULL) {
-			unsigned pid;
-			if (sscanf(entry->d_name, "%u", &pid) != 1)
-				continue;
-			if (pid == 1)
-				continue;
-
-			// todo: make this generic
-			// Dillo browser leaves a dpid process running, we need to shut it down
-			int found = 0;
-			if (strcmp(cfg.command_name, "dillo") == 0) {
-				char *pidname = pid_proc_comm(pid);
-				if (pidname && strcmp(pidname, "dpid") == 0)
-					found = 1;
-				free(pidname);
-			}
-			if (found)
-				break;
-
-			monitored_pid = pid;
-			break;
-		}
-		closedir(dir);
-
+		monitor_wait(monitored_pid, sfd, tfd, &status);
+		monitored_pid = find_monitored_pid();
 		if (monitored_pid != 0 && arg_debug)
 			printf("Sandbox monitor: monitoring %u\n", monitored_pid);
 	}
 
+	close(sfd);
+	if (tfd != -1)
+		close(tfd);
+
 	// return the latest exit status.
 	return status;
 }
@@ -393,6 +614,7 @@ void start_application(int no_sandbox) {
 	//****************************************
 	if (arg_audit) {
 		assert(arg_audit_prog);
+		startup_trace_exec();
 #ifdef HAVE_GCOV
 		__gcov_dump();
 #endif
@@ -423,6 +645,7 @@ void start_application(int no_sandbox) {
 			print_time();
 
 		int rv = ok_to_run(cfg.original_argv[cfg.original_program_index]);
+		startup_trace_exec();
 #ifdef HAVE_GCOV
 		__gcov_dump();
 #endif
@@ -479,6 +702,7 @@ void start_application(int no_sandbox) {
 
 		if (!arg_command && !arg_quiet)
 			print_time();
+		startup_trace_exec();
 #ifdef HAVE_GCOV
 		__gcov_dump();
 #endif
@@ -492,6 +716,27 @@ void start_application(int no_sandbox) {
 	exit(1); // it should never get here!!!
 }
 
+// start the application in the process forked by the sandbox init
+void sandbox_start_application(void) {
+#ifdef HAVE_APPARMOR
+	if (checkcfg(CFG_APPARMOR) && arg_apparmor) {
+		errno = 0;
+		if (aa_change_onexec("firejail-default")) {
+			fwarning("Cannot confine the application using AppArmor.\n"
+				"Maybe firejail-default AppArmor profile is not loaded into the kernel.\n"
+				"As root, run \"aa-enforce firejail-default\" to load it.\n");
+		}
+		else if (arg_debug)
+			printf("AppArmor enabled\n");
+	}
+#endif
+
+	prctl(PR_SET_PDEATHSIG, SIGKILL, 0, 0, 0); // kill the child in case the parent died
+	startup_trace_thread(STARTUP_APP);
+	startup_phase_start("exec");
+	start_application(0);	// start app
+}
+
 static void enforce_filters(void) {
 	// force default seccomp inside the chroot, no keep or drop list
 	// the list build on top of the default drop list is kept intact
@@ -530,6 +775,8 @@ int sandbox(void* sandbox_arg) {
  	// close each end of the unused pipes
  	close(parent_to_child_fds[1]);
  	close(child_to_parent_fds[0]);
+	close(parent_to_network_fds[1]);
+	startup_trace_thread(STARTUP_SANDBOX);
 
  	// wait for parent to do base setup
  	wait_for_other(parent_to_child_fds[0]);
@@ -588,7 +835,7 @@ int sandbox(void* sandbox_arg) {
 	//****************************
 	// networking
 	//****************************
-	int gw_cfg_failed = 0; // default gw configuration flag
+	pid_t net_pid = 0;
 	if (arg_nonetwork) {
 		net_if_up("lo");
 		if (arg_debug)
@@ -599,91 +846,11 @@ int sandbox(void* sandbox_arg) {
 		if (arg_debug)
 			printf("Network namespace '%s' activated\n", arg_netns);
 	}
-	else if (any_bridge_configured() || any_interface_configured()) {
-		// configure lo and eth0...eth3
-		net_if_up("lo");
-
-		if (mac_not_zero(cfg.bridge0.macsandbox))
-			net_config_mac(cfg.bridge0.devsandbox, cfg.bridge0.macsandbox);
-		sandbox_if_up(&cfg.bridge0);
-
-		if (mac_not_zero(cfg.bridge1.macsandbox))
-			net_config_mac(cfg.bridge1.devsandbox, cfg.bridge1.macsandbox);
-		sandbox_if_up(&cfg.bridge1);
-
-		if (mac_not_zero(cfg.bridge2.macsandbox))
-			net_config_mac(cfg.bridge2.devsandbox, cfg.bridge2.macsandbox);
-		sandbox_if_up(&cfg.bridge2);
-
-		if (mac_not_zero(cfg.bridge3.macsandbox))
-			net_config_mac(cfg.bridge3.devsandbox, cfg.bridge3.macsandbox);
-		sandbox_if_up(&cfg.bridge3);
-
-
-		// moving an interface in a namespace using --interface will reset the interface configuration;
-		// we need to put the configuration back
-		if (cfg.interface0.configured && cfg.interface0.ip) {
-			if (arg_debug)
-				printf("Configuring %d.%d.%d.%d address on interface %s\n", PRINT_IP(cfg.interface0.ip), cfg.interface0.dev);
-			net_config_interface(cfg.interface0.dev, cfg.interface0.ip, cfg.interface0.mask, cfg.interface0.mtu);
-		}
-		if (cfg.interface1.configured && cfg.interface1.ip) {
-			if (arg_debug)
-				printf("Configuring %d.%d.%d.%d address on interface %s\n", PRINT_IP(cfg.interface1.ip), cfg.interface1.dev);
-			net_config_interface(cfg.interface1.dev, cfg.interface1.ip, cfg.interface1.mask, cfg.interface1.mtu);
-		}
-		if (cfg.interface2.configured && cfg.interface2.ip) {
-			if (arg_debug)
-				printf("Configuring %d.%d.%d.%d address on interface %s\n", PRINT_IP(cfg.interface2.ip), cfg.interface2.dev);
-			net_config_interface(cfg.interface2.dev, cfg.interface2.ip, cfg.interface2.mask, cfg.interface2.mtu);
-		}
-		if (cfg.interface3.configured && cfg.interface3.ip) {
-			if (arg_debug)
-				printf("Configuring %d.%d.%d.%d address on interface %s\n", PRINT_IP(cfg.interface3.ip), cfg.interface3.dev);
-			net_config_interface(cfg.interface3.dev, cfg.interface3.ip, cfg.interface3.mask, cfg.interface3.mtu);
-		}
-
-		// add a default route
-		if (cfg.defaultgw) {
-			// set the default route
-			if (net_add_route(0, 0, cfg.defaultgw)) {
-				fwarning("cannot configure default route\n");
-				gw_cfg_failed = 1;
-			}
-		}
-
-		if (arg_debug)
-			printf("Network namespace enabled\n");
-	}
-
-	// print network configuration
-	if (!arg_quiet) {
-		if (any_bridge_configured() || any_interface_configured() || cfg.defaultgw || cfg.dns1) {
-			fmessage("\n");
-			if (any_bridge_configured() || any_interface_configured()) {
-				if (arg_scan)
-					sbox_run(SBOX_ROOT | SBOX_CAPS_NETWORK | SBOX_SECCOMP, 3, PATH_FNET, "printif", "scan");
-				else
-					sbox_run(SBOX_ROOT | SBOX_CAPS_NETWORK | SBOX_SECCOMP, 2, PATH_FNET, "printif");
-
-			}
-			if (cfg.defaultgw != 0) {
-				if (gw_cfg_failed)
-					fmessage("Default gateway configuration failed\n");
-				else
-					fmessage("Default gateway %d.%d.%d.%d\n", PRINT_IP(cfg.defaultgw));
-			}
-			if (cfg.dns1 != NULL)
-				fmessage("DNS server %s\n", cfg.dns1);
-			if (cfg.dns2 != NULL)
-				fmessage("DNS server %s\n", cfg.dns2);
-			if (cfg.dns3 != NULL)
-				fmessage("DNS server %s\n", cfg.dns3);
-			if (cfg.dns4 != NULL)
-				fmessage("DNS server %s\n", cfg.dns4);
-			fmessage("\n");
-		}
-	}
+	else if (any_bridge_configured() || any_interface_configured())
+		net_pid = sandbox_network_start();
+	close(parent_to_network_fds[0]);
+	if (!net_pid)
+		print_network_config(0);
 
 	// load IBUS env variables
 	if (arg_nonetwork || any_bridge_configured() || any_interface_configured()) {
@@ -706,13 +873,18 @@ int sandbox(void* sandbox_arg) {
 			printf("Build protocol filter: %s\n", cfg.protocol);
 
 		// build the seccomp filter as a regular user
+		startup_phase_start("seccomp protocol build");
 		int rv = sbox_run(SBOX_USER | SBOX_CAPS_NONE | SBOX_SECCOMP, 5,
 			PATH_FSECCOMP, "protocol", "build", cfg.protocol, RUN_SECCOMP_PROTOCOL);
 		if (rv)
 			exit(rv);
+		startup_phase_end();
 	}
-	if (arg_seccomp && (cfg.seccomp_list || cfg.seccomp_list_drop || cfg.seccomp_list_keep))
+	if (arg_seccomp && (cfg.seccomp_list || cfg.seccomp_list_drop || cfg.seccomp_list_keep)) {
 		arg_seccomp_postexec = 1;
+		// the cache directory might not be visible after the filesystem is built
+		seccomp_cache_open();
+	}
 #endif
 
 	// need ld.so.preload if tracing or seccomp with any non-default lists
@@ -729,12 +901,15 @@ int sandbox(void* sandbox_arg) {
 	//****************************
 	// configure filesystem
 	//****************************
+	startup_phase_start("filesystem");
 	if (arg_appimage)
 		enforce_filters();
 
 #ifdef HAVE_CHROOT
 	if (cfg.chrootdir) {
+		startup_phase_start("fs_chroot");
 		fs_chroot(cfg.chrootdir);
+		startup_phase_end();
 
 		// force caps and seccomp if not started as root
 		if (getuid() != 0)
@@ -752,7 +927,9 @@ int sandbox(void* sandbox_arg) {
 #endif
 #ifdef HAVE_OVERLAYFS
 	if (arg_overlay)	{
+		startup_phase_start("fs_overlayfs");
 		fs_overlayfs();
+		startup_phase_end();
 		// force caps and seccomp if not started as root
 		if (getuid() != 0)
 			enforce_filters();
@@ -761,12 +938,17 @@ int sandbox(void* sandbox_arg) {
 	}
 	else
 #endif
+	{
+		startup_phase_start("fs_basic_fs");
 		fs_basic_fs();
+		startup_phase_end();
+	}
 
 	//****************************
 	// private mode
 	//****************************
 	if (arg_private) {
+		startup_phase_start("private");
 		if (cfg.home_private) {	// --private=
 			if (cfg.chrootdir)
 				fwarning("private=directory feature is disabled in chroot\n");
@@ -785,10 +967,14 @@ int sandbox(void* sandbox_arg) {
 		}
 		else // --private
 			fs_private();
+		startup_phase_end();
 	}
 
-	if (arg_private_dev)
+	if (arg_private_dev) {
+		startup_phase_start("private-dev");
 		fs_private_dev();
+		startup_phase_end();
+	}
 
 	if (arg_private_etc) {
 		if (cfg.chrootdir)
@@ -796,10 +982,12 @@ int sandbox(void* sandbox_arg) {
 		else if (arg_overlay)
 			fwarning("private-etc feature is disabled in overlay\n");
 		else {
+			startup_phase_start("private-etc");
 			fs_private_dir_list("/etc", RUN_ETC_DIR, cfg.etc_private_keep);
 			// create /etc/ld.so.preload file again
 			if (need_preload)
 				fs_trace_preload();
+			startup_phase_end();
 		}
 	}
 
@@ -809,7 +997,9 @@ int sandbox(void* sandbox_arg) {
 		else if (arg_overlay)
 			fwarning("private-opt feature is disabled in overlay\n");
 		else {
+			startup_phase_start("private-opt");
 			fs_private_dir_list("/opt", RUN_OPT_DIR, cfg.opt_private_keep);
+			startup_phase_end();
 		}
 	}
 
@@ -819,7 +1009,9 @@ int sandbox(void* sandbox_arg) {
 		else if (arg_overlay)
 			fwarning("private-srv feature is disabled in overlay\n");
 		else {
+			startup_phase_start("private-srv");
 			fs_private_dir_list("/srv", RUN_SRV_DIR, cfg.srv_private_keep);
+			startup_phase_end();
 		}
 	}
 
@@ -839,7 +1031,9 @@ int sandbox(void* sandbox_arg) {
 				cfg.bin_private_keep = tmp;
 				EUID_ROOT();
 			}
+			startup_phase_start("private-bin");
 			fs_private_bin_list();
+			startup_phase_end();
 		}
 	}
 
@@ -850,7 +1044,9 @@ int sandbox(void* sandbox_arg) {
 		else if (arg_overlay)
 			fwarning("private-lib feature is disabled in overlay\n");
 		else {
+			startup_phase_start("private-lib");
 			fs_private_lib();
+			startup_phase_end();
 		}
 	}
 
@@ -859,15 +1055,20 @@ int sandbox(void* sandbox_arg) {
 			fwarning("private-cache feature is disabled in chroot\n");
 		else if (arg_overlay)
 			fwarning("private-cache feature is disabled in overlay\n");
-		else
+		else {
+			startup_phase_start("private-cache");
 			fs_private_cache();
+			startup_phase_end();
+		}
 	}
 
 	if (arg_private_tmp) {
 		// private-tmp is implemented as a whitelist
+		startup_phase_start("private-tmp");
 		EUID_USER();
 		fs_private_tmp();
 		EUID_ROOT();
+		startup_phase_end();
 	}
 
 	//****************************
@@ -895,7 +1096,9 @@ int sandbox(void* sandbox_arg) {
 	//****************************
 	// update /proc, /sys, /dev, /boot directory
 	//****************************
+	startup_phase_start("fs_proc_sys_dev_boot");
 	fs_proc_sys_dev_boot();
+	startup_phase_end();
 
 	//****************************
 	// handle /mnt and /media
@@ -907,10 +1110,14 @@ int sandbox(void* sandbox_arg) {
 	// apply the profile file
 	//****************************
 	// apply all whitelist commands ...
+	startup_phase_start("whitelist");
 	fs_whitelist();
+	startup_phase_end();
 
 	// ... followed by blacklist commands
+	startup_phase_start("blacklist");
 	fs_blacklist(); // mkdir and mkfile are processed all over again
+	startup_phase_end();
 
 	//****************************
 	// nosound/no3d/notv/novideo and fix for pulseaudio 7.0
@@ -956,6 +1163,7 @@ int sandbox(void* sandbox_arg) {
 	//****************************
 	fs_logger_print();
 	fs_logger_change_owner();
+	startup_phase_end();
 
 	//****************************
 	// set application environment
@@ -1002,9 +1210,11 @@ int sandbox(void* sandbox_arg) {
 	}
 
 	// clean /tmp/.X11-unix sockets
+	startup_phase_start("x11");
 	fs_x11();
 	if (arg_x11_xorg)
 		x11_xorg();
+	startup_phase_end();
 
 	//****************************
 	// set security filters
@@ -1029,6 +1239,7 @@ int sandbox(void* sandbox_arg) {
 
 	// set seccomp
 #ifdef HAVE_SECCOMP
+	startup_phase_start("seccomp");
 	// install protocol filter
 #ifdef SYS_socket
 	if (cfg.protocol) {
@@ -1066,8 +1277,18 @@ int sandbox(void* sandbox_arg) {
 		int rv = unlink(RUN_SECCOMP_MDWX);
 		(void) rv;
 	}
+	startup_phase_end();
 #endif
 
+	//****************************************
+	// the interfaces are needed from now on
+	//****************************************
+	if (net_pid) {
+		startup_phase_start("network wait");
+		sandbox_network_wait(net_pid);
+		startup_phase_end();
+	}
+
 	//****************************************
 	// create a new user namespace
 	//     - too early to drop privileges
@@ -1114,27 +1335,18 @@ int sandbox(void* sandbox_arg) {
 	// drop privileges, fork the application and monitor it
 	//****************************************
 	drop_privs(arg_nogroups);
+	startup_trace_flush();
+
+	// the sandbox is ready, start the applications on request
+	if (arg_fork_server)
+		return fork_server_run();
+
 	pid_t app_pid = fork();
 	if (app_pid == -1)
 		errExit("fork");
 
-	if (app_pid == 0) {
-#ifdef HAVE_APPARMOR
-		if (checkcfg(CFG_APPARMOR) && arg_apparmor) {
-			errno = 0;
-			if (aa_change_onexec("firejail-default")) {
-				fwarning("Cannot confine the application using AppArmor.\n"
-					"Maybe firejail-default AppArmor profile is not loaded into the kernel.\n"
-					"As root, run \"aa-enforce firejail-default\" to load it.\n");
-			}
-			else if (arg_debug)
-				printf("AppArmor enabled\n");
-		}
-#endif
-
-		prctl(PR_SET_PDEATHSIG, SIGKILL, 0, 0, 0); // kill the child in case the parent died
-		start_application(0);	// start app
-	}
+	if (app_pid == 0)
+		sandbox_start_application();
 
 	int status = monitor_application(app_pid);	// monitor application
 	flush_stdin();
@@ -23,7 +23,11 @@
 #include <unistd.h>
 #include <net/if.h>
 #include <stdarg.h>
- #include <sys/wait.h>
+#include <sched.h>
+#include <signal.h>
+#include <grp.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
 #include "../include/seccomp.h"
 
 static struct sock_filter filter[] = {
@@ -104,117 +108,363 @@ static struct sock_fprog prog = {
 	.filter = filter,
 };
 
-int sbox_run(unsigned filter, int num, ...) {
-	EUID_ROOT();
+//***************************************************************
+// helper launcher
+//***************************************************************
+// The helper is started with clone(CLONE_VM | CLONE_VFORK): the child runs on a
+// small stack in the memory of the parent until execve(), the page tables of
+// the firejail process are not copied. The parent is suspended until the child
+// calls execve() or exits, so everything the child needs is prepared in advance,
+// and the child uses only system calls. Firejail is single-threaded.
+#define SBOX_STACK_SIZE (64 * 1024)
+static char sbox_stack[SBOX_STACK_SIZE] __attribute__((aligned(16)));
 
-	int i;
-	va_list valist;
-	va_start(valist, num);
+typedef struct sbox_spawn_t {
+	unsigned filter;
+	char **arg;
+	char **env;
+	int stdin_fd;		// -1 to close stdin, STDIN_FILENO to leave it untouched
+	int caps_apply;
+	uint64_t caps;		// capability bounding set
+	uid_t uid;
+	gid_t gid;
+	sigset_t mask;		// signal mask to restore before exec
+} SboxSpawn;
 
-	// build argument list
-	char *arg[num + 1];
-	for (i = 0; i < num; i++)
-		arg[i] = va_arg(valist, char*);
-	arg[i] = NULL;
-	va_end(valist);
+static void sbox_child_error(const char *msg) {
+	size_t len = strlen(msg);
+	if (write(STDERR_FILENO, msg, len) != (ssize_t) len)
+		;	// nothing we can do about it
+	_exit(1);
+}
 
-	if (arg_debug) {
-		printf("sbox run: ");
-		for (i = 0; i <= num; i++)
-			printf("%s ", arg[i]);
-		printf("\n");
-	}
+static int sbox_child(void *arg) {
+	SboxSpawn *sp = arg;
 
-	pid_t child = fork();
-	if (child < 0)
-		errExit("fork");
-	if (child == 0) {
-		// clean the new process
-		clearenv();
-
-		if (filter & SBOX_STDIN_FROM_FILE) {
-			int fd;
-			if((fd = open(SBOX_STDIN_FILE, O_RDONLY)) == -1) {
-				fprintf(stderr,"Error: cannot open %s\n", SBOX_STDIN_FILE);
-				exit(1);
-			}
-			dup2(fd,STDIN_FILENO);
-		}
-		else if ((filter & SBOX_ALLOW_STDIN) == 0) {
-			int fd = open("/dev/null",O_RDWR, 0);
-			if (fd != -1)
-				dup2(fd, STDIN_FILENO);
-			else // the user could run the sandbox without /dev/null
-				close(STDIN_FILENO);
+	// signal handlers installed by firejail would run in the memory of the parent
+	int sig;
+	for (sig = 1; sig < _NSIG; sig++) {
+		struct sigaction sa;
+		if (sigaction(sig, NULL, &sa) == 0 &&
+		    sa.sa_handler != SIG_IGN && sa.sa_handler != SIG_DFL) {
+			sa.sa_handler = SIG_DFL;
+			sa.sa_flags = 0;
+			sigaction(sig, &sa, NULL);
 		}
+	}
+	sigprocmask(SIG_SETMASK, &sp->mask, NULL);
+
+	// stdin
+	if (sp->stdin_fd == -1)	// the user could run the sandbox without /dev/null
+		close(STDIN_FILENO);
+	else if (sp->stdin_fd != STDIN_FILENO && dup2(sp->stdin_fd, STDIN_FILENO) == -1)
+		sbox_child_error("Error: cannot redirect stdin\n");
 
-		// close all other file descriptors
+	// close all other file descriptors
+#ifdef SYS_close_range
+	if (syscall(SYS_close_range, 3, ~0U, 0) == -1)
+#endif
+	{
+		int i;
 		int max = 20; // getdtablesize() is overkill for a firejail process
 		for (i = 3; i < max; i++)
 			close(i); // close open files
+	}
+
+	umask(027);
+
+	// apply filters
+	if (sp->caps_apply) {
+		unsigned long i;
+		for (i = 0; i < 64; i++) {
+			if ((sp->caps & (1LLU << i)) == 0 &&
+			    prctl(PR_CAPBSET_DROP, i, 0, 0, 0) == -1 && errno != EINVAL)
+				sbox_child_error("Error: PR_CAPBSET_DROP failed\n");
+		}
+	}
 
-		umask(027);
+	if (sp->filter & SBOX_SECCOMP) {
+		if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0))
+			sbox_child_error("Error: prctl(NO_NEW_PRIVS) failed\n");
+		if (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog))
+			sbox_child_error("Error: prctl(PR_SET_SECCOMP) failed\n");
+	}
+
+	if (sp->filter & SBOX_ROOT) {
+		// elevate privileges in order to get grsecurity working
+		if (setreuid(0, 0))
+			sbox_child_error("Error: setreuid failed\n");
+		if (setregid(0, 0))
+			sbox_child_error("Error: setregid failed\n");
+	}
+	else if (sp->filter & SBOX_USER) {
+		// drop privileges, no supplementary groups
+		if (setgroups(0, NULL) < 0)
+			sbox_child_error("Error: setgroups failed\n");
+		if (setgid(sp->gid) < 0)
+			sbox_child_error("Error: setgid failed\n");
+		if (setuid(sp->uid) < 0)
+			sbox_child_error("Error: setuid failed\n");
+	}
+
+	// helpers are always started using the full path
+	execve(sp->arg[0], sp->arg, sp->env);
+	sbox_child_error("Error: execve failed\n");
+	return 1;
+}
+
+static pid_t sbox_spawn(unsigned filter, char **arg) {
+	EUID_ROOT();
+	assert(arg[0] && *arg[0] == '/');
+
+	if (arg_debug) {
+		int i;
+		printf("sbox run: ");
+		for (i = 0; arg[i]; i++)
+			printf("%s ", arg[i]);
+		printf("\n");
+	}
+
+	SboxSpawn sp;
+	memset(&sp, 0, sizeof(sp));
+	sp.filter = filter;
+	sp.arg = arg;
 
-		// apply filters
-		if (filter & SBOX_CAPS_NONE) {
-			caps_drop_all();
+	// clean environment; --quiet and --debug are passed as environment variables
+	char *env[3];
+	int n = 0;
+	if (arg_quiet)
+		env[n++] = "FIREJAIL_QUIET=yes";
+	if (arg_debug)
+		env[n++] = "FIREJAIL_DEBUG=yes";
+	env[n] = NULL;
+	sp.env = env;
+
+	if (filter & SBOX_STDIN_FROM_FILE) {
+		if ((sp.stdin_fd = open(SBOX_STDIN_FILE, O_RDONLY | O_CLOEXEC)) == -1) {
+			fprintf(stderr,"Error: cannot open %s\n", SBOX_STDIN_FILE);
+			exit(1);
 		}
-		else if (filter & SBOX_CAPS_NETWORK) {
+	}
+	else if ((filter & SBOX_ALLOW_STDIN) == 0)
+		sp.stdin_fd = open("/dev/null", O_RDWR | O_CLOEXEC, 0);
+	else
+		sp.stdin_fd = STDIN_FILENO;
+
+	if (filter & SBOX_CAPS_NONE) {
+		if (arg_debug)
+			printf("Dropping all capabilities\n");
+		sp.caps_apply = 1;
+		sp.caps = 0;
+	}
+	else if (filter & SBOX_CAPS_NETWORK) {
 #ifndef HAVE_GCOV // the following filter will prevent GCOV from saving info in .gcda files
-			uint64_t set = ((uint64_t) 1) << CAP_NET_ADMIN;
-			set |=  ((uint64_t) 1) << CAP_NET_RAW;
-			caps_set(set);
+		sp.caps_apply = 1;
+		sp.caps = ((uint64_t) 1) << CAP_NET_ADMIN;
+		sp.caps |=  ((uint64_t) 1) << CAP_NET_RAW;
 #endif
-		}
-		else if (filter & SBOX_CAPS_HIDEPID) {
+	}
+	else if (filter & SBOX_CAPS_HIDEPID) {
 #ifndef HAVE_GCOV // the following filter will prevent GCOV from saving info in .gcda files
-			uint64_t set = ((uint64_t) 1) << CAP_SYS_PTRACE;
-			set |=  ((uint64_t) 1) << CAP_SYS_PACCT;
-			caps_set(set);
+		sp.caps_apply = 1;
+		sp.caps = ((uint64_t) 1) << CAP_SYS_PTRACE;
+		sp.caps |=  ((uint64_t) 1) << CAP_SYS_PACCT;
 #endif
-		}
-
-		if (filter & SBOX_SECCOMP) {
-			if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0)) {
-				perror("prctl(NO_NEW_PRIVS)");
-			}
-			if (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog)) {
-				perror("prctl(PR_SET_SECCOMP)");
-			}
-		}
+	}
+	if (arg_debug && sp.caps_apply && sp.caps)
+		printf("Set caps filter %llx\n", (unsigned long long) sp.caps);
 
-		if (filter & SBOX_ROOT) {
-			// elevate privileges in order to get grsecurity working
-			if (setreuid(0, 0))
-				errExit("setreuid");
-			if (setregid(0, 0))
-				errExit("setregid");
+	if (filter & SBOX_USER) {
+		sp.uid = getuid();
+		sp.gid = getgid();
+		if (arg_debug) {
+			printf("Drop privileges: pid %d, uid %d, gid %d, nogroups 1\n", getpid(), sp.uid, sp.gid);
+			printf("No supplementary groups\n");
 		}
-		else if (filter & SBOX_USER)
-			drop_privs(1);
-
-		clearenv();
-
-		// --quiet is passed as an environment variable
-		if (arg_quiet)
-			setenv("FIREJAIL_QUIET", "yes", 1);
+	}
+	fflush(0);
 
-		if (arg[0])	// get rid of scan-build warning
-			execvp(arg[0], arg);
-		else
-			assert(0);
-		perror("execvp");
-		_exit(1);
+	// block all signals until the child resets the signal handlers
+	sigset_t all;
+	sigfillset(&all);
+	sigprocmask(SIG_BLOCK, &all, &sp.mask);
+	pid_t child = clone(sbox_child, sbox_stack + SBOX_STACK_SIZE, CLONE_VM | CLONE_VFORK | SIGCHLD, &sp);
+	int err = errno;
+	sigprocmask(SIG_SETMASK, &sp.mask, NULL);
+	if (sp.stdin_fd > STDIN_FILENO)
+		close(sp.stdin_fd);
+	if (child == -1) {
+		errno = err;
+		errExit("clone");
 	}
+	return child;
+}
 
+// wait for a helper; exit if the helper failed, otherwise return the wait status
+static int sbox_wait(pid_t child, const char *name) {
 	int status;
 	if (waitpid(child, &status, 0) == -1 ) {
 		errExit("waitpid");
 	}
 	if (WIFEXITED(status) && status != 0) {
-		fprintf(stderr, "Error: failed to run %s\n", arg[0]);
+		fprintf(stderr, "Error: failed to run %s\n", name);
 		exit(1);
 	}
 
 	return status;
 }
+
+int sbox_run(unsigned filter, int num, ...) {
+	int i;
+	va_list valist;
+	va_start(valist, num);
+
+	// build argument list
+	char *arg[num + 1];
+	for (i = 0; i < num; i++)
+		arg[i] = va_arg(valist, char*);
+	arg[i] = NULL;
+	va_end(valist);
+
+	pid_t child = sbox_spawn(filter, arg);
+	return sbox_wait(child, arg[0]);
+}
+
+// helpers started without waiting for them to finish
+typedef struct sbox_job_t {
+	struct sbox_job_t *next;
+	pid_t pid;
+	char *name;
+} SboxJob;
+static SboxJob *sbox_jobs = NULL;
+
+// start a helper and return without waiting; use it only for helpers
+// that can run in parallel, and collect them using sbox_wait_all()
+void sbox_start(unsigned filter, int num, ...) {
+	int i;
+	va_list valist;
+	va_start(valist, num);
+
+	// build argument list
+	char *arg[num + 1];
+	for (i = 0; i < num; i++)
+		arg[i] = va_arg(valist, char*);
+	arg[i] = NULL;
+	va_end(valist);
+
+	SboxJob *job = malloc(sizeof(SboxJob));
+	if (!job)
+		errExit("malloc");
+	job->name = strdup(arg[0]);
+	if (!job->name)
+		errExit("strdup");
+	job->pid = sbox_spawn(filter, arg);
+	job->next = sbox_jobs;
+	sbox_jobs = job;
+}
+
+// wait for all the helpers started with sbox_start(); exit if any of them failed
+void sbox_wait_all(void) {
+	while (sbox_jobs) {
+		SboxJob *job = sbox_jobs;
+		sbox_jobs = job->next;
+		sbox_wait(job->pid, job->name);
+		free(job->name);
+		free(job);
+	}
+}
+
+//***************************************************************
+// fcopy batch mode
+//***************************************************************
+// copy requests are queued and executed later by a single fcopy process
+#define FCOPY_HASH_SIZE 1024	// power of 2
+
+typedef struct fcopy_entry_t {
+	struct fcopy_entry_t *next;
+	struct fcopy_entry_t *hnext;	// hash chain, indexed by target
+	char *src;
+	char *dest;
+	char *target;	// dest/file name, as built by fcopy
+	int follow_link;
+} FcopyEntry;
+
+static FcopyEntry *fcopy_first = NULL;
+static FcopyEntry *fcopy_last = NULL;
+static FcopyEntry *fcopy_hash[FCOPY_HASH_SIZE];
+
+void sbox_fcopy_add(const char *src, const char *dest, int follow_link) {
+	assert(src);
+	assert(dest);
+
+	FcopyEntry *entry = malloc(sizeof(FcopyEntry));
+	if (!entry)
+		errExit("malloc");
+	memset(entry, 0, sizeof(FcopyEntry));
+	entry->src = strdup(src);
+	entry->dest = strdup(dest);
+	if (!entry->src || !entry->dest)
+		errExit("strdup");
+	const char *ptr = strrchr(src, '/');
+	ptr = (ptr)? ptr + 1: src;
+	if (asprintf(&entry->target, "%s/%s", dest, ptr) == -1)
+		errExit("asprintf");
+	entry->follow_link = follow_link;
+
+	unsigned h = str_hash64(entry->target) & (FCOPY_HASH_SIZE - 1);
+	entry->hnext = fcopy_hash[h];
+	fcopy_hash[h] = entry;
+
+	if (fcopy_last)
+		fcopy_last->next = entry;
+	else
+		fcopy_first = entry;
+	fcopy_last = entry;
+}
+
+// return 1 if a request for building this destination file is already queued
+int sbox_fcopy_queued(const char *target) {
+	assert(target);
+	FcopyEntry *ptr = fcopy_hash[str_hash64(target) & (FCOPY_HASH_SIZE - 1)];
+	while (ptr) {
+		if (strcmp(ptr->target, target) == 0)
+			return 1;
+		ptr = ptr->hnext;
+	}
+	return 0;
+}
+
+// run all queued requests in a single fcopy process; the manifest is passed on stdin
+void sbox_fcopy_run(unsigned filter) {
+	if (!fcopy_first)
+		return;
+
+	unlink(SBOX_STDIN_FILE);
+	FILE *fp = fopen(SBOX_STDIN_FILE, "w");
+	if (!fp)
+		errExit("fopen");
+	SET_PERMS_STREAM(fp, 0, 0, 0600);
+
+	int cnt = 0;
+	FcopyEntry *ptr = fcopy_first;
+	while (ptr) {
+		fprintf(fp, "%c,%s,%s\n", (ptr->follow_link)? 'f': 'c', ptr->src, ptr->dest);
+		cnt++;
+
+		FcopyEntry *next = ptr->next;
+		free(ptr->src);
+		free(ptr->dest);
+		free(ptr->target);
+		free(ptr);
+		ptr = next;
+	}
+	fcopy_first = NULL;
+	fcopy_last = NULL;
+	memset(fcopy_hash, 0, sizeof(fcopy_hash));
+	fclose(fp);
+
+	if (arg_debug)
+		printf("Running fcopy batch, %d %s\n", cnt, (cnt == 1)? "request": "requests");
+	sbox_run(filter | SBOX_STDIN_FROM_FILE, 2, PATH_FCOPY, "--batch");
+	unlink(SBOX_STDIN_FILE);
+}
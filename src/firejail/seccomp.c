@@ -22,6 +22,8 @@
 #include "firejail.h"
 #include "../include/seccomp.h"
 #include <sys/mman.h>
+#include <sys/utsname.h>
+#include <stdint.h>
 
 typedef struct filter_list {
 	struct filter_list *next;
@@ -60,6 +62,195 @@ char *seccomp_check_list(const char *str) {
 	return rv;
 }
 
+//***************************************************
+// compiled filter cache
+//***************************************************
+// The filters built by fseccomp and fsec-optimize for custom syscall lists are stored
+// in RUN_FIREJAIL_SECCOMP_CACHE_DIR, one file for each user and filter configuration:
+//	header | key | filter | postexec filter
+// The key contains the filter type, the syscall list, the architecture and the stat
+// information of fseccomp and fsec-optimize binaries. The default syscall lists are
+// compiled into fseccomp, a new fseccomp binary invalidates the cache.
+#define SECCOMP_CACHE_MAGIC 0x46534331	// "FSC1"
+#define SECCOMP_CACHE_MAX_SIZE (1024 * 1024)
+
+typedef struct seccomp_cache_header_t {
+	uint32_t magic;
+	uint32_t keylen;	// including the '\0' terminator
+	uint32_t filter;	// filter size in bytes
+	uint32_t postexec;	// postexec filter size in bytes
+} SeccompCacheHeader;
+
+static int cache_dirfd = -1;
+
+// open the cache directory before the sandbox filesystem is built
+void seccomp_cache_open(void) {
+	if (!checkcfg(CFG_SECCOMP_CACHE) || cache_dirfd != -1)
+		return;
+	cache_dirfd = open(RUN_FIREJAIL_SECCOMP_CACHE_DIR, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if (cache_dirfd == -1 && arg_debug)
+		printf("Warning: cannot open %s\n", RUN_FIREJAIL_SECCOMP_CACHE_DIR);
+}
+
+static void cache_add_binary(char **key, const char *fname) {
+	struct stat s;
+	if (stat(fname, &s) == -1)
+		memset(&s, 0, sizeof(s));
+	char *tmp;
+	if (asprintf(&tmp, "%s\n%s %lu %lu %ld %ld.%09ld %ld.%09ld", *key, fname,
+	    (unsigned long) s.st_dev, (unsigned long) s.st_ino, (long) s.st_size,
+	    (long) s.st_mtim.tv_sec, s.st_mtim.tv_nsec,
+	    (long) s.st_ctim.tv_sec, s.st_ctim.tv_nsec) == -1)
+		errExit("asprintf");
+	free(*key);
+	*key = tmp;
+}
+
+static char *cache_key(const char *type, const char *list) {
+	struct utsname u;
+	if (uname(&u) == -1)
+		errExit("uname");
+
+	char *key;
+	if (asprintf(&key, "%s\n%s\n%d\n%s %d", type, list, arg_allow_debuggers, u.machine, (int) sizeof(long)) == -1)
+		errExit("asprintf");
+	cache_add_binary(&key, PATH_FSECCOMP);
+	cache_add_binary(&key, PATH_FSEC_OPTIMIZE);
+	return key;
+}
+
+static char *cache_fname(const char *key) {
+	char *fname;
+	if (asprintf(&fname, "%u-%016llx", getuid(), str_hash64(key)) == -1)
+		errExit("asprintf");
+	return fname;
+}
+
+// write size bytes in an existing file under /run/firejail/mnt
+static int cache_write_file(const char *fname, const void *data, size_t size) {
+	int fd = open(fname, O_WRONLY | O_TRUNC | O_NOFOLLOW | O_CLOEXEC);
+	if (fd == -1)
+		return -1;
+	ssize_t len = (size)? write(fd, data, size): 0;
+	close(fd);
+	return (len == (ssize_t) size)? 0: -1;
+}
+
+// read a filter file in allocated memory; return NULL if error
+static void *cache_read_file(const char *fname, uint32_t *size) {
+	int fd = open(fname, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd == -1)
+		return NULL;
+	struct stat s;
+	void *data = NULL;
+	if (fstat(fd, &s) == 0 && s.st_size < SECCOMP_CACHE_MAX_SIZE) {
+		data = malloc(s.st_size + 1);
+		if (!data)
+			errExit("malloc");
+		if (read(fd, data, s.st_size) != s.st_size) {
+			free(data);
+			data = NULL;
+		}
+		else
+			*size = s.st_size;
+	}
+	close(fd);
+	return data;
+}
+
+// extract a cached filter in RUN_SECCOMP_CFG and RUN_SECCOMP_POSTEXEC; return 1 if found
+static int seccomp_cache_load(const char *type, const char *list) {
+	if (cache_dirfd == -1)
+		return 0;
+
+	char *key = cache_key(type, list);
+	char *fname = cache_fname(key);
+	int rv = 0;
+	int fd = openat(cache_dirfd, fname, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd == -1)
+		goto out;
+
+	struct stat s;
+	char *base = MAP_FAILED;
+	if (fstat(fd, &s) == 0 && s.st_uid == 0 &&
+	    s.st_size >= (off_t) sizeof(SeccompCacheHeader) && s.st_size <= SECCOMP_CACHE_MAX_SIZE)
+		base = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		goto out;
+
+	// check the header and the key
+	SeccompCacheHeader *hdr = (SeccompCacheHeader *) base;
+	uint64_t size = sizeof(SeccompCacheHeader) + (uint64_t) hdr->keylen + hdr->filter + hdr->postexec;
+	const char *ckey = base + sizeof(SeccompCacheHeader);
+	const char *filter = ckey + hdr->keylen;
+	if (hdr->magic != SECCOMP_CACHE_MAGIC || size != (uint64_t) s.st_size ||
+	    hdr->keylen != strlen(key) + 1 || memcmp(ckey, key, hdr->keylen) ||
+	    hdr->filter == 0 || hdr->filter % sizeof(struct sock_filter) ||
+	    hdr->postexec % sizeof(struct sock_filter))
+		goto errout;
+
+	if (cache_write_file(RUN_SECCOMP_CFG, filter, hdr->filter) ||
+	    cache_write_file(RUN_SECCOMP_POSTEXEC, filter + hdr->filter, hdr->postexec))
+		goto errout;
+	if (arg_debug)
+		printf("Using seccomp filter %s/%s\n", RUN_FIREJAIL_SECCOMP_CACHE_DIR, fname);
+	rv = 1;
+
+errout:
+	munmap(base, s.st_size);
+out:
+	free(fname);
+	free(key);
+	return rv;
+}
+
+// store the filters in RUN_SECCOMP_CFG and RUN_SECCOMP_POSTEXEC in the cache
+static void seccomp_cache_save(const char *type, const char *list) {
+	if (cache_dirfd == -1)
+		return;
+
+	SeccompCacheHeader hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	void *filter = cache_read_file(RUN_SECCOMP_CFG, &hdr.filter);
+	void *postexec = cache_read_file(RUN_SECCOMP_POSTEXEC, &hdr.postexec);
+	if (!filter || !postexec || hdr.filter == 0) {
+		free(filter);
+		free(postexec);
+		return;
+	}
+
+	char *key = cache_key(type, list);
+	char *fname = cache_fname(key);
+	char *tmpname;
+	if (asprintf(&tmpname, "%s.%d", fname, getpid()) == -1)
+		errExit("asprintf");
+	hdr.magic = SECCOMP_CACHE_MAGIC;
+	hdr.keylen = strlen(key) + 1;
+
+	int fd = openat(cache_dirfd, tmpname, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+	if (fd != -1) {
+		FILE *fp = fdopen(fd, "w");
+		if (!fp)
+			errExit("fdopen");
+		fwrite(&hdr, sizeof(hdr), 1, fp);
+		fwrite(key, hdr.keylen, 1, fp);
+		fwrite(filter, hdr.filter, 1, fp);
+		if (hdr.postexec)
+			fwrite(postexec, hdr.postexec, 1, fp);
+		if (ferror(fp) | fclose(fp) || renameat(cache_dirfd, tmpname, cache_dirfd, fname))
+			unlinkat(cache_dirfd, tmpname, 0);
+		else if (arg_debug)
+			printf("Seccomp filter saved in %s/%s\n", RUN_FIREJAIL_SECCOMP_CACHE_DIR, fname);
+	}
+
+	free(tmpname);
+	free(fname);
+	free(key);
+	free(filter);
+	free(postexec);
+}
+
 // install seccomp filters
 int seccomp_install_filters(void) {
 	int r = 0;
@@ -190,21 +381,24 @@ int seccomp_filter_drop(void) {
 			if (arg_debug)
 				printf("Build default+drop seccomp filter\n");
 
-			// build the seccomp filter as a regular user
-			int rv;
-			if (arg_allow_debuggers)
-				rv = sbox_run(SBOX_USER | SBOX_CAPS_NONE | SBOX_SECCOMP, 7,
-					      PATH_FSECCOMP, "default", "drop", RUN_SECCOMP_CFG, RUN_SECCOMP_POSTEXEC, cfg.seccomp_list, "allow-debuggers");
-			else
-				rv = sbox_run(SBOX_USER | SBOX_CAPS_NONE | SBOX_SECCOMP, 6,
-					      PATH_FSECCOMP, "default", "drop", RUN_SECCOMP_CFG, RUN_SECCOMP_POSTEXEC, cfg.seccomp_list);
-			if (rv)
-				exit(rv);
-
-			// optimize the new filter
-			rv = sbox_run(SBOX_USER | SBOX_CAPS_NONE | SBOX_SECCOMP, 2, PATH_FSEC_OPTIMIZE, RUN_SECCOMP_CFG);
-			if (rv)
-				exit(rv);
+			if (!seccomp_cache_load("default drop", cfg.seccomp_list)) {
+				// build the seccomp filter as a regular user
+				int rv;
+				if (arg_allow_debuggers)
+					rv = sbox_run(SBOX_USER | SBOX_CAPS_NONE | SBOX_SECCOMP, 7,
+						      PATH_FSECCOMP, "default", "drop", RUN_SECCOMP_CFG, RUN_SECCOMP_POSTEXEC, cfg.seccomp_list, "allow-debuggers");
+				else
+					rv = sbox_run(SBOX_USER | SBOX_CAPS_NONE | SBOX_SECCOMP, 6,
+						      PATH_FSECCOMP, "default", "drop", RUN_SECCOMP_CFG, RUN_SECCOMP_POSTEXEC, cfg.seccomp_list);
+				if (rv)
+					exit(rv);
+
+				// optimize the new filter
+				rv = sbox_run(SBOX_USER | SBOX_CAPS_NONE | SBOX_SECCOMP, 2, PATH_FSEC_OPTIMIZE, RUN_SECCOMP_CFG);
+				if (rv)
+					exit(rv);
+				seccomp_cache_save("default drop", cfg.seccomp_list);
+			}
 		}
 	}
 
@@ -216,22 +410,25 @@ int seccomp_filter_drop(void) {
 		if (arg_debug)
 			printf("Build drop seccomp filter\n");
 
-		// build the seccomp filter as a regular user
-		int rv;
-		if (arg_allow_debuggers)
-			rv = sbox_run(SBOX_USER | SBOX_CAPS_NONE | SBOX_SECCOMP, 6,
-				      PATH_FSECCOMP, "drop", RUN_SECCOMP_CFG, RUN_SECCOMP_POSTEXEC, cfg.seccomp_list_drop,  "allow-debuggers");
-		else
-			rv = sbox_run(SBOX_USER | SBOX_CAPS_NONE | SBOX_SECCOMP, 5,
-				PATH_FSECCOMP, "drop", RUN_SECCOMP_CFG, RUN_SECCOMP_POSTEXEC, cfg.seccomp_list_drop);
+		if (!seccomp_cache_load("drop", cfg.seccomp_list_drop)) {
+			// build the seccomp filter as a regular user
+			int rv;
+			if (arg_allow_debuggers)
+				rv = sbox_run(SBOX_USER | SBOX_CAPS_NONE | SBOX_SECCOMP, 6,
+					      PATH_FSECCOMP, "drop", RUN_SECCOMP_CFG, RUN_SECCOMP_POSTEXEC, cfg.seccomp_list_drop,  "allow-debuggers");
+			else
+				rv = sbox_run(SBOX_USER | SBOX_CAPS_NONE | SBOX_SECCOMP, 5,
+					PATH_FSECCOMP, "drop", RUN_SECCOMP_CFG, RUN_SECCOMP_POSTEXEC, cfg.seccomp_list_drop);
 
-		if (rv)
-			exit(rv);
+			if (rv)
+				exit(rv);
 
-		// optimize the drop filter
-		rv = sbox_run(SBOX_USER | SBOX_CAPS_NONE | SBOX_SECCOMP, 2, PATH_FSEC_OPTIMIZE, RUN_SECCOMP_CFG);
-		if (rv)
-			exit(rv);
+			// optimize the drop filter
+			rv = sbox_run(SBOX_USER | SBOX_CAPS_NONE | SBOX_SECCOMP, 2, PATH_FSEC_OPTIMIZE, RUN_SECCOMP_CFG);
+			if (rv)
+				exit(rv);
+			seccomp_cache_save("drop", cfg.seccomp_list_drop);
+		}
 	}
 
 	// load the filter
@@ -262,13 +459,16 @@ int seccomp_filter_keep(void) {
 	if (arg_debug)
 		printf("Build keep seccomp filter\n");
 
-	// build the seccomp filter as a regular user
-	int rv = sbox_run(SBOX_USER | SBOX_CAPS_NONE | SBOX_SECCOMP, 5,
-		 PATH_FSECCOMP, "keep", RUN_SECCOMP_CFG, RUN_SECCOMP_POSTEXEC, cfg.seccomp_list_keep);
+	if (!seccomp_cache_load("keep", cfg.seccomp_list_keep)) {
+		// build the seccomp filter as a regular user
+		int rv = sbox_run(SBOX_USER | SBOX_CAPS_NONE | SBOX_SECCOMP, 5,
+			 PATH_FSECCOMP, "keep", RUN_SECCOMP_CFG, RUN_SECCOMP_POSTEXEC, cfg.seccomp_list_keep);
 
-	if (rv) {
-		fprintf(stderr, "Error: cannot configure seccomp filter\n");
-		exit(rv);
+		if (rv) {
+			fprintf(stderr, "Error: cannot configure seccomp filter\n");
+			exit(rv);
+		}
+		seccomp_cache_save("keep", cfg.seccomp_list_keep);
 	}
 
 	if (arg_debug)
@@ -20,14 +20,27 @@
 #include "firejail.h"
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/syscall.h>
 #include <fcntl.h>
-#include <sys/prctl.h>
+#include <poll.h>
+#include <time.h>
+#include <errno.h>
 
-void shut(pid_t pid) {
+typedef struct shut_t {
+	pid_t parent;	// firejail process
+	pid_t pid;	// first child process inside the sandbox
+	int pidfd;	// -1 if pidfds are not supported
+	int done;
+} Shut;
+
+// if the pid is that of a firejail process, use the pid of a child process inside the sandbox
+static void shut_check(Shut *s, pid_t pid) {
 	EUID_ASSERT();
+	s->parent = pid;
+	s->pid = pid;
+	s->pidfd = -1;
+	s->done = 0;
 
-	pid_t parent = pid;
-	// if the pid is that of a firejail  process, use the pid of a child process inside the sandbox
 	EUID_ROOT();
 	char *comm = pid_proc_comm(pid);
 	EUID_USER();
@@ -35,12 +48,12 @@ void shut(pid_t pid) {
 		if (strcmp(comm, "firejail") == 0) {
 			pid_t child;
 			if (find_child(pid, &child) == 0) {
-				pid = child;
-				printf("Switching to pid %u, the first child process inside the sandbox\n", (unsigned) pid);
+				s->pid = child;
+				printf("Switching to pid %u, the first child process inside the sandbox\n", (unsigned) child);
 			}
 		}
 		else {
-			fprintf(stderr, "Error: this is not a firejail sandbox\n");
+			fprintf(stderr, "Error: %u is not a firejail sandbox\n", (unsigned) pid);
 			exit(1);
 		}
 		free(comm);
@@ -51,57 +64,133 @@ void shut(pid_t pid) {
 	// check privileges for non-root users
 	uid_t uid = getuid();
 	if (uid != 0) {
-		uid_t sandbox_uid = pid_get_uid(pid);
+		uid_t sandbox_uid = pid_get_uid(s->pid);
 		if (uid != sandbox_uid) {
 			fprintf(stderr, "Error: permission is denied to shutdown a sandbox created by a different user.\n");
 			exit(1);
 		}
 	}
+}
 
-	EUID_ROOT();
-	printf("Sending SIGTERM to %u\n", pid);
-	kill(pid, SIGTERM);
+static void shut_signal(Shut *s, int sig) {
+#ifdef SYS_pidfd_send_signal
+	if (s->pidfd != -1 && syscall(SYS_pidfd_send_signal, s->pidfd, sig, NULL, 0) == 0)
+		return;
+#endif
+	kill(s->pid, sig);
+}
 
-	// wait for not more than 10 seconds
-	sleep(2);
-	int monsec = 8;
+// without pidfd support, the process is done when /proc/PID/cmdline is gone or empty
+static int shut_proc_done(pid_t pid) {
 	char *monfile;
 	if (asprintf(&monfile, "/proc/%d/cmdline", pid) == -1)
 		errExit("asprintf");
-	int killdone = 0;
+	FILE *fp = fopen(monfile, "r");
+	free(monfile);
+	if (!fp)
+		return 1;
 
-	while (monsec) {
-		FILE *fp = fopen(monfile, "r");
-		if (!fp) {
-			killdone = 1;
-			break;
+	char c;
+	size_t count = fread(&c, 1, 1, fp);
+	fclose(fp);
+	return count == 0;
+}
+
+static unsigned long long now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// send SIGTERM to all the sandboxes and wait for them to terminate; the sandboxes
+// still running when the timeout (in seconds) expires are killed
+void shut(pid_t *pids, int cnt, unsigned timeout) {
+	EUID_ASSERT();
+	assert(pids);
+	assert(cnt > 0);
+
+	Shut *sbox = malloc(cnt * sizeof(Shut));
+	struct pollfd *fds = malloc(cnt * sizeof(struct pollfd));
+	if (!sbox || !fds)
+		errExit("malloc");
+
+	// all the sandboxes are checked before sending any signal
+	int i;
+	for (i = 0; i < cnt; i++)
+		shut_check(&sbox[i], pids[i]);
+
+	EUID_ROOT();
+	for (i = 0; i < cnt; i++) {
+		// the process terminated is reported immediately on the pidfd
+		sbox[i].pidfd = pid_fd_open(sbox[i].pid);
+		if (sbox[i].pidfd == -1 && errno == ESRCH) {
+			sbox[i].done = 1;
+			continue;
 		}
+		printf("Sending SIGTERM to %u\n", sbox[i].pid);
+		shut_signal(&sbox[i], SIGTERM);
+	}
 
-		char c;
-		size_t count = fread(&c, 1, 1, fp);
-		fclose(fp);
-		if (count == 0) {
-			// all done
-			killdone = 1;
-			break;
+	// wait for not more than timeout seconds
+	unsigned long long deadline = now_ms() + timeout * 1000ULL;
+	while (1) {
+		int nfds = 0;
+		int polling = 0;	// processes without a pidfd
+		for (i = 0; i < cnt; i++) {
+			if (sbox[i].done)
+				continue;
+			if (sbox[i].pidfd == -1) {
+				if (shut_proc_done(sbox[i].pid))
+					sbox[i].done = 1;
+				else
+					polling = 1;
+				continue;
+			}
+			fds[nfds].fd = sbox[i].pidfd;
+			fds[nfds].events = POLLIN;
+			fds[nfds].revents = 0;
+			nfds++;
 		}
+		if (nfds == 0 && !polling)
+			break;
 
-		sleep(1);
-		monsec--;
-	}
-	free(monfile);
+		unsigned long long t = now_ms();
+		if (t >= deadline)
+			break;
+		int wait = deadline - t;
+		if (polling && wait > 100)
+			wait = 100;
+		int rv = poll(fds, nfds, wait);
+		if (rv == -1 && errno != EINTR)
+			errExit("poll");
 
+		// mark the processes terminated
+		int j = 0;
+		for (i = 0; i < cnt && rv > 0; i++) {
+			if (sbox[i].done || sbox[i].pidfd == -1)
+				continue;
+			if (fds[j++].revents)
+				sbox[i].done = 1;
+		}
+	}
 
-	// force SIGKILL
-	if (!killdone) {
-		// kill the process and also the parent
-		printf("Sending SIGKILL to %u\n", pid);
-		kill(pid, SIGKILL);
-		if (parent != pid) {
-			printf("Sending SIGKILL to %u\n", parent);
-			kill(parent, SIGKILL);
+	for (i = 0; i < cnt; i++) {
+		// force SIGKILL
+		if (!sbox[i].done) {
+			// kill the process and also the parent
+			printf("Sending SIGKILL to %u\n", sbox[i].pid);
+			shut_signal(&sbox[i], SIGKILL);
+			if (sbox[i].parent != sbox[i].pid) {
+				printf("Sending SIGKILL to %u\n", sbox[i].parent);
+				kill(sbox[i].parent, SIGKILL);
+			}
 		}
+
+		if (sbox[i].pidfd != -1)
+			close(sbox[i].pidfd);
+		delete_run_files(sbox[i].parent);
 	}
 
-	delete_run_files(parent);
+	free(fds);
+	free(sbox);
 }
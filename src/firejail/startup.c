@@ -0,0 +1,330 @@
+/*
+ * Copyright (C) 2014-2018 Firejail Authors
+ *
+ * This file is part of firejail project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+// Startup phase profiler (--profile-startup)
+//
+// Every process taking part in the sandbox setup (parent, sandbox init, network
+// configuration process, application) records its own phases. The trace file is
+// opened by the parent before anything else happens and it is inherited by the
+// children; each process appends its events with a single write when its part of
+// the setup is done, and the parent closes the JSON array when the sandbox
+// shuts down.
+//
+// The report is in Chrome trace event format (JSON array format), it can be loaded
+// in chrome://tracing or ui.perfetto.dev. For each phase we record the wall time,
+// the CPU time including the helper processes waited for during the phase, the
+// number of system calls and the change in the number of mount points.
+// The system calls are counted using raw_syscalls:sys_enter tracepoint; if perf
+// events are not available, only the read and write system calls reported
+// in /proc/self/io are counted.
+#include "firejail.h"
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+
+#define MAX_EVENTS 128
+#define MAX_DEPTH 16
+#define EVENT_LEN 512
+
+typedef struct sample_t {
+	unsigned long long wall;	// microseconds
+	unsigned long long cpu;		// microseconds
+	long long syscalls;		// -1 if not available
+	int mounts;			// -1 if not available
+} Sample;
+
+typedef struct event_t {
+	const char *name;
+	Sample start;
+	Sample end;
+} Event;
+
+static int trace_fd = -1;
+static int trace_tid = STARTUP_PARENT;
+static Event events[MAX_EVENTS];
+static int events_cnt = 0;
+static int stack[MAX_DEPTH];	// open phases, index in events array
+static int depth = 0;
+
+static uint64_t tracepoint_id = 0;	// raw_syscalls:sys_enter, 0 if not available
+static int perf_fd = -1;
+
+static const char *thread_name[STARTUP_MAX] = { NULL, "parent", "sandbox", "network", "application" };
+
+//**************************
+// counters
+//**************************
+static uint64_t read_tracepoint_id(void) {
+	static const char *fname[] = {
+		"/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+		"/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id",
+		NULL
+	};
+
+	int i;
+	for (i = 0; fname[i]; i++) {
+		FILE *fp = fopen(fname[i], "re");
+		if (!fp)
+			continue;
+		unsigned long long id;
+		int rv = fscanf(fp, "%llu", &id);
+		fclose(fp);
+		if (rv == 1)
+			return id;
+	}
+	return 0;
+}
+
+// count the system calls of the current process and its children
+static void perf_open(void) {
+	if (perf_fd != -1) {
+		close(perf_fd);
+		perf_fd = -1;
+	}
+	if (!tracepoint_id)
+		return;
+
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_TRACEPOINT;
+	attr.size = sizeof(attr);
+	attr.config = tracepoint_id;
+	attr.inherit = 1;
+	perf_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+	if (perf_fd == -1 && arg_debug)
+		printf("startup profiler: cannot count system calls, errno %d\n", errno);
+}
+
+static long long count_syscalls(void) {
+	if (perf_fd != -1) {
+		uint64_t val;
+		if (read(perf_fd, &val, sizeof(val)) == sizeof(val))
+			return val;
+		return -1;
+	}
+
+	// read and write system calls only
+	FILE *fp = fopen("/proc/self/io", "re");
+	if (!fp)
+		return -1;
+	char buf[256];
+	long long rv = 0;
+	int found = 0;
+	while (fgets(buf, sizeof(buf), fp)) {
+		long long val;
+		if (sscanf(buf, "syscr: %lld", &val) == 1 || sscanf(buf, "syscw: %lld", &val) == 1) {
+			rv += val;
+			found++;
+		}
+	}
+	fclose(fp);
+	return (found == 2)? rv: -1;
+}
+
+static int count_mounts(void) {
+	int fd = open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return -1;
+	char buf[16384];
+	int rv = 0;
+	ssize_t len;
+	while ((len = read(fd, buf, sizeof(buf))) > 0) {
+		char *ptr = buf;
+		while ((ptr = memchr(ptr, '\n', buf + len - ptr)) != NULL) {
+			rv++;
+			ptr++;
+		}
+	}
+	close(fd);
+	return (len == 0)? rv: -1;
+}
+
+static unsigned long long wall_time(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static unsigned long long cpu_time(void) {
+	struct rusage self;
+	struct rusage children;
+	if (getrusage(RUSAGE_SELF, &self) || getrusage(RUSAGE_CHILDREN, &children))
+		return 0;
+	return (unsigned long long) (self.ru_utime.tv_sec + self.ru_stime.tv_sec +
+		children.ru_utime.tv_sec + children.ru_stime.tv_sec) * 1000000ULL +
+		self.ru_utime.tv_usec + self.ru_stime.tv_usec +
+		children.ru_utime.tv_usec + children.ru_stime.tv_usec;
+}
+
+// the counters are read in reverse order at the end of the phase,
+// this keeps the cost of reading them out of the phase
+static void sample_start(Sample *s) {
+	s->mounts = count_mounts();
+	s->syscalls = count_syscalls();
+	s->cpu = cpu_time();
+	s->wall = wall_time();
+}
+
+static void sample_end(Sample *s) {
+	s->wall = wall_time();
+	s->cpu = cpu_time();
+	s->syscalls = count_syscalls();
+	s->mounts = count_mounts();
+}
+
+//**************************
+// public interface
+//**************************
+void startup_trace_open(const char *fname) {
+	EUID_ASSERT();
+	assert(fname);
+	invalid_filename(fname, 0); // no globbing
+
+	trace_fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+	if (trace_fd == -1) {
+		fprintf(stderr, "Error: cannot open %s\n", fname);
+		exit(1);
+	}
+
+	// the tracing filesystem is not visible from inside the sandbox
+	EUID_ROOT();
+	tracepoint_id = read_tracepoint_id();
+	perf_open();
+	EUID_USER();
+
+	char *buf;
+	int len = asprintf(&buf,
+		"[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"firejail %d\"}}",
+		sandbox_pid, STARTUP_PARENT, sandbox_pid);
+	if (len == -1)
+		errExit("asprintf");
+	int i;
+	for (i = STARTUP_PARENT; i < STARTUP_MAX; i++) {
+		char *tmp;
+		len = asprintf(&tmp,
+			"%s,\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+			buf, sandbox_pid, i, thread_name[i]);
+		if (len == -1)
+			errExit("asprintf");
+		free(buf);
+		buf = tmp;
+	}
+	if (write(trace_fd, buf, len) != len)
+		errExit("write");
+	free(buf);
+}
+
+// the current process takes over a part of the sandbox setup
+void startup_trace_thread(int tid) {
+	assert(tid > 0 && tid < STARTUP_MAX);
+	if (trace_fd == -1)
+		return;
+
+	// drop the events inherited from the parent process
+	trace_tid = tid;
+	events_cnt = 0;
+	depth = 0;
+	perf_open();
+}
+
+void startup_phase_start(const char *name) {
+	assert(name);
+	if (trace_fd == -1)
+		return;
+	if (events_cnt == MAX_EVENTS || depth == MAX_DEPTH) {
+		fwarning("too many startup phases, %s not recorded\n", name);
+		return;
+	}
+
+	Event *ev = &events[events_cnt];
+	ev->name = name;
+	ev->end.wall = 0;
+	stack[depth++] = events_cnt++;
+	sample_start(&ev->start);
+}
+
+void startup_phase_end(void) {
+	if (trace_fd == -1 || depth == 0)
+		return;
+	sample_end(&events[stack[--depth]].end);
+}
+
+static int print_event(char *buf, size_t size, const Event *ev) {
+	int len = snprintf(buf, size,
+		",\n{\"name\":\"%s\",\"cat\":\"startup\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+		"\"ts\":%llu,\"dur\":%llu,\"args\":{\"cpu_us\":%llu",
+		ev->name, sandbox_pid, trace_tid,
+		ev->start.wall, ev->end.wall - ev->start.wall, ev->end.cpu - ev->start.cpu);
+	if (ev->start.syscalls != -1 && ev->end.syscalls != -1)
+		len += snprintf(buf + len, size - len, ",\"%s\":%lld",
+			(perf_fd != -1)? "syscalls": "rw_syscalls", ev->end.syscalls - ev->start.syscalls);
+	if (ev->start.mounts != -1 && ev->end.mounts != -1)
+		len += snprintf(buf + len, size - len, ",\"mounts\":%d", ev->end.mounts - ev->start.mounts);
+	len += snprintf(buf + len, size - len, "}}");
+	assert((size_t) len < size);
+	return len;
+}
+
+// write the events recorded in the current process
+void startup_trace_flush(void) {
+	if (trace_fd == -1 || events_cnt == 0)
+		return;
+
+	char *buf = malloc(events_cnt * EVENT_LEN);
+	if (!buf)
+		errExit("malloc");
+	int len = 0;
+	int i;
+	for (i = 0; i < events_cnt; i++) {
+		if (events[i].end.wall)	// the phases still open are dropped
+			len += print_event(buf + len, EVENT_LEN, &events[i]);
+	}
+	events_cnt = 0;
+	depth = 0;
+
+	// the file is shared by all the processes, a single write keeps the events together
+	if (write(trace_fd, buf, len) != len)
+		fwarning("cannot write the startup trace\n");
+	free(buf);
+}
+
+// end all the phases and write the events before execve
+void startup_trace_exec(void) {
+	if (trace_fd == -1)
+		return;
+	while (depth)
+		startup_phase_end();
+	startup_trace_flush();
+}
+
+// called by the parent when the sandbox shuts down
+void startup_trace_close(void) {
+	if (trace_fd == -1)
+		return;
+	startup_trace_flush();
+	if (write(trace_fd, "\n]\n", 3) != 3)
+		fwarning("cannot write the startup trace\n");
+	close(trace_fd);
+	trace_fd = -1;
+}
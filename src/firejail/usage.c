@@ -72,6 +72,8 @@ static char *usage_str =
 	"    --dns=address - set DNS server.\n"
 	"    --dns.print=name|pid - print DNS configuration.\n"
 	"    --env=name=value - set environment variable.\n"
+	"    --fork-connect=name program - start a program in a fork server sandbox.\n"
+	"    --fork-server=name - start a fork server sandbox.\n"
 	"    --fs.print=name|pid - print the filesystem log.\n"
 #ifdef HAVE_FILE_TRANSFER
 	"    --get=name|pid filename - get a file from sandbox container.\n"
@@ -168,6 +170,7 @@ static char *usage_str =
 	"    --profile=filename - use a custom profile.\n"
 	"    --profile.print=name|pid - print the name of profile file.\n"
 	"    --profile-path=directory - use this directory to look for profile files.\n"
+	"    --profile-startup=filename - write a trace of the sandbox startup phases.\n"
 	"    --protocol=protocol,protocol,protocol - enable protocol filter.\n"
 	"    --protocol.print=name|pid - print the protocol filter.\n"
 #ifdef HAVE_FILE_TRANSFER
@@ -206,7 +209,9 @@ static char *usage_str =
 #endif
 	"    --shell=none - run the program directly without a user shell.\n"
 	"    --shell=program - set default user shell.\n"
-	"    --shutdown=name|pid - shutdown the sandbox identified by name or PID.\n"
+	"    --shutdown=name|pid,name|pid - shutdown the sandboxes identified by name\n"
+	"\tor PID.\n"
+	"    --shutdown-timeout=seconds - grace period for --shutdown, default 10.\n"
 	"    --timeout=hh:mm:ss - kill the sandbox automatically after the time\n"
 	"\thas elapsed.\n"
 	"    --tmpfs=dirname - mount a tmpfs filesystem on directory dirname.\n"
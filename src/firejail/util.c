@@ -252,20 +252,12 @@ static int copy_file_by_fd(int src, int dst) {
 	assert(src >= 0);
 	assert(dst >= 0);
 
-	ssize_t len;
-	static const int BUFLEN = 1024;
-	unsigned char buf[BUFLEN];
-	while ((len = read(src, buf, BUFLEN)) > 0) {
-		int done = 0;
-		while (done != len) {
-			int rv = write(dst, buf + done, len - done);
-			if (rv == -1)
-				return -1;
-			done += rv;
-		}
-	}
-//	fflush(0);
-	return 0;
+	CopyStats stats;
+	memset(&stats, 0, sizeof(stats));
+	int rv = copy_fd(src, dst, &stats);
+	if (arg_debug)
+		printf("%llu bytes copied using %llu system calls\n", stats.bytes, stats.syscalls);
+	return rv;
 }
 
 // return -1 if error, 0 if no error; if destname already exists, return error
@@ -1100,3 +1092,15 @@ int safe_fd(const char *path, int flags) {
 	free(dup);
 	return fd; // -1 if open failed
 }
+
+// 64 bit FNV-1a hash of a string, used for naming cache files
+unsigned long long str_hash64(const char *str) {
+	assert(str);
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	const unsigned char *ptr = (const unsigned char *) str;
+	while (*ptr) {
+		hash ^= *ptr++;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
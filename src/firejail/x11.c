@@ -30,6 +30,9 @@
 #include <sys/wait.h>
 #include <errno.h>
 #include <limits.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/inotify.h>
 
 // on Debian 7 we are missing O_PATH definition
 #include <fcntl.h>
@@ -201,6 +204,167 @@ static int random_display_number(void) {
 #endif
 
 #ifdef HAVE_X11
+// return 1 if the server accepts connections on the socket
+static int x11_socket_ready(const char *fname) {
+	struct sockaddr_un sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	if (strlen(fname) >= sizeof(sa.sun_path))
+		return 0;
+	strcpy(sa.sun_path, fname);
+
+	int sockfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (sockfd == -1)
+		errExit("socket");
+	int rv = connect(sockfd, (struct sockaddr *) &sa, sizeof(sa));
+	close(sockfd);
+	return rv == 0;
+}
+
+static unsigned long long x11_now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Wait for the X11 server to start. The server socket is detected using inotify
+// on /tmp/.X11-unix directory, the directory itself might be created by the server.
+// Return 0 if the server accepts connections, -1 if the server terminated or
+// the timeout (in seconds) expired.
+static int x11_wait_server(int display, pid_t server, int timeout) {
+	char *fname;
+	if (asprintf(&fname, "/tmp/.X11-unix/X%d", display) == -1)
+		errExit("asprintf");
+
+	int ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (ifd != -1 &&
+	    inotify_add_watch(ifd, "/tmp/.X11-unix", IN_CREATE | IN_MOVED_TO) == -1 &&
+	    inotify_add_watch(ifd, "/tmp", IN_CREATE | IN_MOVED_TO | IN_ONLYDIR) == -1) {
+		close(ifd);
+		ifd = -1;
+	}
+	int pidfd = pid_fd_open(server);
+
+	unsigned long long deadline = x11_now_ms() + timeout * 1000ULL;
+	int rv = -1;
+	while (1) {
+		// the socket is created before the server starts listening on it
+		int wait;
+		struct stat s;
+		if (stat(fname, &s) == 0) {
+			if (x11_socket_ready(fname)) {
+				rv = 0;
+				break;
+			}
+			wait = 10;
+		}
+		else
+			wait = (ifd == -1)? 100: 1000;
+		if (pidfd == -1 && wait > 100)
+			wait = 100;
+
+		if (waitpid(server, NULL, WNOHANG) == server)
+			break;
+		unsigned long long t = x11_now_ms();
+		if (t >= deadline)
+			break;
+		if ((unsigned long long) wait > deadline - t)
+			wait = deadline - t;
+
+		struct pollfd fds[2];
+		int nfds = 0;
+		if (ifd != -1) {
+			fds[nfds].fd = ifd;
+			fds[nfds++].events = POLLIN;
+		}
+		if (pidfd != -1) {
+			fds[nfds].fd = pidfd;
+			fds[nfds++].events = POLLIN;
+		}
+		if (poll(fds, nfds, wait) == -1 && errno != EINTR)
+			errExit("poll");
+
+		if (ifd != -1) {
+			char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+			while (read(ifd, buf, sizeof(buf)) > 0);
+			// start watching /tmp/.X11-unix as soon as it is created
+			int wd = inotify_add_watch(ifd, "/tmp/.X11-unix", IN_CREATE | IN_MOVED_TO);
+			(void) wd;
+		}
+	}
+
+	if (ifd != -1)
+		close(ifd);
+	if (pidfd != -1)
+		close(pidfd);
+	free(fname);
+	return rv;
+}
+
+// Wait for the xpra server to accept client connections. The X11 display is ready
+// before xpra creates its session socket, in ~/.xpra for older versions or in
+// $XDG_RUNTIME_DIR/xpra. A leftover socket from an old session refuses connections.
+// Return -1 if the server terminated; if the socket is not found before the timeout
+// (in seconds) expires, for example because of a custom socket-dir, the client
+// is started anyway.
+static int x11_wait_xpra(int display, pid_t server, int timeout) {
+	char host[HOST_NAME_MAX + 1];
+	if (gethostname(host, sizeof(host)))
+		errExit("gethostname");
+	host[HOST_NAME_MAX] = '\0';
+
+	char *rundir;
+	const char *xdg = getenv("XDG_RUNTIME_DIR");
+	if (xdg && *xdg)
+		rundir = strdup(xdg);
+	else if (asprintf(&rundir, "/run/user/%u", getuid()) == -1)
+		rundir = NULL;
+	if (!rundir)
+		errExit("strdup");
+
+	char *fname[3];
+	if (asprintf(&fname[0], "%s/.xpra/%s-%d", cfg.homedir, host, display) == -1 ||
+	    asprintf(&fname[1], "%s/xpra/%s-%d", rundir, host, display) == -1 ||
+	    asprintf(&fname[2], "%s/xpra/%d/socket", rundir, display) == -1)
+		errExit("asprintf");
+	free(rundir);
+
+	int pidfd = pid_fd_open(server);
+	unsigned long long deadline = x11_now_ms() + timeout * 1000ULL;
+	int rv = 0;
+	int i;
+	while (1) {
+		int found = 0;
+		for (i = 0; i < 3 && !found; i++)
+			found = x11_socket_ready(fname[i]);
+		if (found)
+			break;
+
+		if (waitpid(server, NULL, WNOHANG) == server) {
+			rv = -1;
+			break;
+		}
+		unsigned long long t = x11_now_ms();
+		if (t >= deadline) {
+			fwarning("cannot find xpra session socket, attaching anyway\n");
+			break;
+		}
+
+		// the socket directories might not exist yet, poll them
+		struct pollfd fds;
+		fds.fd = pidfd;
+		fds.events = POLLIN;
+		if (poll(&fds, (pidfd == -1)? 0: 1, (deadline - t < 50)? deadline - t: 50) == -1 && errno != EINTR)
+			errExit("poll");
+	}
+
+	if (pidfd != -1)
+		close(pidfd);
+	for (i = 0; i < 3; i++)
+		free(fname[i]);
+	return rv;
+}
+
 void x11_start_xvfb(int argc, char **argv) {
 	EUID_ASSERT();
 	int i;
@@ -335,23 +499,11 @@ void x11_start_xvfb(int argc, char **argv) {
 	if (arg_debug)
 		printf("xvfb server pid %d\n", server);
 
-	// check X11 socket
-	char *fname;
-	if (asprintf(&fname, "/tmp/.X11-unix/X%d", display) == -1)
-		errExit("asprintf");
-	int n = 0;
 	// wait for x11 server to start
-	while (++n < 10) {
-		sleep(1);
-		if (stat(fname, &s) == 0)
-			break;
-	};
-
-	if (n == 10) {
+	if (x11_wait_server(display, server, 10)) {
 		fprintf(stderr, "Error: failed to start xvfb\n");
 		exit(1);
 	}
-	free(fname);
 
 	assert(display_str);
 	setenv("DISPLAY", display_str, 1);
@@ -564,23 +716,11 @@ void x11_start_xephyr(int argc, char **argv) {
 	if (arg_debug)
 		printf("xephyr server pid %d\n", server);
 
-	// check X11 socket
-	char *fname;
-	if (asprintf(&fname, "/tmp/.X11-unix/X%d", display) == -1)
-		errExit("asprintf");
-	int n = 0;
 	// wait for x11 server to start
-	while (++n < 10) {
-		sleep(1);
-		if (stat(fname, &s) == 0)
-			break;
-	};
-
-	if (n == 10) {
+	if (x11_wait_server(display, server, 10)) {
 		fprintf(stderr, "Error: failed to start xephyr\n");
 		exit(1);
 	}
-	free(fname);
 
 	assert(display_str);
 	setenv("DISPLAY", display_str, 1);
@@ -728,26 +868,12 @@ void x11_start_xpra_old(int argc, char **argv, int display, char *display_str) {
 		_exit(1);
 	}
 
-	// add a small delay, on some systems it takes some time for the server to start
-	sleep(5);
-
-	// check X11 socket
-	char *fname;
-	if (asprintf(&fname, "/tmp/.X11-unix/X%d", display) == -1)
-		errExit("asprintf");
-	int n = 0;
-	// wait for x11 server to start
-	while (++n < 10) {
-		sleep(1);
-		if (stat(fname, &s) == 0)
-			break;
-	}
-
-	if (n == 10) {
+	// wait for x11 server to start; on some systems it takes some time for xpra to start
+	// xpra accepts client connections only after the display is up
+	if (x11_wait_server(display, server, 15) || x11_wait_xpra(display, server, 10)) {
 		fprintf(stderr, "Error: failed to start xpra\n");
 		exit(1);
 	}
-	free(fname);
 
 	// build attach command
 	char *attach_argv[] = { "xpra", "--title=\"firejail x11 sandbox\"", "attach", display_str, NULL };
@@ -829,6 +955,7 @@ void x11_start_xpra_old(int argc, char **argv, int display, char *display_str) {
 			}
 
 			// wait for xpra server to stop, 10 seconds limit
+			int n = 0;
 			while (++n < 10) {
 				sleep(1);
 				pid = waitpid(server, NULL, WNOHANG);
@@ -1190,6 +1317,8 @@ void x11_xorg(void) {
 		exit(1);
 	}
 
+	int mount_id = get_mount_id(fd);
+
 	// mount via the link in /proc/self/fd
 	char *proc;
 	if (asprintf(&proc, "/proc/self/fd/%d", fd) == -1)
@@ -1200,9 +1329,8 @@ void x11_xorg(void) {
 	}
 	free(proc);
 	close(fd);
-	// check /proc/self/mountinfo to confirm the mount is ok
-	MountData *mptr = get_last_mount();
-	if (strcmp(mptr->dir, dest) != 0 || strcmp(mptr->fstype, "tmpfs") != 0)
+	// confirm the mount is ok
+	if (check_mount(dest, mount_id, 1))
 		errLogExit("invalid .Xauthority mount");
 
 	ASSERT_PERMS(dest, getuid(), getgid(), 0600);
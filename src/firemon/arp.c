@@ -76,9 +76,10 @@ void arp(pid_t pid, int print_procs) {
 	pid_read(pid);
 
 	// print processes
-	int i;
-	for (i = 0; i < max_pids; i++) {
-		if (pids[i].level == 1) {
+	Process *p;
+	for (p = pid_first(); p; p = p->next) {
+		pid_t i = p->pid;
+		if (p->level == 1) {
 			if (print_procs || pid == 0)
 				pid_print_list(i, arg_nowrap);
 			int child = find_child(i);
@@ -49,9 +49,10 @@ void cgroup(pid_t pid, int print_procs) {
 
 	// print processes
 	printf("  cgroup: ");
-	int i;
-	for (i = 0; i < max_pids; i++) {
-		if (pids[i].level == 1) {
+	Process *p;
+	for (p = pid_first(); p; p = p->next) {
+		pid_t i = p->pid;
+		if (p->level == 1) {
 			if (print_procs || pid == 0)
 				pid_print_list(i, arg_nowrap);
 			int child = find_child(i);
@@ -24,6 +24,8 @@
 #include <sys/prctl.h>
 #include <grp.h>
 #include <sys/stat.h>
+#include <poll.h>
+#include <time.h>
 
 pid_t skip_process = 0;
 static int arg_route = 0;
@@ -40,6 +42,8 @@ static int arg_list = 0;
 static int arg_netstats = 0;
 static int arg_apparmor = 0;
 int arg_nowrap = 0;
+unsigned arg_interval = 1000;	// refresh interval for --top and --netstats, milliseconds
+int arg_json = 0;	// --format=json
 
 static struct termios tlocal;	// startup terminal setting
 static struct termios twait;	// no wait on key press
@@ -63,13 +67,13 @@ static void my_handler(int s){
 //    14792:netblue:/usr/bin/transmission-qt
 // We need 14792, the first real sandboxed process
 int find_child(int id) {
-	int i;
+	Process *p;
 	int first_child = -1;
 
 	// find the first child
-	for (i = 0; i < max_pids; i++) {
-		if (pids[i].level == 2 && pids[i].parent == id) {
-			first_child = i;
+	for (p = pid_first(); p; p = p->next) {
+		if (p->level == 2 && p->parent == id) {
+			first_child = p->pid;
 			break;
 		}
 	}
@@ -78,9 +82,9 @@ int find_child(int id) {
 		return -1;
 
 	// find the second child
-	for (i = 0; i < max_pids; i++) {
-		if (pids[i].level == 3 && pids[i].parent == first_child)
-			return i;
+	for (p = pid_first(); p; p = p->next) {
+		if (p->level == 3 && p->parent == first_child)
+			return p->pid;
 	}
 
 	return -1;
@@ -88,6 +92,18 @@ int find_child(int id) {
 
 // sleep and wait for a key to be pressed
 void firemon_sleep(int st) {
+	firemon_wait(NULL, 0, st * 1000);
+}
+
+// wait for a key to be pressed or for an event on one of the file descriptors;
+// return the number of file descriptors ready, 0 on timeout
+int firemon_wait(struct pollfd *fds, int nfds, int timeout) {
+	// no terminal handling for JSON output
+	if (arg_json) {
+		int ready = poll(fds, nfds, timeout);
+		return (ready < 0)? 0: ready;
+	}
+
 	if (terminal_set == 0) {
 		tcgetattr(0, &twait);          // get current terminal attributes; 0 is the file descriptor for stdin
 		memcpy(&tlocal, &twait, sizeof(tlocal));
@@ -100,24 +116,90 @@ void firemon_sleep(int st) {
 	tcsetattr(0, TCSANOW, &twait);
 
 
-	fd_set fds;
-	FD_ZERO(&fds);
-	FD_SET(0,&fds);
-	int maxfd = 1;
+	// stdin is the first entry
+	struct pollfd pfd[nfds + 1];
+	pfd[0].fd = 0;
+	pfd[0].events = POLLIN;
+	if (nfds)
+		memcpy(pfd + 1, fds, nfds * sizeof(struct pollfd));
 
-	struct timeval ts;
-	ts.tv_sec = st;
-	ts.tv_usec = 0;
-
-	int ready = select(maxfd, &fds, (fd_set *) 0, (fd_set *) 0, &ts);
-	(void) ready;
-	if( FD_ISSET(0, &fds)) {
+	int ready = poll(pfd, nfds + 1, timeout);
+	if (ready > 0 && pfd[0].revents) {
 		getchar();
 		tcsetattr(0, TCSANOW, &tlocal);
 		printf("\n");
 		exit(0);
 	}
 	tcsetattr(0, TCSANOW, &tlocal);
+
+	if (ready <= 0)
+		return 0;
+	if (nfds)
+		memcpy(fds, pfd + 1, nfds * sizeof(struct pollfd));
+	return ready;
+}
+
+
+//**************************
+// JSON output
+//**************************
+// print a JSON string, null if str is NULL
+void json_string(const char *str) {
+	if (!str) {
+		printf("null");
+		return;
+	}
+
+	putchar('"');
+	const unsigned char *ptr = (const unsigned char *) str;
+	while (*ptr) {
+		if (*ptr == '"' || *ptr == '\\') {
+			putchar('\\');
+			putchar(*ptr);
+		}
+		else if (*ptr < 0x20)
+			printf("\\u%04x", *ptr);
+		else
+			putchar(*ptr);
+		ptr++;
+	}
+	putchar('"');
+}
+
+// print the fields identifying a sandbox
+void json_sandbox(pid_t pid, const char *user, const char *cmd) {
+	char *name = pid_get_sandbox_name(pid);
+	printf("\"pid\":%d,\"name\":", pid);
+	json_string(name);
+	printf(",\"user\":");
+	json_string(user);
+	printf(",\"cmd\":");
+	json_string(cmd);
+	free(name);
+}
+
+// sandbox running time in seconds
+unsigned long long firemon_uptime(pid_t pid) {
+	static long clocktick = 0;
+	if (clocktick == 0)
+		clocktick = sysconf(_SC_CLK_TCK);
+
+	float sysuptime = 0;
+	FILE *fp = fopen("/proc/uptime", "re");
+	if (fp) {
+		int rv = fscanf(fp, "%f", &sysuptime);
+		(void) rv;
+		fclose(fp);
+	}
+	unsigned long long start = pid_get_start_time(pid) / clocktick;
+	return ((unsigned long long) sysuptime > start)? (unsigned long long) sysuptime - start: 0;
+}
+
+// milliseconds since epoch
+unsigned long long json_time(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (unsigned long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
 
@@ -194,6 +276,25 @@ int main(int argc, char **argv) {
 		// etc
 		else if (strcmp(argv[i], "--nowrap") == 0)
 			arg_nowrap = 1;
+		else if (strncmp(argv[i], "--interval=", 11) == 0) {
+			char *end;
+			unsigned long val = strtoul(argv[i] + 11, &end, 10);
+			if (end == argv[i] + 11 || *end || val < 100 || val > 3600000) {
+				fprintf(stderr, "Error: invalid --interval value, 100 to 3600000 milliseconds\n");
+				return 1;
+			}
+			arg_interval = val;
+		}
+		else if (strncmp(argv[i], "--format=", 9) == 0) {
+			if (strcmp(argv[i] + 9, "json") == 0)
+				arg_json = 1;
+			else if (strcmp(argv[i] + 9, "text") == 0)
+				arg_json = 0;
+			else {
+				fprintf(stderr, "Error: invalid --format value, json or text\n");
+				return 1;
+			}
+		}
 
 		// invalid option
 		else if (*argv[i] == '-') {
@@ -231,6 +332,19 @@ int main(int argc, char **argv) {
 		exit(1);
 	}
 
+	if (arg_json) {
+		if (arg_cpu || arg_seccomp || arg_caps || arg_apparmor || arg_cgroup ||
+		    arg_x11 || arg_interface || arg_route || arg_arp) {
+			fprintf(stderr, "Error: --format=json is available only for --top, --netstats, --list, --tree "
+				"and process event monitoring\n");
+			return 1;
+		}
+
+		// the records are flushed once for every refresh interval or event batch
+		static char outbuf[65536];
+		setvbuf(stdout, outbuf, _IOFBF, sizeof(outbuf));
+	}
+
 	if (arg_top) {
 		top();	// print all sandboxes, --name disregarded
 		return 0;
@@ -249,7 +363,7 @@ int main(int argc, char **argv) {
 	}
 
 	// if --name requested without other options, print all data
-	if (pid && !arg_cpu && !arg_seccomp && !arg_caps && !arg_apparmor &&
+	if (pid && !arg_json && !arg_cpu && !arg_seccomp && !arg_caps && !arg_apparmor &&
 	    !arg_cgroup && !arg_x11 && !arg_interface && !arg_route && !arg_arp) {
 		arg_tree = 1;
 		arg_cpu = 1;
@@ -26,6 +26,7 @@
 #include <string.h>
 #include <errno.h>
 #include <stdint.h>
+#include <poll.h>
 #include "../include/pid.h"
 #include "../include/common.h"
 
@@ -38,11 +39,19 @@ static inline void firemon_clrscr(void) {
 // firemon.c
 extern pid_t skip_process;
 extern int arg_nowrap;
+extern unsigned arg_interval;
+extern int arg_json;
 int find_child(int id);
 void firemon_sleep(int st);
+int firemon_wait(struct pollfd *fds, int nfds, int timeout);
+void json_string(const char *str);
+void json_sandbox(pid_t pid, const char *user, const char *cmd);
+unsigned long long json_time(void);
+unsigned long long firemon_uptime(pid_t pid);
 
 
 // procevent.c
+int procevent_netlink_open(void);
 void procevent(pid_t pid);
 
 // usage.c
@@ -79,6 +88,8 @@ void cgroup(pid_t pid, int print_procs);
 void tree(pid_t pid);
 
 // netstats.c
+int has_netns(pid_t pid);
+void get_stats(int parent);
 void netstats(void);
 
 // x11.c
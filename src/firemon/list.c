@@ -23,11 +23,25 @@ void list(void) {
 	pid_read(0);	// include all processes
 
 	// print processes
-	int i;
-	for (i = 0; i < max_pids; i++) {
+	Process *p;
+	for (p = pid_first(); p; p = p->next) {
+		pid_t i = p->pid;
 		if (i == skip_process)
 			continue;
-		if (pids[i].level == 1)
+		if (p->level != 1)
+			continue;
+
+		if (arg_json) {
+			char *user = pid_get_user_name(p->uid);
+			char *cmd = pid_proc_cmdline(i);
+			printf("{\"type\":\"sandbox\",");
+			json_sandbox(i, user, cmd);
+			printf("}\n");
+			free(user);
+			free(cmd);
+		}
+		else
 			pid_print_list(i, arg_nowrap);
 	}
+	fflush(0);
 }
@@ -53,16 +53,31 @@ static char *get_header(void) {
 	return rv;
 }
 
+// return 1 if the sandbox has its own network namespace
+int has_netns(pid_t pid) {
+	char *name;
+	if (asprintf(&name, "/run/firejail/network/%d-netmap", pid) == -1)
+		errExit("asprintf");
+	struct stat s;
+	int rv = (stat(name, &s) == 0);
+	free(name);
+	return rv;
+}
+
 void get_stats(int parent) {
+	Process *p = pid_find(parent);
+	assert(p);
+
 	// find the first child
-	int child = -1;
-	for (child = parent + 1; child < max_pids; child++) {
-		if (pids[child].parent == parent)
+	Process *ptr;
+	for (ptr = p->next; ptr; ptr = ptr->next) {
+		if (ptr->parent == parent)
 			break;
 	}
 
-	if (child == -1)
+	if (!ptr)
 		goto errexit;
+	int child = ptr->pid;
 
 	// open /proc/child/net/dev file and read rx and tx
 	char *fname;
@@ -104,11 +119,11 @@ void get_stats(int parent) {
 		tx += txval;
 	}
 
-	// store data
-	pids[parent].rx_delta = rx - pids[parent].rx;
-	pids[parent].rx = rx;
-	pids[parent].tx_delta = tx - pids[parent].tx;
-	pids[parent].tx = tx;
+	// store data; there is no delta on the first reading
+	p->rx_delta = (p->rx)? rx - p->rx: 0;
+	p->rx = rx;
+	p->tx_delta = (p->tx)? tx - p->tx: 0;
+	p->tx = tx;
 
 
 	free(fname);
@@ -116,10 +131,10 @@ void get_stats(int parent) {
 	return;
 
 errexit:
-	pids[parent].rx = 0;
-	pids[parent].tx = 0;
-	pids[parent].rx_delta = 0;
-	pids[parent].tx_delta = 0;
+	p->rx = 0;
+	p->tx = 0;
+	p->rx_delta = 0;
+	p->tx_delta = 0;
 }
 
 
@@ -134,11 +149,14 @@ static void print_proc(int index, int itv, int col) {
 		firejail_exec_prefix_len = strlen(PREFIX) + 5;
 	}
 
+	Process *p = pid_find(index);
+	assert(p);
+
 	// command
 	char *cmd = pid_proc_cmdline(index);
 	char *ptrcmd;
 	if (cmd == NULL) {
-		if (pids[index].zombie)
+		if (p->zombie)
 			ptrcmd = "(zombie)";
 		else
 			ptrcmd = "";
@@ -149,11 +167,7 @@ static void print_proc(int index, int itv, int col) {
 		ptrcmd = cmd;
 
 	// check network namespace
-	char *name;
-	if (asprintf(&name, "/run/firejail/network/%d-netmap", index) == -1)
-		errExit("asprintf");
-	struct stat s;
-	if (stat(name, &s) == -1) {
+	if (!has_netns(index)) {
 		// the sandbox doesn't have a --net= option, don't print
 		if (cmd)
 			free(cmd);
@@ -165,19 +179,31 @@ static void print_proc(int index, int itv, int col) {
 	snprintf(pidstr, 11, "%d", index);
 
 	// user
-	char *user = get_user_name(pids[index].uid);
+	char *user = get_user_name(p->uid);
 	char *ptruser;
 	if (user)
 		ptruser = user;
 	else
 		ptruser = "";
 
+	if (arg_json) {
+		printf("{\"type\":\"netstats\",\"time\":%llu,\"interval\":%d,", json_time(), itv);
+		json_sandbox(index, user, cmd);
+		printf(",\"rx\":%u,\"tx\":%u,\"uptime\":%llu}\n",
+			p->rx_delta, p->tx_delta, firemon_uptime(index));
+		if (cmd)
+			free(cmd);
+		if (user)
+			free(user);
+		return;
+	}
 
-	float rx_kbps = ((float) pids[index].rx_delta / 1000) / itv;
+	// itv in milliseconds
+	float rx_kbps = ((float) p->rx_delta / itv);
 	char ptrrx[15];
 	sprintf(ptrrx, "%.03f", rx_kbps);
 
-	float tx_kbps = ((float) pids[index].tx_delta / 1000) / itv;
+	float tx_kbps = ((float) p->tx_delta / itv);
 	char ptrtx[15];
 	sprintf(ptrtx, "%.03f", tx_kbps);
 
@@ -198,50 +224,54 @@ static void print_proc(int index, int itv, int col) {
 void netstats(void) {
 	pid_read(0);	// include all processes
 
-	printf("Displaying network statistics only for sandboxes using a new network namespace.\n");
+	if (!arg_json)
+		printf("Displaying network statistics only for sandboxes using a new network namespace.\n");
 
 	// print processes
 	while (1) {
 		// set pid table
-		int i;
-		int itv = 1; 	// 1 second  interval
+		Process *p;
 		pid_read(0);
 
 		// start rx/tx measurements
-		for (i = 0; i < max_pids; i++) {
-			if (pids[i].level == 1)
-				get_stats(i);
+		for (p = pid_first(); p; p = p->next) {
+			if (p->level == 1)
+				get_stats(p->pid);
 		}
 
-		// wait 1 seconds
-		firemon_sleep(itv);
+		// wait for the refresh interval
+		firemon_wait(NULL, 0, arg_interval);
 
 		// grab screen size
 		struct winsize sz;
 		int row = 24;
 		int col = 80;
-		if (!ioctl(0, TIOCGWINSZ, &sz)) {
-			col = sz.ws_col;
-			row = sz.ws_row;
-		}
+		if (!arg_json) {
+			if (!ioctl(0, TIOCGWINSZ, &sz)) {
+				col = sz.ws_col;
+				row = sz.ws_row;
+			}
 
-		// start printing
-		firemon_clrscr();
-		char *header = get_header();
-		if (strlen(header) > (size_t)col)
-			header[col] = '\0';
-		printf("%s\n", header);
-		if (row > 0)
-			row--;
-		free(header);
+			// start printing
+			firemon_clrscr();
+			char *header = get_header();
+			if (strlen(header) > (size_t)col)
+				header[col] = '\0';
+			printf("%s\n", header);
+			if (row > 0)
+				row--;
+			free(header);
+		}
 
 		// start rx/tx measurements
-		for (i = 0; i < max_pids; i++) {
-			if (pids[i].level == 1) {
-				get_stats(i);
-				print_proc(i, itv, col);
+		for (p = pid_first(); p; p = p->next) {
+			if (p->level == 1) {
+				get_stats(p->pid);
+				print_proc(p->pid, arg_interval, col);
 			}
 		}
+		if (arg_json)
+			fflush(0);
 #ifdef HAVE_GCOV
 			__gcov_flush();
 #endif
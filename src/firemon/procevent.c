@@ -158,11 +158,12 @@ doexit:
 }
 
 
-static int procevent_netlink_setup(void) {
+// subscribe to process events; return -1 if error
+int procevent_netlink_open(void) {
 	// open socket for process event connector
 	int sock;
-	if ((sock = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_CONNECTOR)) < 0)
-		goto errexit;
+	if ((sock = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR)) < 0)
+		return -1;
 
 	// bind socket
 	struct sockaddr_nl addr;
@@ -201,11 +202,64 @@ static int procevent_netlink_setup(void) {
 
 	return sock;
 errexit:
-	fprintf(stderr, "Error: netlink socket problem\n");
-	exit(1);
+	close(sock);
+	return -1;
+}
+
+static int procevent_netlink_setup(void) {
+	int sock = procevent_netlink_open();
+	if (sock == -1) {
+		fprintf(stderr, "Error: netlink socket problem\n");
+		exit(1);
+	}
+	return sock;
 }
 
 
+static const char *event_name(unsigned what) {
+	switch (what) {
+		case PROC_EVENT_FORK:
+			return "fork";
+		case PROC_EVENT_EXEC:
+			return "exec";
+		case PROC_EVENT_EXIT:
+			return "exit";
+		case PROC_EVENT_UID:
+			return "uid";
+		case PROC_EVENT_GID:
+			return "gid";
+		case PROC_EVENT_SID:
+			return "sid";
+		default:
+			return "unknown";
+	}
+}
+
+// one JSON record for each event
+static void print_event_json(struct proc_event *proc_ev, pid_t pid, const char *user,
+	const char *cmd, const char *sandbox, pid_t child) {
+	printf("{\"type\":\"event\",\"time\":%llu,\"event\":\"%s\",\"pid\":%d,\"user\":",
+		json_time(), event_name(proc_ev->what), pid);
+	json_string(user);
+	printf(",\"cmd\":");
+	json_string(cmd);
+	if (sandbox)
+		printf(",\"sandbox\":\"%s\"", sandbox);
+	if (child) {
+		char *child_cmd = pid_proc_cmdline(child);
+		printf(",\"child\":%d,\"child_cmd\":", child);
+		json_string(child_cmd);
+		free(child_cmd);
+	}
+	if (proc_ev->what == PROC_EVENT_UID)
+		printf(",\"ruid\":%u,\"euid\":%u",
+			proc_ev->event_data.id.r.ruid, proc_ev->event_data.id.e.euid);
+	else if (proc_ev->what == PROC_EVENT_GID)
+		printf(",\"rgid\":%u,\"egid\":%u",
+			proc_ev->event_data.id.r.rgid, proc_ev->event_data.id.e.egid);
+	printf("}\n");
+}
+
 static int procevent_monitor(const int sock, pid_t mypid) {
 	ssize_t len;
 	struct nlmsghdr *nlmsghdr;
@@ -285,6 +339,7 @@ static int procevent_monitor(const int sock, pid_t mypid) {
 			pid_t pid = 0;
 			pid_t child = 0;
 			int remove_pid = 0;
+			Process *p;
 			switch (proc_ev->what) {
 				case PROC_EVENT_FORK:
 #ifdef DEBUG_PRCTL
@@ -297,12 +352,12 @@ static int procevent_monitor(const int sock, pid_t mypid) {
 #ifdef DEBUG_PRCTL
 	printf("%s: %d, event fork, pid %d\n", __FUNCTION__, __LINE__, pid);
 #endif
-					if (pids[pid].level > 0) {
+					if ((p = pid_find(pid)) != NULL) {
 						child = proc_ev->event_data.fork.child_tgid;
-						child %= max_pids;
-						pids[child].level = pids[pid].level + 1;
-						pids[child].uid = pid_get_uid(child);
-						pids[child].parent = pid;
+						Process *c = pid_add(child);
+						c->level = p->level + 1;
+						c->uid = pid_get_uid(child);
+						c->parent = pid;
 					}
 					sprintf(lineptr, " fork");
 					break;
@@ -311,9 +366,6 @@ static int procevent_monitor(const int sock, pid_t mypid) {
 #ifdef DEBUG_PRCTL
 	printf("%s: %d, event exec, pid %d\n", __FUNCTION__, __LINE__, pid);
 #endif
-					if (pids[pid].level == -1) {
-						pids[pid].level = 0; // start tracking
-					}
 					sprintf(lineptr, " exec");
 					break;
 
@@ -337,8 +389,8 @@ static int procevent_monitor(const int sock, pid_t mypid) {
 #ifdef DEBUG_PRCTL
 	printf("%s: %d, event uid, pid %d\n", __FUNCTION__, __LINE__, pid);
 #endif
-					if (pids[pid].level == 1 ||
-					    pids[pids[pid].parent].level == 1) {
+					if ((p = pid_find(pid)) != NULL &&
+					    (p->level == 1 || p->level == 2)) {
 						sprintf(lineptr, "\n");
 						continue;
 					}
@@ -353,8 +405,8 @@ static int procevent_monitor(const int sock, pid_t mypid) {
 #ifdef DEBUG_PRCTL
 	printf("%s: %d, event gid, pid %d\n", __FUNCTION__, __LINE__, pid);
 #endif
-					if (pids[pid].level == 1 ||
-					    pids[pids[pid].parent].level == 1) {
+					if ((p = pid_find(pid)) != NULL &&
+					    (p->level == 1 || p->level == 2)) {
 						sprintf(lineptr, "\n");
 						continue;
 					}
@@ -383,80 +435,90 @@ static int procevent_monitor(const int sock, pid_t mypid) {
 			}
 
 			int add_new = 0;
-			if (pids[pid].level < 0)	// not a firejail process
-				continue;
-			else if (pids[pid].level == 0) { // new porcess, do we track it?
-				if (pid_is_firejail(pid) && mypid == 0) {
-					pids[pid].level = 1;
+			p = pid_find(pid);
+			if (!p) { // new process, do we track it?
+				if (proc_ev->what == PROC_EVENT_EXEC && mypid == 0 && pid_is_firejail(pid)) {
+					p = pid_add(pid);
+					p->level = 1;
+					p->uid = pid_get_uid(pid);
 					add_new = 1;
 				}
-				else {
-					pids[pid].level = -1;
+				else
 					continue;
-				}
 			}
 
 			lineptr += strlen(lineptr);
 			sprintf(lineptr, " %u", pid);
 			lineptr += strlen(lineptr);
 
-			char *user = pids[pid].user;
+			char *user = p->user;
 			if (!user)
-				user = pid_get_user_name(pids[pid].uid);
+				user = pid_get_user_name(p->uid);
 			if (user) {
-				pids[pid].user = user;
+				p->user = user;
 				sprintf(lineptr, " (%s)", user);
 				lineptr += strlen(lineptr);
 			}
 
 
 			int sandbox_closed = 0; // exit sandbox flag
-			char *cmd = pids[pid].cmd;
+			char *cmd = p->cmd;
 			if (!cmd) {
 				cmd = pid_proc_cmdline(pid);
 			}
-			if (add_new) {
-				if (!cmd)
-					sprintf(lineptr, " NEW SANDBOX\n");
-				else
-					sprintf(lineptr, " NEW SANDBOX: %s\n", cmd);
-				lineptr += strlen(lineptr);
-			}
-			else if (proc_ev->what == PROC_EVENT_EXIT && pids[pid].level == 1) {
-				sprintf(lineptr, " EXIT SANDBOX\n");
-				lineptr += strlen(lineptr);
-				if (mypid == pid)
-					sandbox_closed = 1;
+			if (arg_json) {
+				const char *sandbox = NULL;
+				if (add_new)
+					sandbox = "new";
+				else if (proc_ev->what == PROC_EVENT_EXIT && p->level == 1) {
+					sandbox = "exit";
+					if (mypid == pid)
+						sandbox_closed = 1;
+				}
+				print_event_json(proc_ev, pid, user, cmd, sandbox, child);
+				if (cmd != p->cmd)
+					free(cmd);
 			}
 			else {
-				if (!cmd) {
-					cmd = pid_proc_cmdline(pid);
+				if (add_new) {
+					if (!cmd)
+						sprintf(lineptr, " NEW SANDBOX\n");
+					else
+						sprintf(lineptr, " NEW SANDBOX: %s\n", cmd);
+					lineptr += strlen(lineptr);
+				}
+				else if (proc_ev->what == PROC_EVENT_EXIT && p->level == 1) {
+					sprintf(lineptr, " EXIT SANDBOX\n");
+					lineptr += strlen(lineptr);
+					if (mypid == pid)
+						sandbox_closed = 1;
 				}
-				if (cmd == NULL)
-					sprintf(lineptr, "\n");
 				else {
-					sprintf(lineptr, " %s\n", cmd);
-					free(cmd);
+					if (!cmd) {
+						cmd = pid_proc_cmdline(pid);
+					}
+					if (cmd == NULL)
+						sprintf(lineptr, "\n");
+					else {
+						sprintf(lineptr, " %s\n", cmd);
+						free(cmd);
+					}
+					lineptr += strlen(lineptr);
 				}
-				lineptr += strlen(lineptr);
-			}
-			(void) lineptr;
+				(void) lineptr;
 
-			// print the event
-			printf("%s", line);
-			fflush(0);
+				// print the event
+				printf("%s", line);
+				fflush(0);
+			}
 
 			// unflag pid for exit events
 			if (remove_pid) {
-				if (pids[pid].user)
-					free(pids[pid].user);
-				if (pids[pid].cmd)
-					free(pids[pid].cmd);
-				memset(&pids[pid], 0, sizeof(Process));
+				pid_remove(pid);
 			}
 
 			// print forked child
-			if (child) {
+			if (child && !arg_json) {
 				cmd = pid_proc_cmdline(child);
 				if (cmd) {
 					printf("\tchild %u %s\n", child, cmd);
@@ -468,15 +530,19 @@ static int procevent_monitor(const int sock, pid_t mypid) {
 
 			// on uid events the uid is changing
 			if (proc_ev->what == PROC_EVENT_UID) {
-				if (pids[pid].user)
-					free(pids[pid].user);
-				pids[pid].user = 0;
-				pids[pid].uid = pid_get_uid(pid);
+				if (p->user)
+					free(p->user);
+				p->user = 0;
+				p->uid = pid_get_uid(pid);
 			}
 
 			if (sandbox_closed)
 				exit(0);
 		}
+
+		// JSON records are written once for every batch of events
+		if (arg_json)
+			fflush(0);
 	}
 	return 0;
 }
@@ -23,6 +23,12 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/inotify.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <linux/cn_proc.h>
 
 static unsigned pgs_rss = 0;
 static unsigned pgs_shared = 0;
@@ -57,6 +63,101 @@ static char *get_header(void) {
 static char *firejail_exec = NULL;
 static int firejail_exec_len = 0;
 static int firejail_exec_prefix_len = 0;
+
+// build the output line for a sandbox
+static char *top_line(unsigned index, int zombie, const char *cmd, const char *user,
+	unsigned rss_pages, unsigned shared_pages, float cpu, int cnt) {
+	char *rv;
+
+	if (!firejail_exec) {
+		if (asprintf(&firejail_exec, "%s/bin/firejail", PREFIX) == -1)
+			errExit("asprintf");
+		firejail_exec_len = strlen(firejail_exec);
+		firejail_exec_prefix_len = strlen(PREFIX) + 5;
+	}
+
+	// pid
+	char pidstr[10];
+	snprintf(pidstr, 10, "%u", index);
+
+	// command
+	const char *ptrcmd;
+	if (cmd == NULL) {
+		if (zombie)
+			ptrcmd = "(zombie)";
+		else
+			ptrcmd = "";
+	}
+	else if (strncmp(cmd, firejail_exec, firejail_exec_len) == 0)
+		ptrcmd = cmd + firejail_exec_prefix_len;
+	else
+		ptrcmd = cmd;
+
+	// user
+	const char *ptruser;
+	if (user)
+		ptruser = user;
+	else
+		ptruser = "";
+
+	// memory
+	if (pgsz == 0)
+		pgsz = getpagesize();
+	char rss[10];
+	snprintf(rss, 10, "%u", rss_pages * pgsz / 1024);
+	char shared[10];
+	snprintf(shared, 10, "%u", shared_pages * pgsz / 1024);
+
+	// uptime
+	unsigned long long uptime = pid_get_start_time(index);
+	if (clocktick == 0)
+		clocktick = sysconf(_SC_CLK_TCK);
+	uptime /= clocktick;
+	uptime = sysuptime - uptime;
+	unsigned sec = uptime % 60;
+	uptime -= sec;
+	uptime /= 60;
+	unsigned min = uptime % 60;
+	uptime -= min;
+	uptime /= 60;
+	unsigned hour = uptime;
+	char uptime_str[50];
+	snprintf(uptime_str, 50, "%02u:%02u:%02u", hour, min, sec);
+
+	// cpu
+	char cpu_str[10];
+	snprintf(cpu_str, 10, "%2.1f", cpu);
+
+	// process count
+	char prcs_str[10];
+	snprintf(prcs_str, 10, "%d", cnt);
+
+	if (asprintf(&rv, "%-5.5s %-9.9s %-8.8s %-8.8s %-5.5s %-4.4s %-9.9s %s",
+	                 pidstr, ptruser, rss, shared, cpu_str, prcs_str, uptime_str, ptrcmd) == -1)
+		errExit("asprintf");
+	return rv;
+}
+
+// JSON record for a sandbox; itv in milliseconds
+static void top_json(unsigned index, const char *cmd, const char *user,
+	unsigned rss_pages, unsigned shared_pages, float cpu, int cnt, unsigned itv) {
+	if (pgsz == 0)
+		pgsz = getpagesize();
+
+	printf("{\"type\":\"top\",\"time\":%llu,\"interval\":%u,", json_time(), itv);
+	json_sandbox(index, user, cmd);
+	printf(",\"rss\":%u,\"shared\":%u,\"cpu\":%.1f,\"processes\":%d,\"uptime\":%llu",
+		rss_pages * pgsz / 1024, shared_pages * pgsz / 1024, cpu, cnt, firemon_uptime(index));
+
+	// network traffic since the last reading, only for sandboxes with a network namespace
+	if (has_netns(index)) {
+		get_stats(index);
+		Process *p = pid_find(index);
+		printf(",\"rx\":%u,\"tx\":%u", p->rx_delta, p->tx_delta);
+	}
+	printf("}\n");
+}
+
 // recursivity!!!
 static char *print_top(unsigned index, unsigned parent, unsigned *utime, unsigned *stime, unsigned itv, float *cpu, int *cnt) {
 	char *rv = NULL;
@@ -70,7 +171,9 @@ static char *print_top(unsigned index, unsigned parent, unsigned *utime, unsigne
 	if (stat(procdir, &s) == -1)
 		return NULL;
 
-	if (pids[index].level == 1) {
+	Process *p = pid_find(index);
+	assert(p);
+	if (p->level == 1) {
 		pgs_rss = 0;
 		pgs_shared = 0;
 		*utime = 0;
@@ -87,86 +190,32 @@ static char *print_top(unsigned index, unsigned parent, unsigned *utime, unsigne
 	*stime += stmp;
 
 
-	int i;
-	for (i = index + 1; i < max_pids; i++) {
-		if (pids[i].parent == (pid_t)index)
-			print_top(i, index, utime, stime, itv, cpu, cnt);
-	}
-
-	if (!firejail_exec) {
-		if (asprintf(&firejail_exec, "%s/bin/firejail", PREFIX) == -1)
-			errExit("asprintf");
-		firejail_exec_len = strlen(firejail_exec);
-		firejail_exec_prefix_len = strlen(PREFIX) + 5;
+	Process *child;
+	for (child = p->next; child; child = child->next) {
+		if (child->parent == (pid_t)index)
+			print_top(child->pid, index, utime, stime, itv, cpu, cnt);
 	}
 
-	if (pids[index].level == 1) {
-		// pid
-		char pidstr[10];
-		snprintf(pidstr, 10, "%u", index);
-
+	if (p->level == 1) {
 		// command
 		char *cmd = pid_proc_cmdline(index);
-		char *ptrcmd;
-		if (cmd == NULL) {
-			if (pids[index].zombie)
-				ptrcmd = "(zombie)";
-			else
-				ptrcmd = "";
-		}
-		else if (strncmp(cmd, firejail_exec, firejail_exec_len) == 0)
-			ptrcmd = cmd + firejail_exec_prefix_len;
-		else
-			ptrcmd = cmd;
 
 		// user
-		char *user = get_user_name(pids[index].uid);
-		char *ptruser;
-		if (user)
-			ptruser = user;
-		else
-			ptruser = "";
-
-		// memory
-		if (pgsz == 0)
-			pgsz = getpagesize();
-		char rss[10];
-		snprintf(rss, 10, "%u", pgs_rss * pgsz / 1024);
-		char shared[10];
-		snprintf(shared, 10, "%u", pgs_shared * pgsz / 1024);
-
-		// uptime
-		unsigned long long uptime = pid_get_start_time(index);
+		char *user = get_user_name(p->uid);
+
+		// cpu, itv in milliseconds
 		if (clocktick == 0)
 			clocktick = sysconf(_SC_CLK_TCK);
-		uptime /= clocktick;
-		uptime = sysuptime - uptime;
-		unsigned sec = uptime % 60;
-		uptime -= sec;
-		uptime /= 60;
-		unsigned min = uptime % 60;
-		uptime -= min;
-		uptime /= 60;
-		unsigned hour = uptime;
-		char uptime_str[50];
-		snprintf(uptime_str, 50, "%02u:%02u:%02u", hour, min, sec);
-
-		// cpu
-		itv *= clocktick;
-		float ud = (float) (*utime - pids[index].utime) / itv * 100;
-		float sd = (float) (*stime - pids[index].stime) / itv * 100;
+		float ticks = (float) itv * clocktick / 1000;
+		float ud = (float) (*utime - p->utime) / ticks * 100;
+		float sd = (float) (*stime - p->stime) / ticks * 100;
 		float cd = ud + sd;
 		*cpu = cd;
-		char cpu_str[10];
-		snprintf(cpu_str, 10, "%2.1f", cd);
 
-		// process count
-		char prcs_str[10];
-		snprintf(prcs_str, 10, "%d", *cnt);
-
-		if (asprintf(&rv, "%-5.5s %-9.9s %-8.8s %-8.8s %-5.5s %-4.4s %-9.9s %s",
-		                 pidstr, ptruser, rss, shared, cpu_str, prcs_str, uptime_str, ptrcmd) == -1)
-			errExit("asprintf");
+		if (arg_json)
+			top_json(index, cmd, user, pgs_rss, pgs_shared, cd, *cnt, itv);
+		else
+			rv = top_line(index, p->zombie, cmd, user, pgs_rss, pgs_shared, cd, *cnt);
 
 		if (cmd)
 			free(cmd);
@@ -259,73 +308,344 @@ void head_print(int col, int row) {
 	}
 }
 
+// grab screen size and print the header; return the number of rows and columns available
+static void print_header(int *row, int *col) {
+	struct winsize sz;
+	*row = 24;
+	*col = 80;
+	if (!ioctl(STDIN_FILENO, TIOCGWINSZ, &sz)) {
+		if (sz.ws_col > 0 && sz.ws_row > 0) {
+			*col = sz.ws_col;
+			*row = sz.ws_row;
+		}
+	}
+
+	// start printing
+	firemon_clrscr();
+	char *header = get_header();
+	if (strlen(header) > (size_t)*col)
+		header[*col] = '\0';
+	printf("%s\n", header);
+	if (*row > 0)
+		(*row)--;
+	free(header);
+
+	// find system uptime
+	FILE *fp = fopen("/proc/uptime", "r");
+	if (fp) {
+		float f;
+		int rv = fscanf(fp, "%f", &f);
+		(void) rv;
+		sysuptime = (unsigned long long) f;
+		fclose(fp);
+	}
+}
+
+//**************************
+// incremental mode
+//**************************
+// The process table is built once. It is kept up to date using the fork and exit
+// events from the kernel proc connector, and the sandboxes registered in
+// /run/firejail/sandbox directory. On every refresh only the counters of the
+// processes already in the table are read. The proc connector is available
+// only for root user.
+
+// RUN_FIREJAIL_SANDBOX_DIR borrowed from src/firejail/firejail.h
+#define RUN_FIREJAIL_SANDBOX_DIR	"/run/firejail/sandbox"
+
+static unsigned long long now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// the processes found by scanning /proc have a CPU time history,
+// take the first reading now
+static void sample_new(void) {
+	Process *p;
+	for (p = pid_first(); p; p = p->next) {
+		if (!p->sampled) {
+			p->utime = 0;
+			p->stime = 0;
+			pid_get_cpu_time(p->pid, &p->utime, &p->stime);
+			p->sampled = 1;
+		}
+	}
+}
+
+static void rescan(void) {
+	pid_read(0);
+	sample_new();
+}
+
+static Process *find_sandbox(Process *p) {
+	while (p && p->level > 1) {
+		Process *parent = pid_find(p->parent);
+		if (parent && parent->level >= p->level)
+			return NULL;	// pid reused
+		p = parent;
+	}
+	return p;
+}
+
+static void event_fork(pid_t parent_pid, pid_t pid) {
+	Process *parent = pid_find(parent_pid);
+	if (!parent)
+		return;
+
+	// a new process starts with no CPU time used, the first reading is done on refresh
+	pid_remove(pid);
+	Process *p = pid_add(pid);
+	p->level = parent->level + 1;
+	p->parent = parent_pid;
+	p->uid = parent->uid;
+}
+
+static void event_exit(pid_t pid) {
+	Process *p = pid_find(pid);
+	if (!p)
+		return;
+
+	// the children are moved one level up, they stay in the same sandbox
+	if (p->level > 1) {
+		Process *ptr;
+		for (ptr = pid_first(); ptr; ptr = ptr->next) {
+			if (ptr->parent == pid)
+				ptr->parent = p->parent;
+		}
+	}
+	pid_remove(pid);
+}
+
+// return -1 if events were lost
+static int read_proc_events(int sock) {
+	char __attribute__ ((aligned(NLMSG_ALIGNTO))) buf[8192];
+
+	while (1) {
+		ssize_t len = recv(sock, buf, sizeof(buf), MSG_DONTWAIT);
+		if (len == -1) {
+			if (errno == EAGAIN || errno == EINTR)
+				return 0;
+			if (errno == ENOBUFS)
+				return -1;
+			errExit("recv");
+		}
+		if (len == 0)
+			return 0;
+
+		struct nlmsghdr *nlmsghdr;
+		for (nlmsghdr = (struct nlmsghdr *) buf;
+		     NLMSG_OK(nlmsghdr, (unsigned) len);
+		     nlmsghdr = NLMSG_NEXT(nlmsghdr, len)) {
+			if (nlmsghdr->nlmsg_type == NLMSG_ERROR ||
+			    nlmsghdr->nlmsg_type == NLMSG_NOOP)
+				continue;
+
+			struct cn_msg *cn_msg = NLMSG_DATA(nlmsghdr);
+			if (cn_msg->id.idx != CN_IDX_PROC ||
+			    cn_msg->id.val != CN_VAL_PROC)
+				continue;
+
+			struct proc_event *ev = (struct proc_event *) cn_msg->data;
+			if (ev->what == PROC_EVENT_FORK) {
+				if (ev->event_data.fork.child_pid == ev->event_data.fork.child_tgid) // not a thread
+					event_fork(ev->event_data.fork.parent_tgid, ev->event_data.fork.child_tgid);
+			}
+			else if (ev->what == PROC_EVENT_EXIT) {
+				if (ev->event_data.exit.process_pid == ev->event_data.exit.process_tgid) // not a thread
+					event_exit(ev->event_data.exit.process_tgid);
+			}
+		}
+	}
+}
+
+// return -1 if events were lost
+static int read_sandbox_events(int fd) {
+	char __attribute__ ((aligned(__alignof__(struct inotify_event)))) buf[4096];
+
+	ssize_t len;
+	while ((len = read(fd, buf, sizeof(buf))) > 0) {
+		char *ptr = buf;
+		while (ptr < buf + len) {
+			struct inotify_event *ev = (struct inotify_event *) ptr;
+			if (ev->mask & IN_Q_OVERFLOW)
+				return -1;
+			if (ev->len) {
+				char *end;
+				pid_t pid = strtol(ev->name, &end, 10);
+				if (end != ev->name && *end == '\0' && pid != skip_process)
+					pid_add_sandbox(pid);
+			}
+			ptr += sizeof(struct inotify_event) + ev->len;
+		}
+	}
+	sample_new();
+	return 0;
+}
+
+static void refresh(unsigned long long itv) {
+	head_clear();
+	if (clocktick == 0)
+		clocktick = sysconf(_SC_CLK_TCK);
+
+	Process *p;
+	for (p = pid_first(); p; p = p->next) {
+		if (p->level == 1) {
+			p->cnt = 0;
+			p->rss = 0;
+			p->shared = 0;
+			p->cpu = 0;
+		}
+	}
+
+	// read the counters and add them to the sandbox totals
+	for (p = pid_first(); p; p = p->next) {
+		Process *sandbox = find_sandbox(p);
+		if (!sandbox)
+			continue;
+
+		unsigned utime = 0;
+		unsigned stime = 0;
+		pid_get_cpu_time(p->pid, &utime, &stime);
+		if (utime + stime >= p->utime + p->stime)	// 0 if the process is gone
+			sandbox->cpu += (utime + stime) - (p->utime + p->stime);
+		p->utime = utime;
+		p->stime = stime;
+		p->sampled = 1;
+
+		pid_getmem(p->pid, &sandbox->rss, &sandbox->shared);
+		sandbox->cnt++;
+	}
+
+	int row = 0;
+	int col = 0;
+	if (!arg_json)
+		print_header(&row, &col);
+
+	for (p = pid_first(); p; p = p->next) {
+		if (p->level != 1 || p->pid == skip_process)
+			continue;
+
+		if (!p->cmd)
+			p->cmd = pid_proc_cmdline(p->pid);
+		if (!p->user)
+			p->user = get_user_name(p->uid);
+		float cpu = (float) p->cpu * 1000 / (itv * clocktick) * 100;
+		if (arg_json)
+			top_json(p->pid, p->cmd, p->user, p->rss, p->shared, cpu, p->cnt, itv);
+		else
+			head_add(cpu, top_line(p->pid, p->zombie, p->cmd, p->user, p->rss, p->shared, cpu, p->cnt));
+	}
+	if (arg_json)
+		fflush(0);
+	else
+		head_print(col, row);
+#ifdef HAVE_GCOV
+	__gcov_flush();
+#endif
+}
+
+// return -1 if the incremental mode is not available
+static int top_incremental(void) {
+	if (getuid() != 0)
+		return -1;
+
+	// the sources of events are set before reading the process table
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd == -1)
+		return -1;
+	if (inotify_add_watch(fd, RUN_FIREJAIL_SANDBOX_DIR, IN_CREATE | IN_MOVED_TO) == -1) {
+		close(fd);
+		return -1;
+	}
+	int sock = procevent_netlink_open();
+	if (sock == -1) {
+		close(fd);
+		return -1;
+	}
+	rescan();
+
+	unsigned long long last = now_ms();
+	unsigned long long next = last + arg_interval;
+	while (1) {
+		unsigned long long current = now_ms();
+		if (current >= next) {
+			refresh(current - last);
+			last = current;
+			next += arg_interval;
+			if (next <= current)	// we are late
+				next = current + arg_interval;
+			continue;
+		}
+
+		struct pollfd fds[2];
+		fds[0].fd = sock;
+		fds[0].events = POLLIN;
+		fds[1].fd = fd;
+		fds[1].events = POLLIN;
+		if (firemon_wait(fds, 2, next - current) == 0)
+			continue;
+
+		int lost = 0;
+		if (fds[0].revents && read_proc_events(sock) == -1)
+			lost = 1;
+		if (fds[1].revents && read_sandbox_events(fd) == -1)
+			lost = 1;
+		if (lost)
+			rescan();
+	}
+
+	return 0;
+}
+
 void top(void) {
+	top_incremental();	// it doesn't return unless the incremental mode is not available
+
 	while (1) {
 		// clear linked list
 		head_clear();
 
 		// set pid table
-		int i;
-		int itv = 1; // 1 second  interval
+		Process *p;
 		pid_read(0);
 
 		// start cpu measurements
 		unsigned utime = 0;
 		unsigned stime = 0;
-		for (i = 0; i < max_pids; i++) {
-			if (i == skip_process)
+		for (p = pid_first(); p; p = p->next) {
+			if (p->pid == skip_process)
 				continue;
-			if (pids[i].level == 1)
-				pid_store_cpu(i, 0, &utime, &stime);
-		}
-
-		// wait 1 second
-		firemon_sleep(itv);
-
-		// grab screen size
-		struct winsize sz;
-		int row = 24;
-		int col = 80;
-		if (!ioctl(STDIN_FILENO, TIOCGWINSZ, &sz)) {
-			if (sz.ws_col > 0 && sz.ws_row > 0) {
-				col = sz.ws_col;
-				row = sz.ws_row;
+			if (p->level == 1) {
+				pid_store_cpu(p->pid, 0, &utime, &stime);
+				if (arg_json && has_netns(p->pid))
+					get_stats(p->pid);
 			}
 		}
 
-		// start printing
-		firemon_clrscr();
-		char *header = get_header();
-		if (strlen(header) > (size_t)col)
-			header[col] = '\0';
-		printf("%s\n", header);
-		if (row > 0)
-			row--;
-		free(header);
-
-		// find system uptime
-		FILE *fp = fopen("/proc/uptime", "r");
-		if (fp) {
-			float f;
-			int rv = fscanf(fp, "%f", &f);
-			(void) rv;
-			sysuptime = (unsigned long long) f;
-			fclose(fp);
-		}
+		// wait for the refresh interval
+		firemon_wait(NULL, 0, arg_interval);
+
+		int row = 0;
+		int col = 0;
+		if (!arg_json)
+			print_header(&row, &col);
 
 		// print processes
-		for (i = 0; i < max_pids; i++) {
-			if (i == skip_process)
+		for (p = pid_first(); p; p = p->next) {
+			if (p->pid == skip_process)
 				continue;
-			if (pids[i].level == 1) {
+			if (p->level == 1) {
 				float cpu = 0;
 				int cnt = 0; // process count
-				char *line = print_top(i, 0, &utime, &stime, itv, &cpu, &cnt);
+				char *line = print_top(p->pid, 0, &utime, &stime, arg_interval, &cpu, &cnt);
 				if (line)
 					head_add(cpu, line);
 			}
 		}
-		head_print(col, row);
+		if (arg_json)
+			fflush(0);
+		else
+			head_print(col, row);
 #ifdef HAVE_GCOV
 			__gcov_flush();
 #endif
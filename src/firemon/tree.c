@@ -19,15 +19,45 @@
 */
 #include "firemon.h"
 
+// one record for each process, the processes are sorted by pid
+static void tree_json(void) {
+	Process *p;
+	for (p = pid_first(); p; p = p->next) {
+		// find the sandbox
+		Process *sandbox = p;
+		while (sandbox && sandbox->level > 1)
+			sandbox = pid_find(sandbox->parent);
+		if (!sandbox || sandbox->pid == skip_process)
+			continue;
+
+		char *user = pid_get_user_name(p->uid);
+		char *cmd = pid_proc_cmdline(p->pid);
+		printf("{\"type\":\"process\",\"pid\":%d,\"ppid\":%d,\"sandbox\":%d,\"level\":%d,\"zombie\":%s,\"user\":",
+			p->pid, p->parent, sandbox->pid, p->level, (p->zombie)? "true": "false");
+		json_string(user);
+		printf(",\"cmd\":");
+		json_string(cmd);
+		printf("}\n");
+		free(user);
+		free(cmd);
+	}
+	fflush(0);
+}
+
 void tree(pid_t pid) {
 	pid_read(pid);
+	if (arg_json) {
+		tree_json();
+		return;
+	}
 
 	// print processes
-	int i;
-	for (i = 0; i < max_pids; i++) {
+	Process *p;
+	for (p = pid_first(); p; p = p->next) {
+		pid_t i = p->pid;
 		if (i == skip_process)
 			continue;
-		if (pids[i].level == 1)
+		if (p->level == 1)
 			pid_print_tree(i, 0, arg_nowrap);
 	}
 	printf("\n");
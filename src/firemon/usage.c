@@ -33,6 +33,10 @@ static char *help_str =
 	"\t--cpu - print CPU affinity for each sandbox.\n\n"
 	"\t--help, -? - this help screen.\n\n"
 	"\t--interface - print network interface information for each sandbox.\n\n"
+	"\t--format=json - print one JSON record per line for --top, --netstats,\n"
+	"\t\t--list, --tree and process events.\n\n"
+	"\t--interval=milliseconds - refresh interval for --top and --netstats,\n"
+	"\t\tdefault 1000, minimum 100.\n\n"
 	"\t--list - list all sandboxes.\n\n"
 	"\t--name=name - print information only about named sandbox.\n\n"
 	"\t--netstats - monitor network statistics for sandboxes creating a new\n"
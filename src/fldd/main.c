@@ -30,43 +30,94 @@
 #include <dirent.h>
 
 
+#define MAXBUF 4096
 static int arg_quiet = 0;
 static void copy_libs_for_lib(const char *lib);
 
+// hashed storage; the list keeps the elements in reverse insertion order
+#define STORAGE_HSIZE 1024
 typedef struct storage_t {
-	struct storage_t *next;
+	struct storage_t *next;		// list
+	struct storage_t *hnext;	// hash bucket
 	const char *name;
+	const char *value;		// optional value associated with the name
+	LddRecord *rec;			// index record
 } Storage;
-static Storage *libs = NULL;
-static Storage *lib_paths = NULL;
 
-// return 1 if found
-static int storage_find(Storage *ptr, const char *name) {
+typedef struct storage_table_t {
+	Storage *head;
+	Storage *bucket[STORAGE_HSIZE];
+} StorageTable;
+
+static StorageTable libs;	// the dependency closure printed at the end
+static StorageTable lib_paths;	// library search paths for the current target
+static char *rpath_key = NULL;	// DT_RPATH/DT_RUNPATH entries in lib_paths, "" if none
+static StorageTable parsed;	// ELF files already processed for the current target
+static StorageTable resolved;	// rpath_key + DT_NEEDED name -> full path of the library
+static StorageTable ldd_index;	// path -> dependency record, from the index or parsed in this run
+static FILE *index_update = NULL;	// new index records are written here
+
+static unsigned storage_hash(const char *name) {
+	unsigned hash = 5381;
+	while (*name)
+		hash = ((hash << 5) + hash) ^ (unsigned char) *name++;
+	return hash % STORAGE_HSIZE;
+}
+
+// return the element, or NULL if not found
+static Storage *storage_find(StorageTable *t, const char *name) {
+	Storage *ptr = t->bucket[storage_hash(name)];
 	while (ptr) {
 		if (strcmp(ptr->name, name) == 0)
-			return 1;
-		ptr = ptr->next;
+			return ptr;
+		ptr = ptr->hnext;
 	}
 
-	return 0;
+	return NULL;
 }
 
-static void storage_add(Storage **head, const char *name) {
-	if (storage_find(*head, name))
-		return;
+// return 1 if a new element was added
+static int storage_add(StorageTable *t, const char *name, const char *value) {
+	if (storage_find(t, name))
+		return 0;
 
 	Storage *s = malloc(sizeof(Storage));
 	if (!s)
 		errExit("malloc");
-	s->next = *head;
-	*head = s;
+	s->next = t->head;
+	t->head = s;
+	unsigned h = storage_hash(name);
+	s->hnext = t->bucket[h];
+	t->bucket[h] = s;
 	s->name = strdup(name);
 	if (!s->name)
 		errExit("strdup");
+	s->value = NULL;
+	s->rec = NULL;
+	if (value) {
+		s->value = strdup(value);
+		if (!s->value)
+			errExit("strdup");
+	}
+	return 1;
 }
 
 
-static void storage_print(Storage *ptr, int fd) {
+// remove all the elements; the index records are not released
+static void storage_clear(StorageTable *t) {
+	Storage *ptr = t->head;
+	while (ptr) {
+		Storage *next = ptr->next;
+		free((char *) ptr->name);
+		free((char *) ptr->value);
+		free(ptr);
+		ptr = next;
+	}
+	memset(t, 0, sizeof(StorageTable));
+}
+
+static void storage_print(StorageTable *t, int fd) {
+	Storage *ptr = t->head;
 	while (ptr) {
 		dprintf(fd, "%s\n", ptr->name);
 		ptr = ptr->next;
@@ -82,22 +133,29 @@ static bool ptr_ok(const void *ptr, const void *base, const void *end, const cha
 }
 
 
-static void parse_elf(const char *exe) {
+// extract the dependencies of an ELF file; return NULL if the file cannot be opened
+// *complete is set if the file was parsed without errors
+static LddRecord *parse_elf_file(const char *exe, int *complete) {
+	*complete = 0;
 	int f;
 	f = open(exe, O_RDONLY);
 	if (f < 0) {
 		if (!arg_quiet)
 			fprintf(stderr, "Warning fldd: cannot open %s, skipping...\n", exe);
-		return;
+		return NULL;
 	}
 
 	struct stat s;
 	char *base = NULL, *end;
+	LddRecord *rec = NULL;
 	if (fstat(f, &s) == -1)
 		goto error_close;
+	rec = ldd_record_new(exe, &s);
 	base = mmap(0, s.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, f, 0);
-	if (base == MAP_FAILED)
+	if (base == MAP_FAILED) {
+		base = NULL;
 		goto error_close;
+	}
 
 	end = base + s.st_size;
 
@@ -107,12 +165,7 @@ static void parse_elf(const char *exe) {
 			fprintf(stderr, "Warning fldd: %s is not an ELF executable or library\n", exe);
 		goto close;
 	}
-//unsigned char elfclass = ebuf->e_ident[EI_CLASS];
-//if (elfclass == ELFCLASS32)
-//printf("%s 32bit\n", exe);
-//else if (elfclass == ELFCLASS64)
-//printf("%s 64bit\n", exe);
-
+	rec->lib64 = (ebuf->e_ident[EI_CLASS] == ELFCLASS64);
 
 	Elf_Phdr *pbuf = (Elf_Phdr *)(base + sizeof(*ebuf));
 	while (ebuf->e_phnum-- > 0 && ptr_ok(pbuf, base, end, "pbuf")) {
@@ -122,7 +175,7 @@ static void parse_elf(const char *exe) {
 			if (!ptr_ok(base + pbuf->p_offset, base, end, "base + pbuf->p_offset"))
 				goto close;
 
-			storage_add(&libs, base + pbuf->p_offset);
+			ldd_record_add(&rec->interp, base + pbuf->p_offset);
 			break;
 		}
 		pbuf++;
@@ -170,7 +223,7 @@ static void parse_elf(const char *exe) {
 					const char *searchpath = strbase + dbuf->d_un.d_ptr;
 					if (!ptr_ok(searchpath, base, end, "searchpath"))
 						goto close;
-					storage_add(&lib_paths, searchpath);
+					ldd_record_add(&rec->rpath, searchpath);
 				}
 				size -= sizeof(*dbuf);
 				dbuf++;
@@ -183,7 +236,7 @@ static void parse_elf(const char *exe) {
 					const char *lib = strbase + dbuf->d_un.d_ptr;
 					if (!ptr_ok(lib, base, end, "lib"))
 						goto close;
-					copy_libs_for_lib(lib);
+					ldd_record_add(&rec->needed, lib);
 				}
 				size -= sizeof(*dbuf);
 				dbuf++;
@@ -191,6 +244,7 @@ static void parse_elf(const char *exe) {
 		}
 		sbuf++;
 	}
+	*complete = 1;
 	goto close;
 
  error_close:
@@ -200,35 +254,145 @@ static void parse_elf(const char *exe) {
 		munmap(base, s.st_size);
 
 	close(f);
+	return rec;
+}
+
+// return 1 if the record can be stored in the index file
+static int index_record_ok(const LddRecord *rec) {
+	if (strchr(rec->path, '\n'))
+		return 0;
+	LddList *lists[3] = { rec->interp, rec->rpath, rec->needed };
+	int i;
+	for (i = 0; i < 3; i++) {
+		LddList *ptr;
+		for (ptr = lists[i]; ptr; ptr = ptr->next)
+			if (strchr(ptr->name, '\n'))
+				return 0;
+	}
+	return 1;
+}
+
+// return the index record for this file, or NULL if the file is not indexed or it was modified
+static LddRecord *index_find(const char *exe, const struct stat *s) {
+	Storage *ptr = storage_find(&ldd_index, exe);
+	if (ptr && ldd_record_match(ptr->rec, s))
+		return ptr->rec;
+	return NULL;
+}
+
+// return 1 if this is a 64 bit program/library; use the index if possible
+static int lib_64(const char *exe) {
+	struct stat s;
+	if (ldd_index.head && stat(exe, &s) == 0) {
+		LddRecord *rec = index_find(exe, &s);
+		if (rec)
+			return rec->lib64;
+	}
+	return is_lib_64(exe);
+}
+
+// add a DT_RPATH/DT_RUNPATH entry in front of the search paths
+static void lib_paths_add(const char *path) {
+	if (!storage_add(&lib_paths, path, NULL))
+		return;
+	char *key;
+	if (asprintf(&key, "%s:%s", path, rpath_key) == -1)
+		errExit("asprintf");
+	free(rpath_key);
+	rpath_key = key;
+}
+
+static void parse_elf(const char *exe) {
+	// each file is processed only once for a target
+	if (!storage_add(&parsed, exe, NULL))
+		return;
+
+	// look for an up to date record in the index, or parsed for a previous target
+	struct stat s;
+	int stat_ok = (stat(exe, &s) == 0);
+	LddRecord *rec = (stat_ok)? index_find(exe, &s): NULL;
+	if (!rec) {
+		int complete = 1;
+		rec = parse_elf_file(exe, &complete);
+		if (!rec)
+			return;
+
+		// save the new records for files owned by root
+		if (complete && index_update && stat_ok && s.st_uid == 0 &&
+		    ldd_record_match(rec, &s) && index_record_ok(rec))
+			ldd_index_write(index_update, rec);
+
+		// keep the record for the next targets
+		Storage *ptr = storage_find(&ldd_index, exe);
+		if (!ptr) {
+			storage_add(&ldd_index, exe, NULL);
+			ptr = storage_find(&ldd_index, exe);
+			assert(ptr);
+		}
+		else
+			ldd_record_free(ptr->rec);
+		ptr->rec = rec;
+	}
+
+	// process the dependencies
+	LddList *ptr;
+	for (ptr = rec->interp; ptr; ptr = ptr->next)
+		storage_add(&libs, ptr->name, NULL);
+	for (ptr = rec->rpath; ptr; ptr = ptr->next)
+		lib_paths_add(ptr->name);
+	for (ptr = rec->needed; ptr; ptr = ptr->next)
+		copy_libs_for_lib(ptr->name);
 }
 
 static void copy_libs_for_lib(const char *lib) {
+	// the result depends on the search paths, the cache is keyed on the
+	// DT_RPATH/DT_RUNPATH entries collected so far for the current target
+	char *key;
+	if (asprintf(&key, "%s\n%s", rpath_key, lib) == -1)
+		errExit("asprintf");
+	Storage *r = storage_find(&resolved, key);
+	if (r) {
+		free(key);
+		storage_add(&libs, r->value, NULL);
+		parse_elf(r->value);
+		return;
+	}
+
 	Storage *lib_path;
-	for (lib_path = lib_paths; lib_path; lib_path = lib_path->next) {
+	for (lib_path = lib_paths.head; lib_path; lib_path = lib_path->next) {
 		char *fname;
 		if (asprintf(&fname, "%s/%s", lib_path->name, lib) == -1)
 			errExit("asprintf");
-		if (access(fname, R_OK) == 0 && is_lib_64(fname)) {
-			if (!storage_find(libs, fname)) {
-				storage_add(&libs, fname);
-				// libs may need other libs
-				parse_elf(fname);
-			}
+		if (access(fname, R_OK) == 0 && lib_64(fname)) {
+			storage_add(&resolved, key, fname);
+			free(key);
+			storage_add(&libs, fname, NULL);
+			// libs may need other libs
+			parse_elf(fname);
 			free(fname);
 			return;
 		}
 		free(fname);
 	}
+	free(key);
 
 	// log a  warning and continue
 	if (!arg_quiet)
 		fprintf(stderr, "Warning fldd: cannot find %s, skipping...\n", lib);
 }
 
+// each target starts with the default search paths, as if it was processed by a separate fldd run
 static void lib_paths_init(void) {
+	storage_clear(&lib_paths);
+	storage_clear(&parsed);
+	free(rpath_key);
+	rpath_key = strdup("");
+	if (!rpath_key)
+		errExit("strdup");
+
 	int i;
 	for (i = 0; default_lib_paths[i]; i++)
-		storage_add(&lib_paths, default_lib_paths[i]);
+		storage_add(&lib_paths, default_lib_paths[i], NULL);
 }
 
 
@@ -251,7 +415,7 @@ static void walk_directory(const char *dirname) {
 
 			// check regular so library
 			char *ptr = strstr(entry->d_name, ".so");
-			if (ptr && is_lib_64(path)) {
+			if (ptr && lib_64(path)) {
 				if (*(ptr + 3) == '\0' || *(ptr + 3) == '.') {
 					parse_elf(path);
 					free(path);
@@ -274,10 +438,75 @@ static void walk_directory(const char *dirname) {
 
 
 
+// process a program, a library, or a directory of libraries
+static void process_target(const char *target) {
+	lib_paths_init();
+	struct stat s;
+	if (stat(target, &s) == -1) {
+		if (!arg_quiet)
+			fprintf(stderr, "Warning fldd: cannot access %s, skipping...\n", target);
+		return;
+	}
+	if (S_ISDIR(s.st_mode))
+		walk_directory(target);
+	else {
+		if (lib_64(target))
+			parse_elf(target);
+		else
+			fprintf(stderr, "Warning fldd: %s is not a 64bit program/library\n", target);
+	}
+}
+
+// read the list of targets from stdin, one target per line
+static void process_batch(void) {
+	char buf[MAXBUF];
+	while (fgets(buf, MAXBUF, stdin)) {
+		// remove \n
+		char *ptr = strchr(buf, '\n');
+		if (ptr)
+			*ptr = '\0';
+		if (*buf == '\0')
+			continue;
+		process_target(buf);
+	}
+}
+
+// load the dependency index
+static void index_load(const char *fname) {
+	FILE *fp = fopen(fname, "r");
+	if (!fp)
+		return;	// the index is created on the first run
+
+	LddRecord *rec = ldd_index_read(fp);
+	fclose(fp);
+	while (rec) {
+		LddRecord *next = rec->next;
+		rec->next = NULL;
+		// the last record for a file wins
+		Storage *ptr = storage_find(&ldd_index, rec->path);
+		if (ptr) {
+			ldd_record_free(ptr->rec);
+			ptr->rec = rec;
+		}
+		else {
+			storage_add(&ldd_index, rec->path, NULL);
+			ptr = storage_find(&ldd_index, rec->path);
+			assert(ptr);
+			ptr->rec = rec;
+		}
+		rec = next;
+	}
+}
+
 static void usage(void) {
-	printf("Usage: fldd program_or_directory [file]\n");
+	printf("Usage: fldd [--index=file] [--index-update=file] program_or_directory [file]\n");
+	printf("       fldd [--index=file] [--index-update=file] --batch [file]\n");
 	printf("Print a list of libraries used by program or store it in the file.\n");
 	printf("Print a list of libraries used by all .so files in a directory or store it in the file.\n");
+	printf("In batch mode the programs and directories are read from stdin, one per line,\n");
+	printf("and the libraries used by all of them are printed only once.\n");
+	printf("--index reads the dependencies of unmodified files from a dependency index,\n");
+	printf("and --index-update stores the dependencies of the newly parsed files.\n");
 }
 
 int main(int argc, char **argv) {
@@ -302,12 +531,6 @@ printf("\n");
 		return 0;
 	}
 
-	// check program access
-	if (access(argv[1], R_OK)) {
-		fprintf(stderr, "Error fldd: cannot access %s\n", argv[1]);
-		exit(1);
-	}
-
 	char *quiet = getenv("FIREJAIL_QUIET");
 	if (quiet && strcmp(quiet, "yes") == 0)
 		arg_quiet = 1;
@@ -317,11 +540,39 @@ printf("\n");
 		return 0;
 	}
 
+	// index options
+	const char *index_fname = NULL;
+	const char *index_update_fname = NULL;
+	int i;
+	for (i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--index=", 8) == 0)
+			index_fname = argv[i] + 8;
+		else if (strncmp(argv[i], "--index-update=", 15) == 0)
+			index_update_fname = argv[i] + 15;
+		else
+			break;
+	}
+	if (i == argc || argc - i > 2) {
+		fprintf(stderr, "Error fldd: invalid arguments\n");
+		usage();
+		exit(1);
+	}
+
+	const char *target = argv[i];
+	const char *outfile = (argc - i == 2)? argv[i + 1]: NULL;
+	int arg_batch = (strcmp(target, "--batch") == 0);
+
+	// check program access
+	if (!arg_batch && access(target, R_OK)) {
+		fprintf(stderr, "Error fldd: cannot access %s\n", target);
+		exit(1);
+	}
+
 	int fd = STDOUT_FILENO;
 	// attempt to open the file
-	if (argc == 3) {
-		fd = open(argv[2], O_CREAT | O_TRUNC | O_WRONLY, 0644);
-		if (!fd) {
+	if (outfile) {
+		fd = open(outfile, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+		if (fd == -1) {
 			fprintf(stderr, "Error fldd: invalid arguments\n");
 			usage();
 			exit(1);
@@ -329,25 +580,29 @@ printf("\n");
 	}
 
 	// initialize local storage
-	lib_paths_init();
+	if (index_fname)
+		index_load(index_fname);
+	if (index_update_fname) {
+		index_update = fopen(index_update_fname, "w");
+		if (!index_update && !arg_quiet)
+			fprintf(stderr, "Warning fldd: cannot open %s, the index is not updated\n", index_update_fname);
+	}
 
 	// process files
-	struct stat s;
-	if (stat(argv[1], &s) == -1)
-		errExit("stat");
-	if (S_ISDIR(s.st_mode))
-		walk_directory(argv[1]);
+	if (arg_batch)
+		process_batch();
 	else {
-		if (is_lib_64(argv[1]))
-			parse_elf(argv[1]);
-		else
-			fprintf(stderr, "Warning fldd: %s is not a 64bit program/library\n", argv[1]);
+		struct stat s;
+		if (stat(target, &s) == -1)
+			errExit("stat");
+		process_target(target);
 	}
 
-
 	// print libraries and exit
-	storage_print(libs, fd);
-	if (argc == 3)
+	storage_print(&libs, fd);
+	if (outfile)
 		close(fd);
+	if (index_update)
+		fclose(index_update);
 	return 0;
 }
@@ -38,6 +38,16 @@ static inline int is_blacklist(struct sock_filter *bpf) {
 	return 0;
 }
 
+// filters generated by fseccomp as decision trees are already optimized
+static int is_tree(struct sock_filter *filter, int entries) {
+	int i;
+	for (i = 0; i < entries; i++, filter++) {
+		if (filter->code == BPF_JMP + BPF_JGT + BPF_K)
+			return 1;
+	}
+	return 0;
+}
+
 static int count_blacklists(struct sock_filter *filter, int entries) {
 	int cnt = 0;
 	int i;
@@ -112,6 +122,9 @@ int optimize(struct sock_filter *filter, int entries) {
 	assert(filter);
 	assert(entries);
 
+	if (is_tree(filter, entries))
+		return entries;
+
 	//**********************************
 	// optimize blacklist statements
 	//**********************************
@@ -20,6 +20,7 @@
 #include "fseccomp.h"
 #include "../include/seccomp.h"
 #include <sys/syscall.h>
+#include <stdint.h>
 
 void write_to_file(int fd, const void *data, int size) {
 	assert(data);
@@ -36,6 +37,159 @@ void write_to_file(int fd, const void *data, int size) {
 	}
 }
 
+//***************************************************
+// filter rules
+//***************************************************
+// The syscall rules are collected between filter_init() and filter_end_blacklist()/
+// filter_end_whitelist(), and the filter is generated as a balanced decision tree:
+// the syscall numbers are sorted, contiguous numbers with the same action are merged
+// in ranges, and the ranges are split in half using jgt instructions until no more
+// than LEAF_RANGES ranges are left, which are tested linearly. A syscall
+// goes through about 2*log2(n) instructions instead of 2*n in a jeq chain.
+//
+// A filter tree without any jgt instruction has at most LEAF_RANGES jeq/ret
+// pairs; fsec-optimize doesn't modify these filters (LIMIT_BLACKLISTS), and it
+// leaves alone any filter with jgt instructions.
+#define LEAF_RANGES 4
+#define MAX_JUMP 255	// conditional jumps are limited to 8 bits
+
+typedef struct filter_rule_t {
+	uint32_t first;	// first syscall number in the range
+	uint32_t last;	// last syscall number in the range
+	uint32_t action;
+} FilterRule;
+
+static FilterRule *rules = NULL;
+static int rules_cnt = 0;
+static int rules_max = 0;
+
+typedef struct bpf_buf_t {
+	struct sock_filter *data;
+	int len;
+	int max;
+} BpfBuf;
+
+static void rule_add(int syscall, uint32_t action) {
+	// the first rule for a syscall wins, same as in a jeq chain
+	int i;
+	for (i = 0; i < rules_cnt; i++) {
+		if (rules[i].first == (uint32_t) syscall)
+			return;
+	}
+
+	if (rules_cnt == rules_max) {
+		rules_max = (rules_max)? rules_max * 2: 256;
+		rules = realloc(rules, rules_max * sizeof(FilterRule));
+		if (!rules)
+			errExit("realloc");
+	}
+	rules[rules_cnt].first = syscall;
+	rules[rules_cnt].last = syscall;
+	rules[rules_cnt].action = action;
+	rules_cnt++;
+}
+
+static int rule_cmp(const void *p1, const void *p2) {
+	const FilterRule *r1 = p1;
+	const FilterRule *r2 = p2;
+	if (r1->first < r2->first)
+		return -1;
+	return (r1->first > r2->first);
+}
+
+// sort the rules and merge contiguous syscall numbers; return the number of ranges
+static int rules_merge(void) {
+	if (rules_cnt == 0)
+		return 0;
+	qsort(rules, rules_cnt, sizeof(FilterRule), rule_cmp);
+
+	int i;
+	int j = 0;
+	for (i = 1; i < rules_cnt; i++) {
+		if (rules[i].first == rules[j].last + 1 && rules[i].action == rules[j].action)
+			rules[j].last = rules[i].last;
+		else
+			rules[++j] = rules[i];
+	}
+	return j + 1;
+}
+
+static void buf_add(BpfBuf *buf, const struct sock_filter *filter, int cnt) {
+	if (buf->len + cnt > buf->max) {
+		buf->max = (buf->len + cnt) * 2;
+		buf->data = realloc(buf->data, buf->max * sizeof(struct sock_filter));
+		if (!buf->data)
+			errExit("realloc");
+	}
+	memcpy(buf->data + buf->len, filter, cnt * sizeof(struct sock_filter));
+	buf->len += cnt;
+}
+
+static void build_tree(BpfBuf *buf, const FilterRule *r, int cnt, uint32_t dflt) {
+	if (cnt <= LEAF_RANGES) {
+		int i;
+		for (i = 0; i < cnt; i++) {
+			if (r[i].first == r[i].last) {
+				struct sock_filter filter[] = {
+					BPF_JUMP(BPF_JMP+BPF_JEQ+BPF_K, r[i].first, 0, 1),
+					BPF_STMT(BPF_RET+BPF_K, r[i].action)
+				};
+				buf_add(buf, filter, 2);
+			}
+			else {
+				struct sock_filter filter[] = {
+					BPF_JUMP(BPF_JMP+BPF_JGE+BPF_K, r[i].first, 0, 2),
+					BPF_JUMP(BPF_JMP+BPF_JGT+BPF_K, r[i].last, 1, 0),
+					BPF_STMT(BPF_RET+BPF_K, r[i].action)
+				};
+				buf_add(buf, filter, 3);
+			}
+		}
+		struct sock_filter filter[] = {
+			BPF_STMT(BPF_RET+BPF_K, dflt)
+		};
+		buf_add(buf, filter, 1);
+		return;
+	}
+
+	// syscall numbers greater than the last number in the left half jump to the right half
+	int mid = cnt / 2;
+	BpfBuf left;
+	memset(&left, 0, sizeof(left));
+	build_tree(&left, r, mid, dflt);
+
+	if (left.len <= MAX_JUMP) {
+		struct sock_filter filter[] = {
+			BPF_JUMP(BPF_JMP+BPF_JGT+BPF_K, r[mid - 1].last, left.len, 0)
+		};
+		buf_add(buf, filter, 1);
+	}
+	else {
+		struct sock_filter filter[] = {
+			BPF_JUMP(BPF_JMP+BPF_JGT+BPF_K, r[mid - 1].last, 0, 1),
+			BPF_JUMP(BPF_JMP+BPF_JA+BPF_K, left.len, 0, 0)
+		};
+		buf_add(buf, filter, 2);
+	}
+	buf_add(buf, left.data, left.len);
+	free(left.data);
+	build_tree(buf, r + mid, cnt - mid, dflt);
+}
+
+static void filter_end(int fd, uint32_t dflt) {
+	int cnt = rules_merge();
+	BpfBuf buf;
+	memset(&buf, 0, sizeof(buf));
+	build_tree(&buf, rules, cnt, dflt);
+	write_to_file(fd, buf.data, buf.len * sizeof(struct sock_filter));
+	free(buf.data);
+
+	free(rules);
+	rules = NULL;
+	rules_cnt = 0;
+	rules_max = 0;
+}
+
 void filter_init(int fd) {
 	struct sock_filter filter[] = {
 		VALIDATE_ARCHITECTURE,
@@ -58,46 +212,33 @@ void filter_init(int fd) {
 #endif
 
 	write_to_file(fd, filter, sizeof(filter));
+	rules_cnt = 0;
 }
 
 void filter_add_whitelist(int fd, int syscall, int arg, void *ptrarg) {
+	(void) fd;
 	(void) arg;
 	(void) ptrarg;
-
-	struct sock_filter filter[] = {
-		WHITELIST(syscall)
-	};
-	write_to_file(fd, filter, sizeof(filter));
+	rule_add(syscall, SECCOMP_RET_ALLOW);
 }
 
 void filter_add_blacklist(int fd, int syscall, int arg, void *ptrarg) {
+	(void) fd;
 	(void) arg;
 	(void) ptrarg;
-
-	struct sock_filter filter[] = {
-		BLACKLIST(syscall)
-	};
-	write_to_file(fd, filter, sizeof(filter));
+	rule_add(syscall, SECCOMP_RET_KILL);
 }
 
 void filter_add_errno(int fd, int syscall, int arg, void *ptrarg) {
+	(void) fd;
 	(void) ptrarg;
-	struct sock_filter filter[] = {
-		BLACKLIST_ERRNO(syscall, arg)
-	};
-	write_to_file(fd, filter, sizeof(filter));
+	rule_add(syscall, SECCOMP_RET_ERRNO | arg);
 }
 
 void filter_end_blacklist(int fd) {
-	struct sock_filter filter[] = {
-		RETURN_ALLOW
-	};
-	write_to_file(fd, filter, sizeof(filter));
+	filter_end(fd, SECCOMP_RET_ALLOW);
 }
 
 void filter_end_whitelist(int fd) {
-	struct sock_filter filter[] = {
-		KILL_PROCESS
-	};
-	write_to_file(fd, filter, sizeof(filter));
+	filter_end(fd, SECCOMP_RET_KILL);
 }
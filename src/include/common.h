@@ -132,4 +132,13 @@ char *pid_proc_comm(const pid_t pid);
 char *pid_proc_cmdline(const pid_t pid);
 int pid_proc_cmdline_x11_xpra_xephyr(const pid_t pid);
 int pid_hidepid(void);
+int pid_fd_open(pid_t pid);
+char *profile_lookup(const char *name, const char *dir);
+
+// file copy statistics
+typedef struct copy_stats_t {
+	unsigned long long bytes;	// bytes copied
+	unsigned long long syscalls;	// system calls issued
+} CopyStats;
+int copy_fd(int src, int dst, CopyStats *stats);
 #endif
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2014-2018 Firejail Authors
+ *
+ * This file is part of firejail project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef FSLOGGER_H
+#define FSLOGGER_H
+#include <stdint.h>
+
+// Filesystem log index
+//
+// Built by firejail next to the text log in /run/firejail/mnt/fslogger. It contains
+// the blacklisted paths sorted by hash, and it is mapped directly in memory by
+// libtracelog. All the offsets are relative to the start of the string table.
+//	header | entries | string table
+#define RUN_FSLOGGER_INDEX_FILE	"/run/firejail/mnt/fslogger.idx"
+#define FSLOGGER_INDEX_MAGIC 0x464c4931	// "FLI1"
+#define FSLOGGER_INDEX_NONE 0xffffffff	// missing string
+
+typedef struct fslogger_index_t {
+	uint32_t magic;
+	uint32_t count;		// number of entries
+	uint32_t pid;		// sandbox pid string
+	uint32_t name;		// sandbox name string
+	uint32_t strsize;	// size of the string table
+} FsloggerIndex;
+
+typedef struct fslogger_entry_t {
+	uint32_t hash;
+	uint32_t str;		// blacklisted path
+} FsloggerEntry;
+
+// djb2
+static inline uint32_t fslogger_hash(const char *str) {
+	uint32_t hash = 5381;
+	int c;
+
+	while ((c = *str++) != '\0')
+		hash = ((hash << 5) + hash) + c; // hash * 33 + c
+
+	return hash;
+}
+
+#endif
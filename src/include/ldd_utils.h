@@ -23,6 +23,7 @@
 
 #include "../include/common.h"
 #include <elf.h>
+#include <sys/stat.h>
 
 #ifdef __LP64__
 #define Elf_Ehdr Elf64_Ehdr
@@ -41,6 +42,41 @@ extern const char * const default_lib_paths[];
 // return 1 if this is a 64 bit program/library
 int is_lib_64(const char *exe);
 
+// ELF dependency index, a text file with one record for each program or library:
+//	file <dev> <ino> <mtime sec> <mtime nsec> <size> <64bit flag> <path>
+//	interp <PT_INTERP program interpreter>
+//	rpath <DT_RPATH or DT_RUNPATH entry>
+//	needed <DT_NEEDED entry>
+//	end
+// the lists are stored in the order they are found in the ELF file
+typedef struct ldd_list_t {
+	struct ldd_list_t *next;
+	char *name;
+} LddList;
+
+typedef struct ldd_record_t {
+	struct ldd_record_t *next;
+	char *path;
+	unsigned long long dev;
+	unsigned long long ino;
+	long long mtime;
+	long mtime_nsec;
+	long long size;
+	int lib64;
+	LddList *interp;
+	LddList *rpath;
+	LddList *needed;
+} LddRecord;
+
+LddRecord *ldd_record_new(const char *path, const struct stat *s);
+void ldd_record_add(LddList **list, const char *name);
+void ldd_record_free(LddRecord *rec);
+// return 1 if the record describes the file with this stat information
+int ldd_record_match(const LddRecord *rec, const struct stat *s);
+// read all the records in the file; the records are returned in file order
+LddRecord *ldd_index_read(FILE *fp);
+void ldd_index_write(FILE *fp, const LddRecord *rec);
+
 
 
 #endif
\ No newline at end of file
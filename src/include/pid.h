@@ -19,15 +19,16 @@
 */
 #ifndef PID_H
 #define PID_H
-extern int max_pids;
-
-
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <sys/types.h>
 #include <unistd.h>
-typedef struct {
-	short level;  // -1 not a firejail process, 0 not investigated yet, 1 firejail process, > 1 firejail child
+typedef struct process_t {
+	struct process_t *next;		// list sorted by pid
+	struct process_t *prev;
+	struct process_t *hnext;	// hash table chain
+	pid_t pid;
+	short level;  // 1 firejail process, > 1 firejail child
 	unsigned char zombie;
 	pid_t parent;
 	uid_t uid;
@@ -39,9 +40,21 @@ typedef struct {
 	unsigned long long tx;	// networking tx, bytes
 	unsigned rx_delta;
 	unsigned tx_delta;
+	// firemon --top incremental mode: utime and stime above hold the last reading
+	// for this process, the totals are stored in the sandbox entry
+	unsigned char sampled;
+	unsigned cnt;
+	unsigned rss;
+	unsigned shared;
+	unsigned cpu;	// clock ticks since the last refresh
 } Process;
-//extern Process pids[max_pids];
-extern Process *pids;
+
+// process table
+Process *pid_first(void);
+Process *pid_find(pid_t pid);
+Process *pid_add(pid_t pid);
+void pid_remove(pid_t pid);
+void pid_clear(void);
 
 // pid functions
 void pid_getmem(unsigned pid, unsigned *rss, unsigned *shared);
@@ -49,10 +62,12 @@ void pid_get_cpu_time(unsigned pid, unsigned *utime, unsigned *stime);
 unsigned long long pid_get_start_time(unsigned pid);
 uid_t pid_get_uid(pid_t pid);
 char *pid_get_user_name(uid_t uid);
+char *pid_get_sandbox_name(pid_t pid);
 // print functions
 void pid_print_tree(unsigned index, unsigned parent, int nowrap);
 void pid_print_list(unsigned index, int nowrap);
 void pid_store_cpu(unsigned index, unsigned parent, unsigned *utime, unsigned *stime);
 void pid_read(pid_t mon_pid);
+Process *pid_add_sandbox(pid_t pid);
 
 #endif
@@ -22,6 +22,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/sendfile.h>
 #include <fcntl.h>
 #include <sys/syscall.h>
 #include <errno.h>
@@ -283,6 +284,17 @@ int pid_hidepid(void) {
 	return 0;
 }
 
+// return a file descriptor referring to the process, -1 if the process is gone (ESRCH)
+// or pidfds are not supported by the kernel (ENOSYS)
+int pid_fd_open(pid_t pid) {
+#ifdef SYS_pidfd_open
+	return syscall(SYS_pidfd_open, pid, 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
 //**************************
 // time trace based on getticks function
 //**************************
@@ -321,3 +333,148 @@ float timetrace_end(void) {
 
 	return (float) delta / (float) tt_1ms;
 }
+
+//**************************
+// file copy engine
+//**************************
+#define COPY_CHUNK (1024 * 1024 * 1024)	// max bytes requested in a single copy_file_range/sendfile call
+#define COPY_BUFLEN (128 * 1024)	// buffer size for the read/write fallback
+#define COPY_ALIGN 4096
+
+// in-kernel copy using copy_file_range; return 0 if done, 1 if not supported, -1 if error
+static int copy_fd_range(int src, int dst, off_t size, CopyStats *stats) {
+#ifdef __NR_copy_file_range
+	off_t done = 0;
+	while (1) {
+		ssize_t rv = syscall(__NR_copy_file_range, src, NULL, dst, NULL, COPY_CHUNK, 0);
+		stats->syscalls++;
+		if (rv == -1) {
+			// not supported by the kernel or across these filesystems
+			if (done == 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL ||
+			    errno == EOPNOTSUPP || errno == EBADF || errno == EPERM))
+				return 1;
+			return -1;
+		}
+		if (rv == 0) {
+			// some filesystems report a size but return no data
+			if (done == 0 && size > 0)
+				return 1;
+			return 0;
+		}
+		done += rv;
+		stats->bytes += rv;
+	}
+#else
+	(void) src;
+	(void) dst;
+	(void) size;
+	(void) stats;
+	return 1;
+#endif
+}
+
+// in-kernel copy using sendfile; return 0 if done, 1 if not supported, -1 if error
+static int copy_fd_sendfile(int src, int dst, off_t size, CopyStats *stats) {
+	off_t done = 0;
+	while (1) {
+		ssize_t rv = sendfile(dst, src, NULL, COPY_CHUNK);
+		stats->syscalls++;
+		if (rv == -1) {
+			if (done == 0 && (errno == ENOSYS || errno == EINVAL))
+				return 1;
+			return -1;
+		}
+		if (rv == 0) {
+			if (done == 0 && size > 0)
+				return 1;
+			return 0;
+		}
+		done += rv;
+		stats->bytes += rv;
+	}
+}
+
+// read/write loop using a large aligned buffer; return 0 if done, -1 if error
+static int copy_fd_rw(int src, int dst, CopyStats *stats) {
+	void *buf;
+	if (posix_memalign(&buf, COPY_ALIGN, COPY_BUFLEN))
+		errExit("posix_memalign");
+
+	int rv = 0;
+	ssize_t len;
+	while (1) {
+		len = read(src, buf, COPY_BUFLEN);
+		stats->syscalls++;
+		if (len == 0)
+			break;
+		if (len == -1) {
+			if (errno == EINTR)
+				continue;
+			rv = -1;
+			break;
+		}
+
+		ssize_t done = 0;
+		while (done != len) {
+			ssize_t wlen = write(dst, (char *) buf + done, len - done);
+			stats->syscalls++;
+			if (wlen == -1) {
+				if (errno == EINTR)
+					continue;
+				rv = -1;
+				goto out;
+			}
+			done += wlen;
+		}
+		stats->bytes += len;
+	}
+
+out:
+	free(buf);
+	return rv;
+}
+
+// copy the content of src file descriptor into dst file descriptor starting
+// at the current file offsets; return -1 if error, 0 if no error
+// the number of bytes copied and system calls issued are added to stats if not NULL
+int copy_fd(int src, int dst, CopyStats *stats) {
+	assert(src >= 0);
+	assert(dst >= 0);
+	CopyStats dummy;
+	if (!stats) {
+		memset(&dummy, 0, sizeof(dummy));
+		stats = &dummy;
+	}
+
+	// the in-kernel paths are used only for regular files
+	struct stat s;
+	int rv = 1;
+	if (fstat(src, &s) == 0 && S_ISREG(s.st_mode) && s.st_size > 0) {
+		rv = copy_fd_range(src, dst, s.st_size, stats);
+		if (rv == 1)
+			rv = copy_fd_sendfile(src, dst, s.st_size, stats);
+	}
+	stats->syscalls++;	// fstat
+
+	if (rv == 1)
+		rv = copy_fd_rw(src, dst, stats);
+	return rv;
+}
+
+// find name.profile in dir directory using a single lookup on the computed file name
+// return the full path of the profile file (allocated memory), or NULL if the profile was not found
+char *profile_lookup(const char *name, const char *dir) {
+	if (!name || !dir || *name == '\0' || strchr(name, '/'))
+		return NULL;
+
+	char *fname;
+	if (asprintf(&fname, "%s/%s.profile", dir, name) == -1)
+		errExit("asprintf");
+
+	struct stat s;
+	if (stat(fname, &s) == -1 || !S_ISREG(s.st_mode)) {
+		free(fname);
+		return NULL;
+	}
+	return fname;
+}
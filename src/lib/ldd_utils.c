@@ -60,3 +60,154 @@ doexit:
 	close(fd);
 	return retval;
 }
+
+//***************************************************************
+// ELF dependency index
+//***************************************************************
+#define MAXBUF 4096
+
+LddRecord *ldd_record_new(const char *path, const struct stat *s) {
+	assert(path);
+	assert(s);
+
+	LddRecord *rec = malloc(sizeof(LddRecord));
+	if (!rec)
+		errExit("malloc");
+	memset(rec, 0, sizeof(LddRecord));
+	rec->path = strdup(path);
+	if (!rec->path)
+		errExit("strdup");
+	rec->dev = s->st_dev;
+	rec->ino = s->st_ino;
+	rec->mtime = s->st_mtim.tv_sec;
+	rec->mtime_nsec = s->st_mtim.tv_nsec;
+	rec->size = s->st_size;
+	return rec;
+}
+
+// add name at the end of the list
+void ldd_record_add(LddList **list, const char *name) {
+	assert(list);
+	assert(name);
+
+	LddList *elem = malloc(sizeof(LddList));
+	if (!elem)
+		errExit("malloc");
+	elem->next = NULL;
+	elem->name = strdup(name);
+	if (!elem->name)
+		errExit("strdup");
+
+	while (*list)
+		list = &(*list)->next;
+	*list = elem;
+}
+
+static void list_free(LddList *list) {
+	while (list) {
+		LddList *next = list->next;
+		free(list->name);
+		free(list);
+		list = next;
+	}
+}
+
+void ldd_record_free(LddRecord *rec) {
+	if (!rec)
+		return;
+	free(rec->path);
+	list_free(rec->interp);
+	list_free(rec->rpath);
+	list_free(rec->needed);
+	free(rec);
+}
+
+int ldd_record_match(const LddRecord *rec, const struct stat *s) {
+	assert(rec);
+	assert(s);
+	return rec->dev == (unsigned long long) s->st_dev &&
+		rec->ino == (unsigned long long) s->st_ino &&
+		rec->mtime == (long long) s->st_mtim.tv_sec &&
+		rec->mtime_nsec == (long) s->st_mtim.tv_nsec &&
+		rec->size == (long long) s->st_size;
+}
+
+LddRecord *ldd_index_read(FILE *fp) {
+	assert(fp);
+	LddRecord *first = NULL;
+	LddRecord **last = &first;
+	LddRecord *rec = NULL;
+
+	char buf[MAXBUF];
+	while (fgets(buf, MAXBUF, fp)) {
+		char *ptr = strchr(buf, '\n');
+		if (!ptr)
+			goto errout;	// line too long or truncated file
+		*ptr = '\0';
+
+		if (strncmp(buf, "file ", 5) == 0) {
+			if (rec)
+				goto errout;
+			struct stat s;
+			memset(&s, 0, sizeof(s));
+			unsigned long long dev, ino;
+			long long mtime, size;
+			long nsec;
+			int lib64;
+			int len = 0;
+			if (sscanf(buf + 5, "%llu %llu %lld %ld %lld %d %n", &dev, &ino, &mtime, &nsec, &size, &lib64, &len) != 6 ||
+			    len == 0 || buf[5 + len] != '/')
+				goto errout;
+			rec = ldd_record_new(buf + 5 + len, &s);
+			rec->dev = dev;
+			rec->ino = ino;
+			rec->mtime = mtime;
+			rec->mtime_nsec = nsec;
+			rec->size = size;
+			rec->lib64 = lib64;
+		}
+		else if (rec && strncmp(buf, "interp ", 7) == 0)
+			ldd_record_add(&rec->interp, buf + 7);
+		else if (rec && strncmp(buf, "rpath ", 6) == 0)
+			ldd_record_add(&rec->rpath, buf + 6);
+		else if (rec && strncmp(buf, "needed ", 7) == 0)
+			ldd_record_add(&rec->needed, buf + 7);
+		else if (rec && strcmp(buf, "end") == 0) {
+			*last = rec;
+			last = &rec->next;
+			rec = NULL;
+		}
+		else
+			goto errout;
+	}
+
+	// an incomplete record at the end of the file is dropped
+	ldd_record_free(rec);
+	return first;
+
+errout:
+	// a damaged index is ignored
+	ldd_record_free(rec);
+	while (first) {
+		LddRecord *next = first->next;
+		ldd_record_free(first);
+		first = next;
+	}
+	return NULL;
+}
+
+void ldd_index_write(FILE *fp, const LddRecord *rec) {
+	assert(fp);
+	assert(rec);
+
+	fprintf(fp, "file %llu %llu %lld %ld %lld %d %s\n",
+		rec->dev, rec->ino, rec->mtime, rec->mtime_nsec, rec->size, rec->lib64, rec->path);
+	LddList *ptr;
+	for (ptr = rec->interp; ptr; ptr = ptr->next)
+		fprintf(fp, "interp %s\n", ptr->name);
+	for (ptr = rec->rpath; ptr; ptr = ptr->next)
+		fprintf(fp, "rpath %s\n", ptr->name);
+	for (ptr = rec->needed; ptr; ptr = ptr->next)
+		fprintf(fp, "needed %s\n", ptr->name);
+	fprintf(fp, "end\n");
+}
@@ -27,9 +27,132 @@
 #include <dirent.h>
 
 #define PIDS_BUFLEN 4096
-//Process pids[max_pids];
-Process *pids = NULL;
-int max_pids=32769;
+
+//**************************
+// process table
+//**************************
+// Only the sandboxes and their processes are stored. The entries are kept in
+// a hash table indexed by pid, and in a list sorted by pid for printing.
+static Process **pid_hash = NULL;
+static unsigned pid_hash_size = 0;	// power of 2
+static unsigned pid_cnt = 0;
+static Process *pid_head = NULL;
+static Process *pid_tail = NULL;
+
+static inline unsigned pid_bucket(pid_t pid) {
+	return ((unsigned) pid * 2654435761U) & (pid_hash_size - 1);
+}
+
+static void pid_hash_grow(void) {
+	unsigned size = (pid_hash_size)? pid_hash_size * 2: 64;
+	Process **hash = calloc(size, sizeof(Process *));
+	if (!hash)
+		errExit("calloc");
+	free(pid_hash);
+	pid_hash = hash;
+	pid_hash_size = size;
+
+	Process *p;
+	for (p = pid_head; p; p = p->next) {
+		unsigned h = pid_bucket(p->pid);
+		p->hnext = pid_hash[h];
+		pid_hash[h] = p;
+	}
+}
+
+// first process in the table, the list is sorted by pid
+Process *pid_first(void) {
+	return pid_head;
+}
+
+// return NULL if the process is not in the table
+Process *pid_find(pid_t pid) {
+	if (!pid_hash)
+		return NULL;
+	Process *p = pid_hash[pid_bucket(pid)];
+	while (p && p->pid != pid)
+		p = p->hnext;
+	return p;
+}
+
+// add a process to the table; if the process is already there, the existing entry is returned
+Process *pid_add(pid_t pid) {
+	Process *p = pid_find(pid);
+	if (p)
+		return p;
+
+	p = calloc(1, sizeof(Process));
+	if (!p)
+		errExit("calloc");
+	p->pid = pid;
+
+	// sorted list; the processes are usually added in increasing pid order
+	Process *prev = pid_tail;
+	while (prev && prev->pid > pid)
+		prev = prev->prev;
+	p->prev = prev;
+	p->next = (prev)? prev->next: pid_head;
+	if (p->next)
+		p->next->prev = p;
+	else
+		pid_tail = p;
+	if (prev)
+		prev->next = p;
+	else
+		pid_head = p;
+
+	if (++pid_cnt > pid_hash_size)
+		pid_hash_grow();
+	else {
+		unsigned h = pid_bucket(pid);
+		p->hnext = pid_hash[h];
+		pid_hash[h] = p;
+	}
+	return p;
+}
+
+static void pid_free(Process *p) {
+	free(p->user);
+	free(p->cmd);
+	free(p);
+}
+
+void pid_remove(pid_t pid) {
+	Process *p = pid_find(pid);
+	if (!p)
+		return;
+
+	Process **pp = &pid_hash[pid_bucket(pid)];
+	while (*pp != p)
+		pp = &(*pp)->hnext;
+	*pp = p->hnext;
+
+	if (p->prev)
+		p->prev->next = p->next;
+	else
+		pid_head = p->next;
+	if (p->next)
+		p->next->prev = p->prev;
+	else
+		pid_tail = p->prev;
+
+	pid_cnt--;
+	pid_free(p);
+}
+
+void pid_clear(void) {
+	Process *p = pid_head;
+	while (p) {
+		Process *next = p->next;
+		pid_free(p);
+		p = next;
+	}
+	pid_head = NULL;
+	pid_tail = NULL;
+	pid_cnt = 0;
+	if (pid_hash)
+		memset(pid_hash, 0, pid_hash_size * sizeof(Process *));
+}
 
 // get the memory associated with this pid
 void pid_getmem(unsigned pid, unsigned *rss, unsigned *shared) {
@@ -166,11 +289,40 @@ doexit:
 	return rv;
 }
 
-// todo: RUN_FIREJAIL_NAME_DIR is borrowed from src/firejail/firejail.h
-// move it in a common place
+// todo: RUN_FIREJAIL_NAME_DIR and RUN_FIREJAIL_SANDBOX_DIR are borrowed from src/firejail/firejail.h
+// move them in a common place
 #define RUN_FIREJAIL_NAME_DIR	"/run/firejail/name"
+#define RUN_FIREJAIL_SANDBOX_DIR	"/run/firejail/sandbox"
+
+// return a malloc copy of the sandbox name, NULL if the sandbox has no name
+char *pid_get_sandbox_name(pid_t pid) {
+	char *fname;
+	if (asprintf(&fname, "%s/%d", RUN_FIREJAIL_NAME_DIR, pid) == -1)
+		errExit("asprintf");
+	FILE *fp = fopen(fname, "re");
+	free(fname);
+	if (!fp)
+		return NULL;
+
+	char *rv = NULL;
+	size_t n = 0;
+	if (getline(&rv, &n, fp) == -1) {
+		free(rv);
+		rv = NULL;
+	}
+	else {
+		char *ptr = strchr(rv, '\n');
+		if (ptr)
+			*ptr = '\0';
+	}
+	fclose(fp);
+	return rv;
+}
 
 static void print_elem(unsigned index, int nowrap) {
+	Process *p = pid_find(index);
+	assert(p);
+
 	// get terminal size
 	struct winsize sz;
 	int col = 0;
@@ -180,42 +332,19 @@ static void print_elem(unsigned index, int nowrap) {
 	}
 
 	// indent
-	char indent[(pids[index].level - 1) * 2 + 1];
+	char indent[(p->level - 1) * 2 + 1];
 	memset(indent, ' ', sizeof(indent));
-	indent[(pids[index].level - 1) * 2] = '\0';
+	indent[(p->level - 1) * 2] = '\0';
 
 	// get data
-	uid_t uid = pids[index].uid;
+	uid_t uid = p->uid;
 	char *cmd = pid_proc_cmdline(index);
 	char *user = pid_get_user_name(uid);
 	char *user_allocated = user;
 
 	// extract sandbox name - pid == index
-	char *sandbox_name = "";
-	char *sandbox_name_allocated = NULL;
-	char *fname;
-	if (asprintf(&fname, "%s/%d", RUN_FIREJAIL_NAME_DIR, index) == -1)
-		errExit("asprintf");
-	struct stat s;
-	if (stat(fname, &s) == 0) {
-		FILE *fp = fopen(fname, "r");
-		if (fp) {
-			sandbox_name = malloc(s.st_size + 1);
-			if (!sandbox_name)
-				errExit("malloc");
-			sandbox_name_allocated = sandbox_name;
-			char *rv = fgets(sandbox_name, s.st_size + 1, fp);
-			if (!rv)
-				*sandbox_name = '\0';
-			else {
-				char *ptr = strchr(sandbox_name, '\n');
-				if (ptr)
-					*ptr = '\0';
-			}
-			fclose(fp);
-		}
-	}
-	free(fname);
+	char *sandbox_name_allocated = pid_get_sandbox_name(index);
+	char *sandbox_name = (sandbox_name_allocated)? sandbox_name_allocated: "";
 
 	if (user ==NULL)
 		user = "";
@@ -238,7 +367,7 @@ static void print_elem(unsigned index, int nowrap) {
 		free(cmd);
 	}
 	else {
-		if (pids[index].zombie)
+		if (p->zombie)
 			printf("%s%u: (zombie)\n", indent, index);
 		else
 			printf("%s%u:\n", indent, index);
@@ -256,15 +385,16 @@ void pid_print_tree(unsigned index, unsigned parent, int nowrap) {
 	// Remove unused parameter warning
 	(void)parent;
 
-	unsigned i;
-	for (i = index + 1; i < (unsigned)max_pids; i++) {
-		if (pids[i].parent == (pid_t)index)
-			pid_print_tree(i, index, nowrap);
+	// the children with a higher pid first, followed by the ones allocated after a pid wrap-around
+	Process *p;
+	for (p = pid_find(index)->next; p; p = p->next) {
+		if (p->parent == (pid_t)index)
+			pid_print_tree(p->pid, index, nowrap);
 	}
 
-	for (i = 0; i < index; i++) {
-		if (pids[i].parent == (pid_t)index)
-			pid_print_tree(i, index, nowrap);
+	for (p = pid_first(); p && p->pid < (pid_t)index; p = p->next) {
+		if (p->parent == (pid_t)index)
+			pid_print_tree(p->pid, index, nowrap);
 	}
 }
 
@@ -274,7 +404,9 @@ void pid_print_list(unsigned index, int nowrap) {
 
 // recursivity!!!
 void pid_store_cpu(unsigned index, unsigned parent, unsigned *utime, unsigned *stime) {
-	if (pids[index].level == 1) {
+	Process *p = pid_find(index);
+	assert(p);
+	if (p->level == 1) {
 		*utime = 0;
 		*stime = 0;
 	}
@@ -288,37 +420,106 @@ void pid_store_cpu(unsigned index, unsigned parent, unsigned *utime, unsigned *s
 	*utime += utmp;
 	*stime += stmp;
 
-	unsigned i;
-	for (i = index + 1; i < (unsigned)max_pids; i++) {
-		if (pids[i].parent == (pid_t)index)
-			pid_store_cpu(i, index, utime, stime);
+	Process *child;
+	for (child = p->next; child; child = child->next) {
+		if (child->parent == (pid_t)index)
+			pid_store_cpu(child->pid, index, utime, stime);
 	}
 
-	if (pids[index].level == 1) {
-		pids[index].utime = *utime;
-		pids[index].stime = *stime;
+	if (p->level == 1) {
+		p->utime = *utime;
+		p->stime = *stime;
 	}
 }
 
-// mon_pid: pid of sandbox to be monitored, 0 if all sandboxes are included
-void pid_read(pid_t mon_pid) {
-	if (pids == NULL) {
-		FILE *fp = fopen("/proc/sys/kernel/pid_max", "r");
-		if (fp) {
-			int val;
-			if (fscanf(fp, "%d", &val) == 1) {
-				if (val >= max_pids)
-					max_pids = val + 1;
-			}
-			fclose(fp);
+//**************************
+// process discovery
+//**************************
+typedef struct {
+	int firejail;	// the executable name is firejail
+	int zombie;
+	pid_t parent;
+	uid_t uid;
+} ProcStatus;
+
+// return -1 if the process is gone
+static int read_status(pid_t pid, ProcStatus *st) {
+	memset(st, 0, sizeof(ProcStatus));
+
+	char *file;
+	if (asprintf(&file, "/proc/%u/status", pid) == -1)
+		errExit("asprintf");
+	FILE *fp = fopen(file, "re");
+	free(file);
+	if (!fp)
+		return -1;
+
+	char buf[PIDS_BUFLEN];
+	while (fgets(buf, PIDS_BUFLEN - 1, fp)) {
+		char *ptr = strchr(buf, ':');
+		if (!ptr)
+			continue;
+		ptr++;
+		while (*ptr == ' ' || *ptr == '\t')
+			ptr++;
+
+		if (strncmp(buf, "Name:", 5) == 0)
+			st->firejail = (strncmp(ptr, "firejail", 8) == 0);
+		else if (strncmp(buf, "State:", 6) == 0)
+			st->zombie = (strstr(ptr, "(zombie)") != NULL);
+		else if (strncmp(buf, "PPid:", 5) == 0)
+			st->parent = atoi(ptr);
+		else if (strncmp(buf, "Uid:", 4) == 0) {
+			st->uid = atoi(ptr);
+			break;
 		}
-		pids = malloc(sizeof(Process) * max_pids);
-		if (pids == NULL)
-			errExit("malloc");
 	}
-	memset(pids, 0, sizeof(Process) * max_pids);
-	pid_t mypid = getpid();
+	fclose(fp);
+	return 0;
+}
+
+static Process *add_process(pid_t pid, const ProcStatus *st, int level) {
+	Process *p = pid_add(pid);
+	p->level = level;
+	p->zombie = st->zombie;
+	p->parent = st->parent;
+	p->uid = st->uid;
+	return p;
+}
+
+// a sandbox is a firejail process, excluding the X11 servers started by firejail --x11
+static void add_sandbox(pid_t pid) {
+	// skip PID 1 just in case we run a sandbox-in-sandbox
+	if (pid <= 1 || pid == getpid())
+		return;
+
+	ProcStatus st;
+	if (read_status(pid, &st) || !st.firejail)
+		return;
+	if (pid_proc_cmdline_x11_xpra_xephyr(pid))
+		return;
+	add_process(pid, &st, 1);
+}
+
+// sandboxes registered in /run/firejail/sandbox directory; return -1 if the directory is not available
+static int read_sandbox_dir(void) {
+	DIR *dir = opendir(RUN_FIREJAIL_SANDBOX_DIR);
+	if (!dir)
+		return -1;
+
+	struct dirent *entry;
+	char *end;
+	while ((entry = readdir(dir))) {
+		pid_t pid = strtol(entry->d_name, &end, 10);
+		if (end == entry->d_name || *end)
+			continue;
+		add_sandbox(pid);
+	}
+	closedir(dir);
+	return 0;
+}
 
+static DIR *open_proc(void) {
 	DIR *dir;
 	if (!(dir = opendir("/proc"))) {
 		// sleep 2 seconds and try again
@@ -328,98 +529,178 @@ void pid_read(pid_t mon_pid) {
 			exit(1);
 		}
 	}
+	return dir;
+}
 
-	pid_t child = -1;
+// sandboxes started by an older firejail version don't show up in /run/firejail/sandbox,
+// look for firejail processes in /proc
+static void read_sandbox_proc(void) {
+	DIR *dir = open_proc();
 	struct dirent *entry;
 	char *end;
-	while (child < 0 && (entry = readdir(dir))) {
+	while ((entry = readdir(dir))) {
 		pid_t pid = strtol(entry->d_name, &end, 10);
-		pid %= max_pids;
 		if (end == entry->d_name || *end)
 			continue;
-		if (pid == mypid)
-			continue;
+		add_sandbox(pid);
+	}
+	closedir(dir);
 
-		// skip PID 1 just in case we run a sandbox-in-sandbox
-		if (pid == 1)
+	// a firejail process started inside a sandbox is not a sandbox
+	Process *p = pid_first();
+	while (p) {
+		Process *next = p->next;
+		if (pid_find(p->parent))
+			pid_remove(p->pid);
+		p = next;
+	}
+}
+
+// /proc/<pid>/task/<tid>/children files are not available on kernels
+// built without CONFIG_PROC_CHILDREN
+static int children_supported(void) {
+	char *fname;
+	if (asprintf(&fname, "/proc/%d/task/%d/children", getpid(), getpid()) == -1)
+		errExit("asprintf");
+	int rv = (access(fname, R_OK) == 0);
+	free(fname);
+	return rv;
+}
+
+// add the descendants of a process
+static void add_children(Process *parent) {
+	char *dirname;
+	if (asprintf(&dirname, "/proc/%u/task", parent->pid) == -1)
+		errExit("asprintf");
+	DIR *dir = opendir(dirname);
+	if (!dir) {
+		free(dirname);
+		return;	// the process is gone
+	}
+
+	struct dirent *entry;
+	while ((entry = readdir(dir))) {
+		if (entry->d_name[0] == '.')
 			continue;
 
-		// open stat file
-		char *file;
-		if (asprintf(&file, "/proc/%u/status", pid) == -1)
+		char *fname;
+		if (asprintf(&fname, "%s/%s/children", dirname, entry->d_name) == -1)
 			errExit("asprintf");
+		FILE *fp = fopen(fname, "re");
+		free(fname);
+		if (!fp)
+			continue;	// the thread is gone
+
+		unsigned child;
+		while (fscanf(fp, "%u", &child) == 1) {
+			if (pid_find(child))
+				continue;
+			ProcStatus st;
+			if (read_status(child, &st))
+				continue;
+			add_children(add_process(child, &st, parent->level + 1));
+		}
+		fclose(fp);
+	}
+	closedir(dir);
+	free(dirname);
+}
 
-		FILE *fp = fopen(file, "r");
-		if (!fp) {
-			free(file);
+// walk /proc and add the descendants of the processes already in the table
+static void add_children_proc(void) {
+	typedef struct {
+		pid_t pid;
+		pid_t parent;
+	} Pair;
+	Pair *arr = NULL;
+	int cnt = 0;
+	int size = 0;
+
+	DIR *dir = open_proc();
+	struct dirent *entry;
+	char *end;
+	while ((entry = readdir(dir))) {
+		pid_t pid = strtol(entry->d_name, &end, 10);
+		if (end == entry->d_name || *end)
+			continue;
+		if (pid_find(pid))
+			continue;
+		ProcStatus st;
+		if (read_status(pid, &st))
 			continue;
+		if (cnt == size) {
+			size = (size)? size * 2: 256;
+			arr = realloc(arr, size * sizeof(Pair));
+			if (!arr)
+				errExit("realloc");
 		}
+		arr[cnt].pid = pid;
+		arr[cnt].parent = st.parent;
+		cnt++;
+	}
+	closedir(dir);
 
-		// look for firejail executable name
-		char buf[PIDS_BUFLEN];
-		while (fgets(buf, PIDS_BUFLEN - 1, fp)) {
-			if (strncmp(buf, "Name:", 5) == 0) {
-				char *ptr = buf + 5;
-				while (*ptr != '\0' && (*ptr == ' ' || *ptr == '\t')) {
-					ptr++;
-				}
-				if (*ptr == '\0') {
-					fprintf(stderr, "Error: cannot read /proc file\n");
-					exit(1);
-				}
-
-				if ((strncmp(ptr, "firejail", 8) == 0) && (mon_pid == 0 || mon_pid == pid)) {
-					if (pid_proc_cmdline_x11_xpra_xephyr(pid))
-						pids[pid].level = -1;
-					else
-						pids[pid].level = 1;
-				}
-				else
-					pids[pid].level = -1;
-			}
-			if (strncmp(buf, "State:", 6) == 0) {
-				if (strstr(buf, "(zombie)"))
-					pids[pid].zombie = 1;
-			}
-			else if (strncmp(buf, "PPid:", 5) == 0) {
-				char *ptr = buf + 5;
-				while (*ptr != '\0' && (*ptr == ' ' || *ptr == '\t')) {
-					ptr++;
-				}
-				if (*ptr == '\0') {
-					fprintf(stderr, "Error: cannot read /proc file\n");
-					exit(1);
-				}
-				unsigned parent = atoi(ptr);
-				parent %= max_pids;
-				if (pids[parent].level > 0) {
-					pids[pid].level = pids[parent].level + 1;
-				}
-				pids[pid].parent = parent;
-			}
-			else if (strncmp(buf, "Uid:", 4) == 0) {
-				char *ptr = buf + 5;
-				while (*ptr != '\0' && (*ptr == ' ' || *ptr == '\t')) {
-					ptr++;
-				}
-				if (*ptr == '\0') {
-					fprintf(stderr, "Error: cannot read /proc file\n");
-					exit(1);
+	// one pass for each level of the tree
+	int added = 1;
+	while (added) {
+		added = 0;
+		int i;
+		for (i = 0; i < cnt; i++) {
+			Process *parent;
+			if (arr[i].pid && (parent = pid_find(arr[i].parent)) != NULL) {
+				ProcStatus st;
+				if (read_status(arr[i].pid, &st) == 0) {
+					add_process(arr[i].pid, &st, parent->level + 1);
+					added = 1;
 				}
-				pids[pid].uid = atoi(ptr);
-				break;
+				arr[i].pid = 0;
 			}
 		}
-		fclose(fp);
-		free(file);
 	}
-	closedir(dir);
+	free(arr);
+}
 
-	pid_t pid;
-	for (pid = 0; pid < max_pids; pid++) {
-		int parent = pids[pid].parent;
-		if (pids[parent].level > 0) {
-			pids[pid].level = pids[parent].level + 1;
-		}
+// mon_pid: pid of sandbox to be monitored, 0 if all sandboxes are included
+//
+// The sandboxes are registered by firejail in /run/firejail/sandbox directory, their
+// processes are found using the children files in /proc. Only the processes
+// belonging to a sandbox are stored in the table.
+void pid_read(pid_t mon_pid) {
+	pid_clear();
+
+	if (mon_pid)
+		add_sandbox(mon_pid);
+	else if (read_sandbox_dir() == -1)
+		read_sandbox_proc();
+
+	if (!children_supported()) {
+		add_children_proc();
+		return;
 	}
+
+	// the children are inserted in the list as they are found, only the sandboxes are walked
+	Process *p = pid_first();
+	while (p) {
+		Process *next = p->next;
+		if (p->level == 1)
+			add_children(p);
+		p = next;
+	}
+}
+
+// add a new sandbox and its processes to the table; return NULL if pid is not a sandbox
+Process *pid_add_sandbox(pid_t pid) {
+	Process *p = pid_find(pid);
+	if (p)
+		return (p->level == 1)? p: NULL;
+
+	add_sandbox(pid);
+	p = pid_find(pid);
+	if (!p)
+		return NULL;
+	if (children_supported())
+		add_children(p);
+	else
+		add_children_proc();
+	return p;
 }
@@ -32,6 +32,8 @@
 #include <syslog.h>
 #include <dirent.h>
 #include <limits.h>
+#include <sys/mman.h>
+#include "../include/fslogger.h"
 
 //#define DEBUG
 
@@ -92,6 +94,35 @@ static void storage_add(const char *str) {
 	storage[h] = ptr;
 }
 
+// blacklist index mapped from RUN_FSLOGGER_INDEX_FILE
+static FsloggerEntry *index_entries = NULL;
+static uint32_t index_count = 0;
+static char *index_str = NULL;
+
+static char *index_find(const char *str) {
+	if (!index_entries)
+		return NULL;
+
+	// find the first entry with this hash
+	uint32_t h = fslogger_hash(str);
+	uint32_t first = 0;
+	uint32_t last = index_count;
+	while (first < last) {
+		uint32_t mid = first + (last - first) / 2;
+		if (index_entries[mid].hash < h)
+			first = mid + 1;
+		else
+			last = mid;
+	}
+
+	for (; first < index_count && index_entries[first].hash == h; first++) {
+		char *path = index_str + index_entries[first].str;
+		if (strcmp(str, path) == 0)
+			return path;
+	}
+	return NULL;
+}
+
 // global variable to keep current working directory
 static char* cwd = NULL;
 
@@ -134,6 +165,13 @@ static char *storage_find(const char *str) {
 		allocated = 1;
 	}
 
+	char *found = index_find(tofind);
+	if (found || index_entries) {
+		if (allocated)
+			free((char *) tofind);
+		return found;
+	}
+
 	uint32_t h = hash(tofind);
 	ListElem *ptr = storage[h];
 	while (ptr) {
@@ -165,10 +203,65 @@ static char *storage_find(const char *str) {
 static int blacklist_loaded = 0;
 static char *sandbox_pid_str = NULL;
 static char *sandbox_name_str = NULL;
+// map the blacklist index; return 1 if the index was loaded
+static int load_index(void) {
+	if (!orig_fopen)
+		orig_fopen = (orig_fopen_t)dlsym(RTLD_NEXT, "fopen");
+	FILE *fp = orig_fopen(RUN_FSLOGGER_INDEX_FILE, "re");
+	if (!fp)
+		return 0;
+
+	struct stat s;
+	char *base = MAP_FAILED;
+	if (fstat(fileno(fp), &s) == 0 && s.st_size >= (off_t) sizeof(FsloggerIndex))
+		base = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+	fclose(fp);
+	if (base == MAP_FAILED)
+		return 0;
+
+	// check the index
+	FsloggerIndex *hdr = (FsloggerIndex *) base;
+	uint64_t size = sizeof(FsloggerIndex) + (uint64_t) hdr->count * sizeof(FsloggerEntry) + hdr->strsize;
+	FsloggerEntry *entries = (FsloggerEntry *) (base + sizeof(FsloggerIndex));
+	char *str = (char *) (entries + hdr->count);
+	if (hdr->magic != FSLOGGER_INDEX_MAGIC || size != (uint64_t) s.st_size ||
+	    (hdr->strsize && str[hdr->strsize - 1] != '\0') ||
+	    (hdr->pid != FSLOGGER_INDEX_NONE && hdr->pid >= hdr->strsize) ||
+	    (hdr->name != FSLOGGER_INDEX_NONE && hdr->name >= hdr->strsize))
+		goto errout;
+	uint32_t i;
+	for (i = 0; i < hdr->count; i++) {
+		if (entries[i].str >= hdr->strsize)
+			goto errout;
+	}
+
+	if (hdr->pid != FSLOGGER_INDEX_NONE)
+		sandbox_pid_str = str + hdr->pid;
+	if (hdr->name != FSLOGGER_INDEX_NONE)
+		sandbox_name_str = str + hdr->name;
+	index_count = hdr->count;
+	index_str = str;
+	// an empty index is mapped as well, storage_find() uses only the index once it is loaded
+	index_entries = entries;
+#ifdef DEBUG
+	printf("Monitoring %u blacklists from the index\n", index_count);
+#endif
+	return 1;
+
+errout:
+	munmap(base, s.st_size);
+	return 0;
+}
+
 static void load_blacklist(void) {
 	if (blacklist_loaded)
 		return;
 
+	if (load_index()) {
+		blacklist_loaded = 1;
+		return;
+	}
+
 	// open filesystem log
 	if (!orig_fopen)
 		orig_fopen = (orig_fopen_t)dlsym(RTLD_NEXT, "fopen");
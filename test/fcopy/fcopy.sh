@@ -30,4 +30,7 @@ echo "TESTING: fcopy link (test/fcopy/linkcopy.exp)"
 echo "TESTING: fcopy trailing char (test/copy/trailing.exp)"
 ./trailing.exp
 
+echo "TESTING: fcopy batch (test/fcopy/batchcopy.exp)"
+./batchcopy.exp
+
 rm -fr dest/*
@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2014-2018 Firejail Authors
+ *
+ * This file is part of firejail project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+// Seccomp filter overhead benchmark
+//
+// Usage: seccomp-bench [-n iterations] [-r rounds] label=file[:file...] ...
+//
+// For each filter set, a child process installs the filters and measures the
+// latency of a few common syscalls. The first row is measured without any filter.
+// The number of BPF instructions walked for each syscall is computed by running
+// the filters in a small BPF interpreter.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+#include "../../src/include/seccomp.h"
+
+#define MAX_FILTERS 8
+#define BATCH 256	// openat and mmap are measured in batches, the cleanup is not timed
+
+typedef struct filter_set_t {
+	const char *label;
+	int cnt;
+	struct sock_fprog prog[MAX_FILTERS];
+} FilterSet;
+
+enum {
+	T_GETPID = 0,
+	T_READ,
+	T_WRITE,
+	T_OPENAT,
+	T_FUTEX,
+	T_MMAP,
+	T_MAX
+};
+
+static const char *test_name[T_MAX] = { "getpid", "read", "write", "openat", "futex", "mmap" };
+static int test_nr[T_MAX] = { SYS_getpid, SYS_read, SYS_write, SYS_openat, SYS_futex, SYS_mmap };
+static int iterations = 200000;
+static int rounds = 5;	// the fastest round is reported
+
+static void errexit(const char *msg) {
+	perror(msg);
+	exit(1);
+}
+
+//***************************************************
+// BPF interpreter
+//***************************************************
+// return the number of instructions walked by the filter
+static int bpf_walk(const struct sock_fprog *prog, const struct seccomp_data *data, unsigned *ret) {
+	uint32_t A = 0;
+	int pc = 0;
+	int steps = 0;
+
+	while (pc < prog->len) {
+		const struct sock_filter *f = &prog->filter[pc];
+		steps++;
+		switch (f->code) {
+		case BPF_LD + BPF_W + BPF_ABS:
+			if (f->k + sizeof(uint32_t) > sizeof(*data))
+				goto errout;
+			memcpy(&A, (const char *) data + f->k, sizeof(uint32_t));
+			break;
+		case BPF_ALU + BPF_AND + BPF_K:
+			A &= f->k;
+			break;
+		case BPF_JMP + BPF_JA + BPF_K:
+			pc += f->k;
+			break;
+		case BPF_JMP + BPF_JEQ + BPF_K:
+			pc += (A == f->k)? f->jt: f->jf;
+			break;
+		case BPF_JMP + BPF_JGT + BPF_K:
+			pc += (A > f->k)? f->jt: f->jf;
+			break;
+		case BPF_JMP + BPF_JGE + BPF_K:
+			pc += (A >= f->k)? f->jt: f->jf;
+			break;
+		case BPF_JMP + BPF_JSET + BPF_K:
+			pc += (A & f->k)? f->jt: f->jf;
+			break;
+		case BPF_RET + BPF_K:
+			*ret = f->k;
+			return steps;
+		default:
+			goto errout;
+		}
+		pc++;
+	}
+
+errout:
+	fprintf(stderr, "Error: unsupported BPF instruction %d\n", pc);
+	exit(1);
+}
+
+// instructions walked by the filter set; the kernel runs all the filters
+static int bpf_walk_set(const FilterSet *set, int nr) {
+	struct seccomp_data data;
+	memset(&data, 0, sizeof(data));
+	data.nr = nr;
+	data.arch = ARCH_NR;
+	if (nr == SYS_mmap)
+		data.args[2] = PROT_READ | PROT_WRITE;
+
+	int steps = 0;
+	int i;
+	for (i = 0; i < set->cnt; i++) {
+		unsigned ret;
+		steps += bpf_walk(&set->prog[i], &data, &ret);
+	}
+	return steps;
+}
+
+//***************************************************
+// syscall latency
+//***************************************************
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// return the average latency of a syscall in nanoseconds
+static double measure(int test) {
+	int fd_zero = open("/dev/zero", O_RDONLY);
+	int fd_null = open("/dev/null", O_WRONLY);
+	if (fd_zero == -1 || fd_null == -1)
+		_exit(1);
+	int fds[BATCH];
+	void *maps[BATCH];
+	int futex_word = 0;
+	char c = 0;
+	double total = 0;
+	int i, j;
+
+	for (i = 0; i < iterations; i += BATCH) {
+		int cnt = (iterations - i < BATCH)? iterations - i: BATCH;
+		double start = now();
+		for (j = 0; j < cnt; j++) {
+			switch (test) {
+			case T_GETPID:
+				syscall(SYS_getpid);
+				break;
+			case T_READ:
+				if (read(fd_zero, &c, 1) != 1)
+					_exit(1);
+				break;
+			case T_WRITE:
+				if (write(fd_null, &c, 1) != 1)
+					_exit(1);
+				break;
+			case T_OPENAT:
+				fds[j] = openat(AT_FDCWD, "/dev/null", O_RDONLY);
+				break;
+			case T_FUTEX:
+				syscall(SYS_futex, &futex_word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+				break;
+			case T_MMAP:
+				maps[j] = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				break;
+			}
+		}
+		total += now() - start;
+
+		// cleanup
+		for (j = 0; j < cnt; j++) {
+			if (test == T_OPENAT && fds[j] != -1)
+				close(fds[j]);
+			else if (test == T_MMAP && maps[j] != MAP_FAILED)
+				munmap(maps[j], 4096);
+		}
+	}
+
+	close(fd_zero);
+	close(fd_null);
+	return total / iterations;
+}
+
+// install the filters in a child process and measure the syscalls; return 1 if error
+static int run_set(const FilterSet *set, double *result) {
+	int pipefd[2];
+	if (pipe(pipefd) == -1)
+		errexit("pipe");
+
+	pid_t child = fork();
+	if (child == -1)
+		errexit("fork");
+	if (child == 0) {
+		close(pipefd[0]);
+		if (set->cnt) {
+			if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0))
+				_exit(1);
+			int i;
+			for (i = 0; i < set->cnt; i++) {
+				if (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &set->prog[i]))
+					_exit(1);
+			}
+		}
+
+		double rv[T_MAX];
+		int i, j;
+		for (i = 0; i < T_MAX; i++) {
+			rv[i] = measure(i);
+			for (j = 1; j < rounds; j++) {
+				double val = measure(i);
+				if (val < rv[i])
+					rv[i] = val;
+			}
+		}
+		if (write(pipefd[1], rv, sizeof(rv)) != sizeof(rv))
+			_exit(1);
+		_exit(0);
+	}
+
+	close(pipefd[1]);
+	ssize_t len = read(pipefd[0], result, sizeof(double) * T_MAX);
+	close(pipefd[0]);
+	int status;
+	waitpid(child, &status, 0);
+	if (len != (ssize_t) (sizeof(double) * T_MAX)) {
+		if (WIFSIGNALED(status))
+			fprintf(stderr, "Error: %s benchmark killed by signal %d\n", set->label, WTERMSIG(status));
+		else
+			fprintf(stderr, "Error: %s benchmark failed\n", set->label);
+		return 1;
+	}
+	return 0;
+}
+
+//***************************************************
+// filter files
+//***************************************************
+static void load_filter(struct sock_fprog *prog, const char *fname) {
+	int fd = open(fname, O_RDONLY);
+	if (fd == -1)
+		errexit(fname);
+	off_t size = lseek(fd, 0, SEEK_END);
+	if (size <= 0 || size % sizeof(struct sock_filter)) {
+		fprintf(stderr, "Error: invalid seccomp filter %s\n", fname);
+		exit(1);
+	}
+	struct sock_filter *filter = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (filter == MAP_FAILED)
+		errexit("mmap");
+	close(fd);
+	prog->len = size / sizeof(struct sock_filter);
+	prog->filter = filter;
+}
+
+// label=file[:file...]
+static void parse_set(FilterSet *set, char *arg) {
+	char *ptr = strchr(arg, '=');
+	if (!ptr || ptr == arg || *(ptr + 1) == '\0') {
+		fprintf(stderr, "Error: invalid filter set %s\n", arg);
+		exit(1);
+	}
+	*ptr++ = '\0';
+	set->label = arg;
+
+	char *saveptr;
+	char *fname = strtok_r(ptr, ":", &saveptr);
+	while (fname) {
+		if (set->cnt == MAX_FILTERS) {
+			fprintf(stderr, "Error: maximum %d filters in a set\n", MAX_FILTERS);
+			exit(1);
+		}
+		load_filter(&set->prog[set->cnt++], fname);
+		fname = strtok_r(NULL, ":", &saveptr);
+	}
+}
+
+static void usage(void) {
+	printf("Usage: seccomp-bench [-n iterations] [-r rounds] label=file[:file...] ...\n");
+}
+
+int main(int argc, char **argv) {
+	int i;
+	for (i = 1; i < argc && *argv[i] == '-'; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			iterations = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			rounds = atoi(argv[++i]);
+		else {
+			usage();
+			return (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)? 0: 1;
+		}
+	}
+	if (iterations <= 0 || rounds <= 0) {
+		usage();
+		return 1;
+	}
+
+	int sets_cnt = argc - i + 1;
+	FilterSet *sets = calloc(sets_cnt, sizeof(FilterSet));
+	if (!sets)
+		errexit("calloc");
+	sets[0].label = "none";
+	int j;
+	for (j = 1; j < sets_cnt; j++)
+		parse_set(&sets[j], argv[i + j - 1]);
+
+	printf("%d iterations, best of %d rounds\n", iterations, rounds);
+	printf("latency in ns/call, overhead relative to no filter, BPF instructions walked\n\n");
+	printf("%-26s %6s", "filter", "insns");
+	for (i = 0; i < T_MAX; i++)
+		printf(" %20s", test_name[i]);
+	printf("\n");
+
+	double base[T_MAX];
+	int rv = 0;
+	for (j = 0; j < sets_cnt; j++) {
+		double result[T_MAX];
+		if (run_set(&sets[j], result)) {
+			rv = 1;
+			continue;
+		}
+		if (j == 0)
+			memcpy(base, result, sizeof(base));
+
+		int len = 0;
+		for (i = 0; i < sets[j].cnt; i++)
+			len += sets[j].prog[i].len;
+		printf("%-26s %6d", sets[j].label, len);
+		for (i = 0; i < T_MAX; i++) {
+			char buf[64];
+			snprintf(buf, sizeof(buf), "%.1f %+.1f %3d", result[i], result[i] - base[i],
+				bpf_walk_set(&sets[j], test_nr[i]));
+			printf(" %20s", buf);
+		}
+		printf("\n");
+	}
+
+	return rv;
+}
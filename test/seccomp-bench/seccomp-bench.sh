@@ -0,0 +1,35 @@
+#!/bin/bash
+# This file is part of Firejail project
+# Copyright (C) 2014-2018 Firejail Authors
+# License GPL v2
+
+# Seccomp filter overhead benchmark. The filters are built with fseccomp and
+# fsec-optimize from the source tree, run "make filters" first.
+# Usage: ./seccomp-bench.sh [-n iterations] [-r rounds]
+
+SRC=../../src
+FSECCOMP=$SRC/fseccomp/fseccomp
+FSEC_OPTIMIZE=$SRC/fsec-optimize/fsec-optimize
+TMPDIR=$(mktemp -d)
+trap 'rm -fr $TMPDIR' EXIT
+
+${CC:-gcc} -O2 -Wall -o $TMPDIR/seccomp-bench seccomp-bench.c || exit 1
+
+# default+drop list
+$FSECCOMP default drop $TMPDIR/default-drop $TMPDIR/unused chmod,fchmod,fchmodat,chown,fchown,lchown,fchownat > /dev/null || exit 1
+$FSEC_OPTIMIZE $TMPDIR/default-drop || exit 1
+
+# keep list - the syscalls used by the benchmark
+$FSECCOMP keep $TMPDIR/keep $TMPDIR/unused getpid,read,write,openat,open,close,futex,mmap,munmap,clock_gettime,gettimeofday,exit_group,exit > /dev/null || exit 1
+
+# drop list with syscalls in @default-keep, they go in the postexec filter
+$FSECCOMP default drop $TMPDIR/unused $TMPDIR/postexec execve,chmod > /dev/null || exit 1
+
+$TMPDIR/seccomp-bench "$@" \
+	default=../../seccomp \
+	default+drop=$TMPDIR/default-drop \
+	keep=$TMPDIR/keep \
+	memory-deny-write-execute=../../seccomp.mdwx \
+	secondary-32=../../seccomp.32 \
+	postexec=$TMPDIR/postexec \
+	firejail-default=../../seccomp:../../seccomp.32